@@ -0,0 +1,71 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdlib.h>
+#include <new>
+#include "PajeArena.h"
+
+//every allocation is aligned for any object
+#define PAJE_ARENA_ALIGN 16
+
+PajeArena::PajeArena (void)
+{
+  next = NULL;
+  available = 0;
+  slabSize = PAJE_ARENA_FIRST_SLAB;
+}
+
+PajeArena::~PajeArena (void)
+{
+  release ();
+}
+
+/*
+ * allocate: slabs double in size up to PAJE_ARENA_MAX_SLAB, so an
+ * arena with a few objects stays small.
+ */
+void *PajeArena::allocate (size_t size)
+{
+  size = (size + PAJE_ARENA_ALIGN - 1) & ~(size_t)(PAJE_ARENA_ALIGN - 1);
+  if (size > available){
+    size_t length = size > slabSize ? size : slabSize;
+    char *slab = (char*)malloc (length);
+    if (!slab){
+      throw std::bad_alloc();
+    }
+    slabs.push_back (slab);
+    next = slab;
+    available = length;
+    if (slabSize < PAJE_ARENA_MAX_SLAB){
+      slabSize *= 2;
+    }
+  }
+  void *ret = next;
+  next += size;
+  available -= size;
+  return ret;
+}
+
+void PajeArena::release (void)
+{
+  for (unsigned int i = 0; i < slabs.size(); i++){
+    free (slabs[i]);
+  }
+  slabs.clear ();
+  next = NULL;
+  available = 0;
+  slabSize = PAJE_ARENA_FIRST_SLAB;
+}
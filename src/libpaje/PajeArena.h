@@ -0,0 +1,46 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJE_ARENA_H
+#define __PAJE_ARENA_H
+#include <vector>
+#include <stddef.h>
+
+//size of the first slab of an arena, and the largest slab size
+#define PAJE_ARENA_FIRST_SLAB 4096
+#define PAJE_ARENA_MAX_SLAB (1024*1024)
+
+/*
+ * PajeArena: bump-pointer allocation in slabs that are only released
+ * all together. Nothing allocated in an arena is freed on its own,
+ * the destructors of objects must be called explicitly before the
+ * arena is released. It is not thread-safe.
+ */
+class PajeArena {
+private:
+  std::vector<char*> slabs;
+  char *next;
+  size_t available;
+  size_t slabSize;
+
+public:
+  PajeArena (void);
+  ~PajeArena (void);
+  void *allocate (size_t size);
+  void release (void);
+};
+
+#endif
@@ -0,0 +1,147 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJEBINARY_H__
+#define __PAJEBINARY_H__
+#include <string>
+#include <string.h>
+#include "PajeEnum.h"
+
+/*
+ * The binary Paje trace format, written by PajeBinaryWriter and read
+ * by PajeBinaryReader.
+ *
+ * The file starts with PAJE_BINARY_MAGIC followed by a version byte.
+ * Then comes a sequence of records, each one starting with a varint
+ * tag:
+ *
+ *  DEFINITION: event name, event id, field count, and the name and
+ *              type of each field (all as inline strings); the n-th
+ *              definition record is used by events with tag EVENT+n
+ *  STRING:     an inline string added to the string table
+ *  SKIP:       number of lines of the original trace without events
+ *  RAW:        definition index, field count and the string id of
+ *              each field; for lines with a field count that does not
+ *              match their definition
+ *  EVENT+n:    the fields of an event of definition n, the event id
+ *              itself excluded, encoded according to the field types
+ *
+ * Numeric fields (date, double, float and int) are stored as a
+ * decimal mantissa and scale, so that the text is rebuilt exactly:
+ * a varint header 0 means a string id follows (the text is not a
+ * plain decimal number), 1+2*scale an absolute zigzag mantissa,
+ * 2+2*scale a zigzag delta from the previous Time value. Key fields
+ * are inline strings, other fields are string ids. Varints are
+ * unsigned LEB128.
+ */
+#define PAJE_BINARY_MAGIC "PAJEBIN"
+#define PAJE_BINARY_MAGIC_LENGTH 7
+#define PAJE_BINARY_VERSION 1
+#define PAJE_BINARY_MAX_DIGITS 18
+
+enum {
+  PAJE_BINARY_DEFINITION = 1,
+  PAJE_BINARY_STRING = 2,
+  PAJE_BINARY_SKIP = 3,
+  PAJE_BINARY_RAW = 4,
+  PAJE_BINARY_EVENT = 16
+};
+
+//how each field of a definition is encoded
+typedef enum {
+  PAJE_BINARY_STRING_FIELD,
+  PAJE_BINARY_NUMBER_FIELD,
+  PAJE_BINARY_INLINE_FIELD
+} paje_binary_field_kind;
+
+static inline paje_binary_field_kind paje_binary_kind (PajeField field, PajeFieldType type)
+{
+  if (field == PAJE_Key){
+    return PAJE_BINARY_INLINE_FIELD;
+  }
+  if (type == PAJE_date || type == PAJE_double || type == PAJE_float || type == PAJE_int){
+    return PAJE_BINARY_NUMBER_FIELD;
+  }
+  return PAJE_BINARY_STRING_FIELD;
+}
+
+/*
+ * paje_number_format: writes the decimal text of mantissa/10^scale
+ * to buffer (at least 24 bytes), returns its length.
+ */
+static inline int paje_number_format (long long mantissa, int scale, char *buffer)
+{
+  char digits[24];
+  int n = 0;
+  unsigned long long u = mantissa < 0 ? -(unsigned long long)mantissa : mantissa;
+  do {
+    digits[n++] = '0' + u % 10;
+    u /= 10;
+  } while (u);
+  while (n < scale + 1){
+    digits[n++] = '0';
+  }
+  int length = 0;
+  if (mantissa < 0){
+    buffer[length++] = '-';
+  }
+  for (int i = n - 1; i >= 0; i--){
+    if (i == scale - 1){
+      buffer[length++] = '.';
+    }
+    buffer[length++] = digits[i];
+  }
+  buffer[length] = '\0';
+  return length;
+}
+
+/*
+ * paje_number_parse: returns true if str is a decimal number whose
+ * text paje_number_format rebuilds exactly.
+ */
+static inline bool paje_number_parse (const char *str, long long *mantissa, int *scale)
+{
+  const char *p = str;
+  bool negative = false, dot = false;
+  unsigned long long u = 0;
+  int digits = 0;
+  *scale = 0;
+  if (*p == '-'){
+    negative = true;
+    p++;
+  }
+  for (; *p; p++){
+    if (*p == '.' && !dot){
+      dot = true;
+      continue;
+    }
+    if (*p < '0' || *p > '9' || ++digits > PAJE_BINARY_MAX_DIGITS){
+      return false;
+    }
+    u = u * 10 + (*p - '0');
+    if (dot) (*scale)++;
+  }
+  if (digits == 0){
+    return false;
+  }
+  *mantissa = negative ? -(long long)u : (long long)u;
+
+  char buffer[32];
+  paje_number_format (*mantissa, *scale, buffer);
+  return strcmp (buffer, str) == 0;
+}
+
+#endif
@@ -0,0 +1,340 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "PajeBinaryReader.h"
+#include "PajeException.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//events handed to the simulator at each readNextChunk
+#define PAJE_BINARY_EVENTS_PER_CHUNK 50000
+
+bool PajeBinaryReader::isBinaryTrace (std::string f)
+{
+  char magic[PAJE_BINARY_MAGIC_LENGTH];
+  int fd = ::open (f.c_str(), O_RDONLY);
+  if (fd == -1){
+    return false;
+  }
+  ssize_t n = read (fd, magic, PAJE_BINARY_MAGIC_LENGTH);
+  close (fd);
+  return n == PAJE_BINARY_MAGIC_LENGTH &&
+    memcmp (magic, PAJE_BINARY_MAGIC, PAJE_BINARY_MAGIC_LENGTH) == 0;
+}
+
+/*
+ * PajeBinaryReader: feeds PajeTraceEvent objects straight to the
+ * simulator, no PajeEventDecoder is needed. The file is mapped in
+ * memory when possible, otherwise it is read at once.
+ */
+PajeBinaryReader::PajeBinaryReader (std::string f, PajeDefinitions *definitions)
+{
+  filename = f;
+  defs = definitions;
+  moreData = true;
+  currentLine = 0;
+  previousTime = 0;
+  data = NULL;
+  length = 0;
+  mapped = false;
+
+  int fd = ::open (f.c_str(), O_RDONLY);
+  if (fd == -1){
+    throw PajeFileReadException (f);
+  }
+  struct stat st;
+  if (fstat (fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+    void *m = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m != MAP_FAILED){
+      data = (char*)m;
+      length = st.st_size;
+      mapped = true;
+      madvise (data, length, MADV_SEQUENTIAL);
+    }
+  }
+  if (!mapped){
+    size_t capacity = 0;
+    ssize_t n;
+    do {
+      if (length == capacity){
+        capacity = 2 * capacity + PAJE_BINARY_EVENTS_PER_CHUNK;
+        data = (char*) realloc (data, capacity);
+      }
+      n = read (fd, data + length, capacity - length);
+      if (n > 0) length += n;
+    } while (n > 0);
+  }
+  close (fd);
+
+  pos = (const unsigned char*)data;
+  end = pos + length;
+  if (length < PAJE_BINARY_MAGIC_LENGTH + 1 ||
+      memcmp (data, PAJE_BINARY_MAGIC, PAJE_BINARY_MAGIC_LENGTH) != 0){
+    corrupted ("no binary trace header");
+  }
+  if (data[PAJE_BINARY_MAGIC_LENGTH] != PAJE_BINARY_VERSION){
+    corrupted ("unsupported version");
+  }
+  pos += PAJE_BINARY_MAGIC_LENGTH + 1;
+}
+
+PajeBinaryReader::~PajeBinaryReader (void)
+{
+  if (mapped){
+    munmap (data, length);
+  }else{
+    free (data);
+  }
+  for (unsigned int i = 0; i < definitions.size(); i++){
+    delete definitions[i].definition;
+  }
+}
+
+void PajeBinaryReader::corrupted (std::string what)
+{
+  std::stringstream st;
+  st << ((const char*)pos - data);
+  throw PajeDecodeException ("Corrupted binary trace '" + filename + "' (" + what + ") at offset " + st.str());
+}
+
+unsigned long long PajeBinaryReader::readVarint (void)
+{
+  unsigned long long value = 0;
+  int shift = 0;
+  while (pos < end && shift < 64){
+    unsigned char byte = *pos++;
+    value |= (unsigned long long)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)){
+      return value;
+    }
+    shift += 7;
+  }
+  corrupted ("truncated varint");
+  return 0;
+}
+
+long long PajeBinaryReader::readSignedVarint (void)
+{
+  unsigned long long value = readVarint ();
+  return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+const char *PajeBinaryReader::readBytes (size_t n)
+{
+  if (n > (size_t)(end - pos)){
+    corrupted ("truncated string");
+  }
+  const char *ret = (const char*)pos;
+  pos += n;
+  return ret;
+}
+
+std::string PajeBinaryReader::readString (void)
+{
+  size_t n = readVarint ();
+  const char *str = readBytes (n);
+  return std::string (str, n);
+}
+
+unsigned long long PajeBinaryReader::readStringId (void)
+{
+  unsigned long long id = readVarint ();
+  if (id >= strings.size()){
+    corrupted ("unknown string");
+  }
+  return id;
+}
+
+/*
+ * addString: the string id as the next field of the event, without
+ * copying it. The ones the simulator resolves come with their hash,
+ * computed once per string.
+ */
+void PajeBinaryReader::addString (unsigned long long id, bool symbolic)
+{
+  const std::string &str = strings[id];
+  if (symbolic){
+    event.addFieldView (str.data(), str.length(), hashes[id]);
+  }else{
+    event.addFieldView (str.data(), str.length());
+  }
+}
+
+/*
+ * readDefinition: rebuilds the event definition exactly as
+ * PajeEventDecoder does from the %EventDef lines.
+ */
+void PajeBinaryReader::readDefinition (void)
+{
+  std::string eventName = readString ();
+  std::string eventId = readString ();
+  PajeEventId pajeEventId = defs->idFromEventName (eventName);
+  if (pajeEventId == PajeUnknownEventId) {
+    throw PajeDecodeException ("Unknown event name '" + eventName + "' in binary trace '" + filename + "'");
+  }
+
+  paje_binary_reader_definition binary;
+  binary.definition = new PajeEventDefinition (pajeEventId, atoi(eventId.c_str()), 0, defs);
+  binary.eventId = eventId;
+  binary.kinds.push_back (paje_binary_kind (PAJE_Event, PAJE_int));
+  binary.symbolic.push_back (false);
+  binary.timeIndex = -1;
+  definitions.push_back (binary);
+
+  unsigned long long count = readVarint ();
+  for (unsigned long long i = 0; i < count; i++){
+    std::string fieldName = readString ();
+    PajeField f = defs->idFromFieldName (fieldName);
+    PajeFieldType t = defs->idFromFieldTypeName (readString ());
+    if (f == PAJE_Unknown_Field) {
+      definitions.back().definition->addField (PAJE_Extra, t, 0, fieldName);
+      f = PAJE_Extra;
+    }else{
+      definitions.back().definition->addField (f, t, 0);
+    }
+    if (f == PAJE_Time){
+      definitions.back().timeIndex = i + 1;
+    }
+    definitions.back().kinds.push_back (paje_binary_kind (f, t));
+    definitions.back().symbolic.push_back (t == PAJE_string && PajeTraceEvent::isSymbolField (f));
+  }
+  if (!definitions.back().definition->isValid()){
+    throw PajeDecodeException ("Invalid definition of event '" + eventName + "' with id '" + eventId + "' in binary trace '" + filename + "'");
+  }
+}
+
+/*
+ * readNumber: the number goes to the event as such, see
+ * PajeTraceEvent::addNumberField, it is not written as text.
+ */
+void PajeBinaryReader::readNumber (bool isTime)
+{
+  unsigned long long header = readVarint ();
+  if (header == 0){
+    addString (readStringId (), false);
+    return;
+  }
+  int scale = (header - 1) / 2;
+  if (scale > PAJE_BINARY_MAX_DIGITS){
+    corrupted ("invalid number");
+  }
+  long long mantissa = readSignedVarint ();
+  if (header % 2 == 0){
+    mantissa += previousTime;
+  }
+  if (isTime){
+    previousTime = mantissa;
+  }
+  event.addNumberField (mantissa, scale);
+}
+
+void PajeBinaryReader::readRaw (void)
+{
+  unsigned long long index = readVarint ();
+  unsigned long long count = readVarint ();
+  if (index >= definitions.size() || count > PAJE_MAX_FIELDS){
+    corrupted ("invalid event");
+  }
+  event.setDefinition (definitions[index].definition);
+  paje_line line;
+  line.word_count = count;
+  line.lineNumber = currentLine;
+  for (unsigned long long i = 0; i < count; i++){
+    addString (readStringId (), false);
+  }
+  for (unsigned long long i = 0; i < count; i++){
+    line.word[i] = event.fieldAtIndex(i);
+    line.length[i] = event.fieldLengthAtIndex(i);
+  }
+  event.check (&line);
+}
+
+void PajeBinaryReader::readEvent (unsigned long long index)
+{
+  if (index >= definitions.size()){
+    corrupted ("unknown event definition");
+  }
+  paje_binary_reader_definition *binary = &definitions[index];
+  event.setDefinition (binary->definition);
+  event.addFieldView (binary->eventId.data(), binary->eventId.length());
+  for (unsigned int i = 1; i < binary->kinds.size(); i++){
+    switch (binary->kinds[i]){
+    case PAJE_BINARY_NUMBER_FIELD:
+      readNumber ((int)i == binary->timeIndex);
+      break;
+    case PAJE_BINARY_INLINE_FIELD:
+      {
+        size_t n = readVarint ();
+        event.addFieldView (readBytes (n), n);
+      }
+      break;
+    default:
+      addString (readStringId (), binary->symbolic[i]);
+    }
+  }
+}
+
+void PajeBinaryReader::readNextChunk (void)
+{
+  int events = 0;
+  while (pos < end && events < PAJE_BINARY_EVENTS_PER_CHUNK){
+    unsigned long long tag = readVarint ();
+    switch (tag){
+    case PAJE_BINARY_DEFINITION: readDefinition (); continue;
+    case PAJE_BINARY_STRING:
+      strings.push_back (readString ());
+      hashes.push_back (PajeSymbolTable::hash (strings.back().data(), strings.back().length()));
+      continue;
+    case PAJE_BINARY_SKIP: currentLine += readVarint (); continue;
+    default: break;
+    }
+
+    //an event, on the next line of the original trace
+    currentLine++;
+    event.clear ();
+    event.setLineNumber (currentLine);
+    if (tag == PAJE_BINARY_RAW){
+      readRaw ();
+    }else if (tag >= PAJE_BINARY_EVENT){
+      readEvent (tag - PAJE_BINARY_EVENT);
+    }else{
+      corrupted ("unknown record");
+    }
+    event.convertFields ();
+    PajeComponent::outputEntity (&event);
+    events++;
+  }
+  if (pos >= end){
+    moreData = false;
+  }
+}
+
+bool PajeBinaryReader::hasMoreData (void)
+{
+  return moreData;
+}
+
+unsigned long long PajeBinaryReader::traceSize (void)
+{
+  return length;
+}
+
+unsigned long long PajeBinaryReader::traceRead (void)
+{
+  return (const char*)pos - data;
+}
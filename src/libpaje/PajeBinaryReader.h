@@ -0,0 +1,76 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJEBINARYREADER_H__
+#define __PAJEBINARYREADER_H__
+#include <deque>
+#include <string>
+#include <vector>
+#include "PajeComponent.h"
+#include "PajeTraceEvent.h"
+#include "PajeDefinitions.h"
+#include "PajeBinary.h"
+
+typedef struct {
+  PajeEventDefinition *definition;
+  std::string eventId;
+  std::vector<paje_binary_field_kind> kinds;
+  std::vector<bool> symbolic; //fields the simulator resolves as symbols
+  int timeIndex;
+} paje_binary_reader_definition;
+
+class PajeBinaryReader : public PajeComponent {
+private:
+  std::string filename;
+  PajeDefinitions *defs;
+  char *data;
+  size_t length;
+  bool mapped;
+  const unsigned char *pos;
+  const unsigned char *end;
+  bool moreData;
+
+  std::vector<paje_binary_reader_definition> definitions;
+  std::deque<std::string> strings; //never move, events refer to them
+  std::vector<unsigned int> hashes; //of the strings, see PajeSymbolTable
+  PajeTraceEvent event;
+  long long currentLine;
+  long long previousTime;
+
+  unsigned long long readVarint (void);
+  long long readSignedVarint (void);
+  const char *readBytes (size_t n);
+  std::string readString (void);
+  unsigned long long readStringId (void);
+  void addString (unsigned long long id, bool symbolic);
+  void readDefinition (void);
+  void readNumber (bool isTime);
+  void readRaw (void);
+  void readEvent (unsigned long long index);
+  void corrupted (std::string what);
+
+public:
+  PajeBinaryReader (std::string f, PajeDefinitions *definitions);
+  ~PajeBinaryReader (void);
+  void readNextChunk (void);
+  bool hasMoreData (void);
+  unsigned long long traceSize (void);
+  unsigned long long traceRead (void);
+
+  static bool isBinaryTrace (std::string f); //by the magic bytes
+};
+
+#endif
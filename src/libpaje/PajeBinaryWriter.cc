@@ -0,0 +1,212 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "PajeBinaryWriter.h"
+#include "PajeException.h"
+
+//output is written to the file in blocks of this size
+#define PAJE_BINARY_WRITE_BLOCK (1024*1024)
+
+static void putVarint (std::string &buffer, unsigned long long value)
+{
+  while (value >= 0x80){
+    buffer.push_back ((char)(value | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back ((char)value);
+}
+
+static void putSignedVarint (std::string &buffer, long long value)
+{
+  putVarint (buffer, ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63));
+}
+
+static void putString (std::string &buffer, const std::string &str)
+{
+  putVarint (buffer, str.size());
+  buffer.append (str);
+}
+
+PajeBinaryWriter::PajeBinaryWriter (std::string f, PajeDefinitions *definitions)
+{
+  filename = f;
+  defs = definitions;
+  lastLine = 0;
+  previousTime = 0;
+  previousScale = 0;
+  hasPreviousTime = false;
+
+  file = fopen (f.c_str(), "wb");
+  if (file == NULL){
+    throw PajeFileWriteException (f);
+  }
+  out.append (PAJE_BINARY_MAGIC, PAJE_BINARY_MAGIC_LENGTH);
+  out.push_back ((char)PAJE_BINARY_VERSION);
+}
+
+PajeBinaryWriter::~PajeBinaryWriter (void)
+{
+  if (file){
+    flush ();
+    fclose (file);
+  }
+}
+
+void PajeBinaryWriter::flush (void)
+{
+  if (!out.empty() && fwrite (out.data(), 1, out.size(), file) != out.size()){
+    throw PajeFileWriteException (filename);
+  }
+  out.clear ();
+}
+
+/*
+ * definitionFor: the definition record is written the first time an
+ * event of this definition shows up.
+ */
+paje_binary_definition *PajeBinaryWriter::definitionFor (PajeTraceEvent *event)
+{
+  PajeEventDefinition *def = event->definition();
+  std::map<PajeEventDefinition*,paje_binary_definition>::iterator it = definitions.find (def);
+  if (it != definitions.end()){
+    return &it->second;
+  }
+
+  paje_binary_definition binary;
+  binary.index = definitions.size();
+  binary.timeIndex = -1;
+
+  putVarint (out, PAJE_BINARY_DEFINITION);
+  putString (out, defs->eventNameFromID (def->pajeEventIdentifier));
+  putString (out, std::string (event->fieldAtIndex(0), event->fieldLengthAtIndex(0)));
+  putVarint (out, def->fieldCount() - 1);
+
+  std::list<PajeField>::iterator itf = def->fields.begin();
+  std::list<PajeFieldType>::iterator itt = def->types.begin();
+  unsigned int extraIndex = 0;
+  for (int i = 0; itf != def->fields.end(); itf++, itt++, i++){
+    binary.kinds.push_back (paje_binary_kind (*itf, *itt));
+    if (*itf == PAJE_Time){
+      binary.timeIndex = i;
+    }
+    if (i == 0){
+      continue; //the event id itself
+    }
+    if (*itf == PAJE_Extra){
+      putString (out, def->userDefinedFieldNames.at(extraIndex++));
+    }else{
+      putString (out, defs->fieldNameFromID (*itf));
+    }
+    putString (out, defs->fieldTypeNameFromID (*itt));
+  }
+  return &(definitions[def] = binary);
+}
+
+unsigned long long PajeBinaryWriter::stringId (const std::string &str)
+{
+  std::map<std::string,unsigned long long>::iterator it = strings.find (str);
+  if (it != strings.end()){
+    return it->second;
+  }
+  unsigned long long id = strings.size();
+  strings[str] = id;
+  putVarint (out, PAJE_BINARY_STRING);
+  putString (out, str);
+  return id;
+}
+
+void PajeBinaryWriter::writeNumber (const std::string &str, bool isTime)
+{
+  long long mantissa;
+  int scale;
+  if (!paje_number_parse (str.c_str(), &mantissa, &scale)){
+    unsigned long long id = stringId (str);
+    putVarint (record, 0);
+    putVarint (record, id);
+    return;
+  }
+  if (isTime && hasPreviousTime && scale == previousScale){
+    putVarint (record, 2 + 2 * scale);
+    putSignedVarint (record, mantissa - previousTime);
+  }else{
+    putVarint (record, 1 + 2 * scale);
+    putSignedVarint (record, mantissa);
+  }
+  if (isTime){
+    previousTime = mantissa;
+    previousScale = scale;
+    hasPreviousTime = true;
+  }
+}
+
+void PajeBinaryWriter::inputEntity (PajeObject *data)
+{
+  PajeTraceEvent *event = (PajeTraceEvent*)data;
+  paje_binary_definition *binary = definitionFor (event);
+
+  //lines without events (definitions, comments) are only counted
+  long long gap = event->getLineNumber() - lastLine - 1;
+  if (gap > 0){
+    putVarint (out, PAJE_BINARY_SKIP);
+    putVarint (out, gap);
+  }
+  lastLine = event->getLineNumber();
+
+  //strings used by the event are written before the event itself
+  record.clear ();
+  unsigned int count = event->fieldCount();
+  if (count != binary->kinds.size()){
+    std::vector<unsigned long long> ids;
+    for (unsigned int i = 0; i < count; i++){
+      ids.push_back (stringId (std::string (event->fieldAtIndex(i), event->fieldLengthAtIndex(i))));
+    }
+    putVarint (out, PAJE_BINARY_RAW);
+    putVarint (out, binary->index);
+    putVarint (out, count);
+    for (unsigned int i = 0; i < count; i++){
+      putVarint (out, ids[i]);
+    }
+  }else{
+    for (unsigned int i = 1; i < count; i++){
+      std::string field (event->fieldAtIndex(i), event->fieldLengthAtIndex(i));
+      switch (binary->kinds[i]){
+      case PAJE_BINARY_NUMBER_FIELD:
+        writeNumber (field, (int)i == binary->timeIndex);
+        break;
+      case PAJE_BINARY_INLINE_FIELD:
+        putString (record, field);
+        break;
+      default:
+        {
+          unsigned long long id = stringId (field);
+          putVarint (record, id);
+        }
+      }
+    }
+    putVarint (out, PAJE_BINARY_EVENT + binary->index);
+    out.append (record);
+  }
+
+  if (out.size() > PAJE_BINARY_WRITE_BLOCK){
+    flush ();
+  }
+}
+
+void PajeBinaryWriter::finishedReading (void)
+{
+  flush ();
+  PajeComponent::finishedReading ();
+}
@@ -0,0 +1,60 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJEBINARYWRITER_H__
+#define __PAJEBINARYWRITER_H__
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include "PajeComponent.h"
+#include "PajeTraceEvent.h"
+#include "PajeDefinitions.h"
+#include "PajeBinary.h"
+
+typedef struct {
+  unsigned int index;
+  std::vector<paje_binary_field_kind> kinds;
+  int timeIndex;
+} paje_binary_definition;
+
+class PajeBinaryWriter : public PajeComponent {
+private:
+  std::string filename;
+  FILE *file;
+  PajeDefinitions *defs;
+  std::string out;
+  std::string record;
+  std::map<PajeEventDefinition*,paje_binary_definition> definitions;
+  std::map<std::string,unsigned long long> strings;
+  long long lastLine;
+  long long previousTime;
+  int previousScale;
+  bool hasPreviousTime;
+
+  void flush (void);
+  paje_binary_definition *definitionFor (PajeTraceEvent *event);
+  unsigned long long stringId (const std::string &str);
+  void writeNumber (const std::string &str, bool isTime);
+
+public:
+  PajeBinaryWriter (std::string f, PajeDefinitions *definitions);
+  ~PajeBinaryWriter (void);
+  void inputEntity (PajeObject *data);
+  void finishedReading (void);
+};
+
+#endif
@@ -22,6 +22,10 @@ PajeComponent::PajeComponent (void)
   inputComponent = NULL;
 }
 
+PajeComponent::~PajeComponent (void)
+{
+}
+
 void PajeComponent::setInputComponent (PajeComponent *component)
 {
   inputComponent = component;
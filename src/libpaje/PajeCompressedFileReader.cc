@@ -0,0 +1,283 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "PajeCompressedFileReader.h"
+#include "PajeException.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+//size of the blocks read from the compressed file
+#define PAJE_COMPRESSED_BLOCK_SIZE (256*1024)
+
+/*
+ * PajeDecompressor: one step of a streaming decompressor. step
+ * consumes input from in and writes output to out, updating the
+ * pointers and the remaining lengths. It returns false, with a
+ * message in error, if the data is corrupted. atBoundary tells if the
+ * input seen so far ends exactly at the end of a compressed stream.
+ */
+class PajeDecompressor {
+public:
+  std::string error;
+  virtual ~PajeDecompressor (void) {};
+  virtual bool step (const char **in, size_t *inLength, char **out, size_t *outLength, bool finish) = 0;
+  virtual bool atBoundary (void) = 0;
+};
+
+//uncompressed input, named with a compressed extension
+class PajePlainDecompressor : public PajeDecompressor {
+public:
+  bool step (const char **in, size_t *inLength, char **out, size_t *outLength, bool finish)
+  {
+    size_t n = *inLength < *outLength ? *inLength : *outLength;
+    memcpy (*out, *in, n);
+    *in += n; *inLength -= n;
+    *out += n; *outLength -= n;
+    return true;
+  }
+  bool atBoundary (void) { return true; }
+};
+
+#ifdef HAVE_ZLIB
+class PajeGzipDecompressor : public PajeDecompressor {
+private:
+  z_stream z;
+  bool boundary;
+public:
+  PajeGzipDecompressor (void)
+  {
+    memset (&z, 0, sizeof(z));
+    if (inflateInit2 (&z, 15 + 16) != Z_OK){ //gzip header only
+      error = "could not initialize the gzip decoder";
+    }
+    boundary = true;
+  }
+  ~PajeGzipDecompressor (void) { inflateEnd (&z); }
+  bool step (const char **in, size_t *inLength, char **out, size_t *outLength, bool finish)
+  {
+    z.next_in = (Bytef*)*in;
+    z.avail_in = *inLength;
+    z.next_out = (Bytef*)*out;
+    z.avail_out = *outLength;
+    int ret = inflate (&z, Z_NO_FLUSH);
+    if (z.next_in != (Bytef*)*in) boundary = false;
+    *inLength -= (const char*)z.next_in - *in;
+    *in = (const char*)z.next_in;
+    *outLength -= (char*)z.next_out - *out;
+    *out = (char*)z.next_out;
+    if (ret == Z_STREAM_END){
+      //concatenated gzip members are read as a single stream
+      inflateReset (&z);
+      boundary = true;
+    }else if (ret != Z_OK && ret != Z_BUF_ERROR){
+      error = z.msg ? z.msg : "corrupted gzip data";
+      return false;
+    }
+    return true;
+  }
+  bool atBoundary (void) { return boundary; }
+};
+#endif
+
+#ifdef HAVE_LZMA
+class PajeXzDecompressor : public PajeDecompressor {
+private:
+  lzma_stream s;
+  bool boundary;
+public:
+  PajeXzDecompressor (void)
+  {
+    lzma_stream init = LZMA_STREAM_INIT;
+    s = init;
+    if (lzma_stream_decoder (&s, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK){
+      error = "could not initialize the xz decoder";
+    }
+    boundary = false;
+  }
+  ~PajeXzDecompressor (void) { lzma_end (&s); }
+  bool step (const char **in, size_t *inLength, char **out, size_t *outLength, bool finish)
+  {
+    s.next_in = (const uint8_t*)*in;
+    s.avail_in = *inLength;
+    s.next_out = (uint8_t*)*out;
+    s.avail_out = *outLength;
+    lzma_ret ret = lzma_code (&s, finish ? LZMA_FINISH : LZMA_RUN);
+    *inLength -= (const char*)s.next_in - *in;
+    *in = (const char*)s.next_in;
+    *outLength -= (char*)s.next_out - *out;
+    *out = (char*)s.next_out;
+    if (ret == LZMA_STREAM_END){
+      boundary = true;
+    }else if (ret != LZMA_OK && !(ret == LZMA_BUF_ERROR && !finish)){
+      error = ret == LZMA_BUF_ERROR ? "truncated xz data" : "corrupted xz data";
+      return false;
+    }
+    return true;
+  }
+  bool atBoundary (void) { return boundary; }
+};
+#endif
+
+#ifdef HAVE_ZSTD
+class PajeZstdDecompressor : public PajeDecompressor {
+private:
+  ZSTD_DStream *s;
+  bool boundary;
+public:
+  PajeZstdDecompressor (void)
+  {
+    s = ZSTD_createDStream ();
+    if (s == NULL || ZSTD_isError (ZSTD_initDStream (s))){
+      error = "could not initialize the zstd decoder";
+    }
+    boundary = true;
+  }
+  ~PajeZstdDecompressor (void) { ZSTD_freeDStream (s); }
+  bool step (const char **in, size_t *inLength, char **out, size_t *outLength, bool finish)
+  {
+    ZSTD_inBuffer input = { *in, *inLength, 0 };
+    ZSTD_outBuffer output = { *out, *outLength, 0 };
+    size_t ret = ZSTD_decompressStream (s, &output, &input);
+    if (ZSTD_isError (ret)){
+      error = ZSTD_getErrorName (ret);
+      return false;
+    }
+    if (input.pos > 0 || output.pos > 0) boundary = (ret == 0);
+    *in += input.pos; *inLength -= input.pos;
+    *out += output.pos; *outLength -= output.pos;
+    return true;
+  }
+  bool atBoundary (void) { return boundary; }
+};
+#endif
+
+static bool hasSuffix (std::string str, std::string suffix)
+{
+  return str.size() >= suffix.size() &&
+    str.compare (str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool PajeCompressedFileReader::isCompressed (std::string f)
+{
+  return hasSuffix (f, ".gz") || hasSuffix (f, ".xz") || hasSuffix (f, ".zst");
+}
+
+/*
+ * PajeCompressedFileReader: the compression format is detected from
+ * the first bytes of the file, not from its name. The file is
+ * decompressed by the reading thread of PajeReadAheadReader, which
+ * keeps chunks ready while the rest of the pipeline decodes and
+ * simulates the previous ones. traceSize and traceRead count
+ * compressed bytes.
+ */
+PajeCompressedFileReader::PajeCompressedFileReader (std::string f)
+  : PajeReadAheadReader (f, false)
+{
+  decompressor = NULL;
+  block = NULL;
+  in = NULL;
+  inLength = 0;
+  eof = false;
+
+  std::string error;
+  unsigned char magic[6];
+  ssize_t n = pread (fd, magic, sizeof(magic), 0);
+  if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b){
+#ifdef HAVE_ZLIB
+    decompressor = new PajeGzipDecompressor ();
+#else
+    error = "gzip support not compiled in";
+#endif
+  }else if (n >= 6 && memcmp (magic, "\xfd" "7zXZ\0", 6) == 0){
+#ifdef HAVE_LZMA
+    decompressor = new PajeXzDecompressor ();
+#else
+    error = "xz support not compiled in";
+#endif
+  }else if (n >= 4 && memcmp (magic, "\x28\xb5\x2f\xfd", 4) == 0){
+#ifdef HAVE_ZSTD
+    decompressor = new PajeZstdDecompressor ();
+#else
+    error = "zstd support not compiled in";
+#endif
+  }else{
+    decompressor = new PajePlainDecompressor ();
+  }
+  if (decompressor && !decompressor->error.empty()){
+    error = decompressor->error;
+    delete decompressor;
+    decompressor = NULL;
+  }
+  if (!decompressor){
+    throw PajeDecodeException ("Could not read '" + f + "': " + error);
+  }
+
+  block = (char*) malloc (PAJE_COMPRESSED_BLOCK_SIZE);
+  start ();
+}
+
+PajeCompressedFileReader::~PajeCompressedFileReader (void)
+{
+  stop ();
+  delete decompressor;
+  free (block);
+}
+
+bool PajeCompressedFileReader::fill (char *buffer, size_t capacity, size_t *produced)
+{
+  while (true){
+    if (inLength == 0 && !eof){
+      ssize_t n = read (fd, block, PAJE_COMPRESSED_BLOCK_SIZE);
+      if (n < 0){
+        if (errno == EINTR) continue;
+        fillError = strerror (errno);
+        return false;
+      }
+      eof = (n == 0);
+      in = block;
+      inLength = n;
+      inputRead += n;
+    }
+
+    char *out = buffer;
+    size_t outLength = capacity;
+    if (!decompressor->step (&in, &inLength, &out, &outLength, eof)){
+      fillError = decompressor->error;
+      return false;
+    }
+    *produced = out - buffer;
+    if (*produced > 0){
+      return true;
+    }
+    if (eof && inLength == 0){
+      if (!decompressor->atBoundary()){
+        fillError = "unexpected end of compressed data";
+      }
+      return false;
+    }
+  }
+}
@@ -0,0 +1,41 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJECOMPRESSEDFILEREADER_H__
+#define __PAJECOMPRESSEDFILEREADER_H__
+#include <string>
+#include "PajeReadAheadReader.h"
+
+class PajeDecompressor;
+
+class PajeCompressedFileReader : public PajeReadAheadReader {
+private:
+  PajeDecompressor *decompressor;
+  char *block;
+  const char *in;
+  size_t inLength;
+  bool eof;
+
+protected:
+  bool fill (char *buffer, size_t capacity, size_t *produced);
+
+public:
+  PajeCompressedFileReader (std::string f);
+  ~PajeCompressedFileReader (void);
+
+  static bool isCompressed (std::string f); //by file name extension
+};
+#endif
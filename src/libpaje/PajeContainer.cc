@@ -14,6 +14,7 @@
     You should have received a copy of the GNU Public License
     along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
 */
+#include <math.h>
 #include "PajeContainer.h"
 #include "PajeException.h"
 
@@ -35,34 +36,67 @@ PajeContainer::PajeContainer (double time, std::string name, std::string alias,
   init (alias, parent);
 }
 
+/*
+ * ~PajeContainer: children and entities are in the arena, so only
+ * their destructors are called, their memory goes with the arena.
+ * With a sink, entities are on the heap, see entityArena.
+ */
 PajeContainer::~PajeContainer ()
 {
   std::map<std::string,PajeContainer*>::iterator i;
   for (i = children.begin(); i != children.end(); i++){
-    delete ((*i).second);
+    ((*i).second)->~PajeContainer();
   }
   children.clear();
 
   std::map<PajeType*,std::vector<PajeEntity*> >::iterator j;
   for (j = entities.begin(); j != entities.end(); j++){
-    std::vector<PajeEntity*> list = ((*j).second);
+    std::vector<PajeEntity*> &list = (*j).second;
+    for (size_t e = 0; e < list.size(); e++){
+      releaseEntity (list[e]);
+    }
+  }
+  entities.clear();
+
+  std::map<PajeType*,PajeLinkKeys*>::iterator l;
+  for (l = linkKeys.begin(); l != linkKeys.end(); l++){
+    std::vector<PajeUserLink*> pending;
+    (*l).second->pendingLinks (&pending);
+    for (size_t e = 0; e < pending.size(); e++){
+      releaseEntity (pending[e]);
+    }
+    delete (*l).second;
+  }
+  linkKeys.clear();
+
+  std::map<PajeType*,PajeTimeline*>::iterator k;
+  for (k = timelines.begin(); k != timelines.end(); k++){
+    delete ((*k).second);
+  }
+  for (j = timelineEntities.begin(); j != timelineEntities.end(); j++){
     std::vector<PajeEntity*>::iterator entity;
-    for (entity = list.begin(); entity != list.end(); entity++){
+    for (entity = (*j).second.begin(); entity != (*j).second.end(); entity++){
       delete *entity;
     }
-    list.clear();
   }
-  entities.clear();
+  arena.release ();
 }
 
 void PajeContainer::init (std::string alias, PajeContainer *parent)
 {
   _alias = alias;
   _destroyed = false;
+  releasedEntities = 0;
   if (parent){
     depth = parent->depth + 1;
+    columnar = parent->columnar;
+    sink = parent->sink;
+    linkKeyStrategy = parent->linkKeyStrategy;
   }else{
     depth = 0;
+    columnar = false;
+    sink = NULL;
+    linkKeyStrategy = PajeLinkKeys::strategyFor ("exact");
   }
 
   invocation[PajeDefineContainerTypeEventId] = NULL;
@@ -85,9 +119,10 @@ void PajeContainer::init (std::string alias, PajeContainer *parent)
   invocation[PajeEndLinkEventId] = &PajeContainer::pajeEndLink;
 }
 
+//numberOfEntities: including the ones released to the sink
 int PajeContainer::numberOfEntities (void)
 {
-  int ret = 0;
+  int ret = releasedEntities;
 
   std::map<std::string,PajeContainer*>::iterator i;
   for (i = children.begin(); i != children.end(); i++){
@@ -98,9 +133,22 @@ int PajeContainer::numberOfEntities (void)
   for (j = entities.begin(); j != entities.end(); j++){
     ret += ((*j).second).size();
   }
+  std::map<PajeType*,PajeTimeline*>::iterator k;
+  for (k = timelines.begin(); k != timelines.end(); k++){
+    ret += ((*k).second)->size();
+  }
   return ret;
 }
 
+size_t PajeContainer::numberOfEntitiesTyped (PajeType *type)
+{
+  std::map<PajeType*,PajeTimeline*>::iterator found = timelines.find (type);
+  if (found != timelines.end()){
+    return found->second->size();
+  }
+  return entities[type].size();
+}
+
 std::vector<PajeContainer*> PajeContainer::getChildren (void)
 {
   std::vector<PajeContainer*> ret;
@@ -121,6 +169,217 @@ bool PajeContainer::isAncestorOf (PajeContainer *c)
   return false;
 }
 
+/*
+ * setColumnar: the states, events and variables of this container and
+ * of the containers created in it are kept in PajeTimeline columns.
+ * The entities enumerated from them are created on demand, and are
+ * valid until the next enumeration of the same type in the container.
+ */
+void PajeContainer::setColumnar (bool columnar)
+{
+  this->columnar = columnar;
+}
+
+/*
+ * setEntitySink: this container and the containers created in it pass
+ * their entities to sink as soon as they are finished, and keep only
+ * the ones still open and the last one of each type, which the next
+ * event of the type is checked against. Columns are not used then.
+ */
+void PajeContainer::setEntitySink (PajeEntitySink *sink)
+{
+  this->sink = sink;
+}
+
+/*
+ * setLinkKeyStrategy: how this container and the containers created
+ * in it remember the keys of completed links, see PajeLinkKeys.
+ */
+void PajeContainer::setLinkKeyStrategy (paje_link_key_strategy strategy)
+{
+  this->linkKeyStrategy = strategy;
+}
+
+PajeLinkKeys *PajeContainer::linkKeysForType (PajeType *type)
+{
+  std::map<PajeType*,PajeLinkKeys*>::iterator found = linkKeys.find (type);
+  if (found != linkKeys.end()){
+    return found->second;
+  }
+  PajeLinkKeys *keys = new PajeLinkKeys (linkKeyStrategy);
+  linkKeys[type] = keys;
+  return keys;
+}
+
+//the timeline of type, NULL if the container does not use columns for it
+PajeTimeline *PajeContainer::timelineForType (PajeType *type)
+{
+  if (!columnar || sink || type->compaction()) return NULL;
+  PajeTypeNature nature = type->nature();
+  if (nature != PAJE_StateType && nature != PAJE_EventType && nature != PAJE_VariableType){
+    return NULL;
+  }
+  std::map<PajeType*,PajeTimeline*>::iterator found = timelines.find (type);
+  if (found != timelines.end()){
+    return found->second;
+  }
+  PajeTimeline *timeline = new PajeTimeline (this, type);
+  timelines.insert (found, std::make_pair (type, timeline));
+  return timeline;
+}
+
+//entities released one by one, with a sink, are not in the arena
+PajeArena *PajeContainer::entityArena (void)
+{
+  return sink ? NULL : &arena;
+}
+
+void PajeContainer::releaseEntity (PajeEntity *entity)
+{
+  if (sink){
+    sink->releaseEntity (entity);
+  }else{
+    entity->~PajeEntity();
+  }
+}
+
+/*
+ * evict: passes the finished entities of type to the sink, except the
+ * last one, and releases them. The last two are kept for states with
+ * the short compaction, a short state may join the one before it.
+ */
+void PajeContainer::evict (PajeType *type)
+{
+  paje_compaction *compaction = type->compaction();
+  size_t last = compaction && compaction->shortest > 0 ? 2 : 1;
+  std::map<PajeType*,std::vector<PajeEntity*> >::iterator found = entities.find (type);
+  if (found == entities.end() || found->second.size() <= last) return;
+
+  std::vector<PajeEntity*> *list = &found->second;
+  size_t kept = 0;
+  for (size_t i = 0; i + last < list->size(); i++){
+    PajeEntity *entity = (*list)[i];
+    if (entity->endTime() == -1){
+      (*list)[kept++] = entity;
+    }else{
+      sink->entityFinished (entity);
+      releaseEntity (entity);
+      releasedEntities++;
+    }
+  }
+  for (size_t i = list->size() - last; i < list->size(); i++){
+    (*list)[kept++] = (*list)[i];
+  }
+  list->resize (kept);
+}
+
+/*
+ * compactVariable: true if the change of the variable of type to value
+ * at time is absorbed by last, the current value, according to the
+ * compaction of type.
+ */
+bool PajeContainer::compactVariable (PajeType *type, PajeEntity *last, double time, double value)
+{
+  paje_compaction *compaction = type->compaction();
+  if (!compaction) return false;
+
+  variableValues[type] = value;
+  double start = last->startTime();
+  if (time == start || time - start < compaction->quantum){
+    if (time != start){
+      compacted[type].coalesced++;
+    }
+    last->setDoubleValue (value);
+    return true;
+  }
+  if (fabs (value - last->doubleValue()) < compaction->epsilon){
+    compacted[type].dropped++;
+    return true;
+  }
+  return false;
+}
+
+//the value of the variable, last may only have an approximation of it
+double PajeContainer::variableValue (PajeType *type, PajeEntity *last)
+{
+  if (type->compaction()){
+    std::map<PajeType*,double>::iterator found = variableValues.find (type);
+    if (found != variableValues.end()){
+      return found->second;
+    }
+  }
+  return last->doubleValue();
+}
+
+/*
+ * reopenState: with the merge compaction, the last state of type
+ * continues, and is stacked again, if it ended at time with the same
+ * value and imbrication.
+ */
+bool PajeContainer::reopenState (PajeType *type, double time, PajeValue *value, int imbrication)
+{
+  paje_compaction *compaction = type->compaction();
+  if (!compaction || !compaction->merge) return false;
+
+  std::vector<PajeEntity*> *list = &entities[type];
+  if (list->empty()) return false;
+  PajeUserState *last = (PajeUserState*)list->back();
+  if (last->endTime() != time || last->value() != value || last->imbricationLevel() != imbrication){
+    return false;
+  }
+  last->setEndTime (-1);
+  stackStates[type].push_back (last);
+  compacted[type].merged++;
+  return true;
+}
+
+/*
+ * finishState: ends state at time. With the short compaction, a
+ * shorter state gets the other value, and joins the previous state of
+ * type when that one is an adjacent other.
+ */
+void PajeContainer::finishState (PajeType *type, PajeUserState *state, double time)
+{
+  state->setEndTime (time);
+
+  paje_compaction *compaction = type->compaction();
+  if (!compaction || time - state->startTime() >= compaction->shortest) return;
+
+  paje_compaction_stats *stats = &compacted[type];
+  stats->shortened++;
+  std::vector<PajeEntity*> *list = &entities[type];
+  if (list->size() > 1 && list->back() == state){
+    PajeEntity *previous = (*list)[list->size() - 2];
+    if (previous->value() == compaction->other &&
+        previous->endTime() == state->startTime() &&
+        previous->imbricationLevel() == state->imbricationLevel()){
+      previous->setEndTime (time);
+      list->pop_back ();
+      releaseEntity (state);
+      stats->joined++;
+      return;
+    }
+  }
+  state->setValue (compaction->other);
+}
+
+void PajeContainer::compactionStatistics (std::map<PajeType*,paje_compaction_stats> *total)
+{
+  std::map<PajeType*,paje_compaction_stats>::iterator it;
+  for (it = compacted.begin(); it != compacted.end(); it++){
+    paje_compaction_stats *sum = &(*total)[(*it).first];
+    sum->coalesced += (*it).second.coalesced;
+    sum->dropped += (*it).second.dropped;
+    sum->merged += (*it).second.merged;
+    sum->shortened += (*it).second.shortened;
+    sum->joined += (*it).second.joined;
+  }
+  std::map<std::string,PajeContainer*>::iterator child;
+  for (child = children.begin(); child != children.end(); child++){
+    (*child).second->compactionStatistics (total);
+  }
+}
+
 bool PajeContainer::keepSimulating (void)
 {
   if (stopSimulationAtTime != -1){
@@ -137,6 +396,129 @@ bool PajeContainer::keepSimulating (void)
   return true;
 }
 
+//links by key, as they are reported
+static bool linkKeyOrder (PajeUserLink *a, PajeUserLink *b)
+{
+  return a->linkKey() < b->linkKey();
+}
+
+bool PajeContainer::isDestroyed (void) const
+{
+  return _destroyed;
+}
+
+/*
+ * openEntities: the entities of this container that are not finished,
+ * the stacked states from the bottom, the current value of variables
+ * and the pending links. The entities kept in columns are left out.
+ */
+void PajeContainer::openEntities (std::vector<PajeEntity*> *open)
+{
+  std::map<PajeType*,std::vector<PajeUserState*> >::iterator s;
+  for (s = stackStates.begin(); s != stackStates.end(); s++){
+    open->insert (open->end(), (*s).second.begin(), (*s).second.end());
+  }
+
+  std::map<PajeType*,std::vector<PajeEntity*> >::iterator v;
+  for (v = entities.begin(); v != entities.end(); v++){
+    if ((*v).first->nature() != PAJE_VariableType || (*v).second.empty()) continue;
+    PajeEntity *last = (*v).second.back();
+    if (last->endTime() == -1){
+      open->push_back (last);
+    }
+  }
+
+  std::map<PajeType*,PajeLinkKeys*>::iterator l;
+  for (l = linkKeys.begin(); l != linkKeys.end(); l++){
+    std::vector<PajeUserLink*> pending;
+    (*l).second->pendingLinks (&pending);
+    std::sort (pending.begin(), pending.end(), linkKeyOrder);
+    open->insert (open->end(), pending.begin(), pending.end());
+  }
+}
+
+/*
+ * entityTypes: the types of the entities of this container, kept in
+ * columns (timelineOfType) or as entity objects (entitiesOfType).
+ */
+std::vector<PajeType*> PajeContainer::entityTypes (void)
+{
+  std::vector<PajeType*> ret;
+  std::map<PajeType*,PajeTimeline*>::iterator k;
+  for (k = timelines.begin(); k != timelines.end(); k++){
+    ret.push_back ((*k).first);
+  }
+  std::map<PajeType*,std::vector<PajeEntity*> >::iterator j;
+  for (j = entities.begin(); j != entities.end(); j++){
+    if (!(*j).second.empty() && !timelines.count ((*j).first)){
+      ret.push_back ((*j).first);
+    }
+  }
+  return ret;
+}
+
+PajeTimeline *PajeContainer::timelineOfType (PajeType *type)
+{
+  std::map<PajeType*,PajeTimeline*>::iterator found = timelines.find (type);
+  return found != timelines.end() ? found->second : NULL;
+}
+
+const std::vector<PajeEntity*> &PajeContainer::entitiesOfType (PajeType *type)
+{
+  return entities[type];
+}
+
+const PajeIntervalIndex *PajeContainer::intervalIndexOfType (PajeType *type)
+{
+  std::map<PajeType*,PajeIntervalIndex>::iterator found = intervals.find (type);
+  return found != intervals.end() ? &found->second : NULL;
+}
+
+const std::vector<double> *PajeContainer::integralOfType (PajeType *type)
+{
+  std::map<PajeType*,std::vector<double> >::iterator found = integrals.find (type);
+  return found != integrals.end() ? &found->second : NULL;
+}
+
+//restoreContainer: a child container, without event, to be restoreEnd'ed
+PajeContainer *PajeContainer::restoreContainer (double start, std::string name, std::string alias, PajeType *type)
+{
+  PajeContainer *newContainer = new (&arena) PajeContainer (start, name, alias, this, type, NULL, stopSimulationAtTime);
+  children[newContainer->identifier()] = newContainer;
+  return newContainer;
+}
+
+//restoreEnd: the container is destroyed at end, its entities are already finished
+void PajeContainer::restoreEnd (double end)
+{
+  _destroyed = true;
+  setEndTime (end);
+}
+
+PajeTimeline *PajeContainer::restoreTimeline (PajeType *type)
+{
+  return timelineForType (type);
+}
+
+//restoreIntervalIndex: the index of type, which buildIntervalIndex then keeps
+PajeIntervalIndex *PajeContainer::restoreIntervalIndex (PajeType *type)
+{
+  return &intervals[type];
+}
+
+std::vector<double> *PajeContainer::restoreIntegral (PajeType *type)
+{
+  return &integrals[type];
+}
+
+//restoreLink: a completed link, whose end the caller sets
+PajeUserLink *PajeContainer::restoreLink (PajeType *type, double start, PajeValue *value, std::string key, PajeContainer *startContainer)
+{
+  PajeUserLink *link = new (entityArena()) PajeUserLink (this, type, start, value, key, startContainer, NULL);
+  entities[type].push_back (link);
+  return link;
+}
+
 std::string PajeContainer::description (void) const
 {
   std::stringstream description;
@@ -170,16 +552,11 @@ bool PajeContainer::checkPendingLinks (void)
 {
   std::vector<PajeUserLink*> invalidLinks;
 
-  std::map<PajeType*,std::map<std::string,PajeUserLink*> >::iterator it;
-  for (it = pendingLinks.begin(); it != pendingLinks.end(); it++){
-    std::map<std::string,PajeUserLink*> x = ((*it).second);
-    if (x.size() == 0) continue;
-
-    std::map<std::string,PajeUserLink*>::iterator it2;
-    for (it2 = x.begin(); it2 != x.end(); it2++){
-      invalidLinks.push_back ((*it2).second);
-    }
-    if (!x.empty()){
+  std::map<PajeType*,PajeLinkKeys*>::iterator it;
+  for (it = linkKeys.begin(); it != linkKeys.end(); it++){
+    (*it).second->pendingLinks (&invalidLinks);
+    if (!invalidLinks.empty()){
+      std::sort (invalidLinks.begin(), invalidLinks.end(), linkKeyOrder);
       //report
       std::cout << "List of incomplete links in container '" << name() << "':" << std::endl;
       std::vector<PajeUserLink*>::iterator it;
@@ -222,6 +599,10 @@ void PajeContainer::demuxer (PajeEvent *event)
 
   //update container endtime
   setEndTime (event->time());
+
+  if (sink){
+    evict (event->type());
+  }
 }
 
 void PajeContainer::pajeNewEvent (PajeEvent *event)
@@ -232,7 +613,12 @@ void PajeContainer::pajeNewEvent (PajeEvent *event)
   PajeTraceEvent *traceEvent = event->traceEvent();
 
   checkTimeOrder (event);
-  PajeUserEvent *n = new PajeUserEvent(this, type, time, value, traceEvent);
+  PajeTimeline *timeline = timelineForType (type);
+  if (timeline){
+    timeline->append (time, value, 0, 0, traceEvent);
+    return;
+  }
+  PajeUserEvent *n = new (entityArena()) PajeUserEvent (this, type, time, value, traceEvent);
   entities[type].push_back (n);
 }
 
@@ -246,7 +632,17 @@ void PajeContainer::pajeSetState (PajeEvent *event)
   checkTimeOrder (event);
   pajeResetState (event);
 
-  PajeUserState *state = new PajeUserState (this, type, time, value, traceEvent);
+  PajeTimeline *timeline = timelineForType (type);
+  if (timeline){
+    timeline->stack.push_back (timeline->append (time, value, 0, 0, traceEvent));
+    return;
+  }
+
+  if (reopenState (type, time, value, 0)){
+    return;
+  }
+
+  PajeUserState *state = new (entityArena()) PajeUserState (this, type, time, value, traceEvent);
   entities[type].push_back (state);
 
   std::vector<PajeUserState*> *stack = &stackStates[type];
@@ -262,12 +658,23 @@ void PajeContainer::pajePushState (PajeEvent *event)
 
   checkTimeOrder (event);
 
+  PajeTimeline *timeline = timelineForType (type);
+  if (timeline){
+    int imbrication = timeline->stack.empty() ? 0 : timeline->imbrication[timeline->stack.back()] + 1;
+    timeline->stack.push_back (timeline->append (time, value, 0, imbrication, traceEvent));
+    return;
+  }
+
   std::vector<PajeUserState*> *stack = &stackStates[type];
 
   //define new imbrication level
   int imbrication = stack->empty() ? 0 : (stack->back())->imbricationLevel() + 1;
 
-  PajeUserState *state = new PajeUserState (this, type, time, value, imbrication, traceEvent);
+  if (reopenState (type, time, value, imbrication)){
+    return;
+  }
+
+  PajeUserState *state = new (entityArena()) PajeUserState (this, type, time, value, imbrication, traceEvent);
   entities[type].push_back (state);
   stack->push_back (state);
 }
@@ -280,6 +687,18 @@ void PajeContainer::pajePopState (PajeEvent *event)
 
   checkTimeOrder (event);
 
+  PajeTimeline *timeline = timelineForType (type);
+  if (timeline){
+    if (timeline->stack.empty()){
+      std::stringstream line;
+      line << *traceEvent;
+      throw PajeStateException ("Illegal pop event of a state that has no value in "+line.str());
+    }
+    timeline->setEndTime (timeline->stack.back(), time);
+    timeline->stack.pop_back();
+    return;
+  }
+
   //check if there is something in the stack
   std::vector<PajeUserState*> *stack = &stackStates[type];
   if (stack->empty()){
@@ -288,12 +707,10 @@ void PajeContainer::pajePopState (PajeEvent *event)
     throw PajeStateException ("Illegal pop event of a state that has no value in "+line.str());
   }
 
-  //update the top of the stack, set its endTime
+  //pop the stack, set the endTime of its top
   PajeUserState *last_stacked = stack->back();
-  last_stacked->setEndTime (time);
-
-  //pop the stack
   stack->pop_back();
+  finishState (type, last_stacked, time);
 }
 
 void PajeContainer::pajeResetState (PajeEvent *event)
@@ -304,12 +721,20 @@ void PajeContainer::pajeResetState (PajeEvent *event)
 
   checkTimeOrder (event);
 
+  PajeTimeline *timeline = timelineForType (type);
+  if (timeline){
+    for (size_t i = 0; i < timeline->stack.size(); i++){
+      timeline->setEndTime (timeline->stack[i], time);
+    }
+    timeline->stack.clear();
+    return;
+  }
+
   //clean the stack, using time as endTime
   std::vector<PajeUserState*> *stack = &stackStates[type];
   std::vector<PajeUserState*>::iterator it;
   for (it = stack->begin(); it != stack->end(); it++){
-    PajeUserState *state = (*it);
-    state->setEndTime (time);
+    finishState (type, *it, time);
   }
   stack->clear();
 }
@@ -321,6 +746,22 @@ void PajeContainer::pajeSetVariable (PajeEvent *event)
   double value = event->doubleValue();
   PajeTraceEvent *traceEvent = event->traceEvent();
 
+  PajeTimeline *timeline = timelineForType (type);
+  if (timeline){
+    if (timeline->size()){
+      size_t last = timeline->size() - 1;
+      checkTimeOrder (event);
+      if (timeline->start[last] == time){
+        //only update last value
+        timeline->doubleValue[last] = value;
+        return;
+      }else{
+        timeline->end[last] = time;
+      }
+    }
+    timeline->append (time, NULL, value, 0, traceEvent);
+    return;
+  }
 
   PajeEntity *last = NULL;
   if (entities[type].size() != 0){
@@ -328,6 +769,9 @@ void PajeContainer::pajeSetVariable (PajeEvent *event)
   }
   if (last){
     checkTimeOrder (event);
+    if (compactVariable (type, last, time, value)){
+      return;
+    }
     if (last->startTime() == time){
       //only update last value
       last->setDoubleValue (value);
@@ -338,7 +782,7 @@ void PajeContainer::pajeSetVariable (PajeEvent *event)
   }
 
   //create new
-  PajeUserVariable *val = new PajeUserVariable (this, type, time, value, traceEvent);
+  PajeUserVariable *val = new (entityArena()) PajeUserVariable (this, type, time, value, traceEvent);
   entities[type].push_back(val);
 }
 
@@ -349,7 +793,7 @@ void PajeContainer::pajeAddVariable (PajeEvent *event)
   double value = event->doubleValue();
   PajeTraceEvent *traceEvent = event->traceEvent();
 
-  if (entities[type].size() == 0){
+  if (numberOfEntitiesTyped (type) == 0){
     std::stringstream line;
     line << *traceEvent;
     throw PajeVariableException ("Illegal addition to a variable that has no value (yet) in "+line.str());
@@ -357,10 +801,27 @@ void PajeContainer::pajeAddVariable (PajeEvent *event)
 
   checkTimeOrder (event);
 
+  PajeTimeline *timeline = timelineForType (type);
+  if (timeline){
+    size_t last = timeline->size() - 1;
+    if (timeline->start[last] == time){
+      //only update last value
+      timeline->doubleValue[last] += value;
+    }else{
+      timeline->end[last] = time;
+      timeline->append (time, NULL, timeline->doubleValue[last] + value, 0, traceEvent);
+    }
+    return;
+  }
+
   double lastValue = 0;
   if (entities.count(type)){
     if (!entities[type].empty()){
       PajeEntity *last = entities[type].back();
+      lastValue = variableValue (type, last);
+      if (compactVariable (type, last, time, lastValue + value)){
+        return;
+      }
       if (last->startTime() == time){
         //only update last value
         last->addDoubleValue (value);
@@ -368,11 +829,10 @@ void PajeContainer::pajeAddVariable (PajeEvent *event)
       }else{
         last->setEndTime (time);
       }
-      lastValue = last->doubleValue();
     }
   }
   //create new
-  PajeUserVariable *val = new PajeUserVariable (this, type, time, lastValue + value, traceEvent);
+  PajeUserVariable *val = new (entityArena()) PajeUserVariable (this, type, time, lastValue + value, traceEvent);
   entities[type].push_back(val);
 }
 
@@ -383,7 +843,7 @@ void PajeContainer::pajeSubVariable (PajeEvent *event)
   double value = event->doubleValue();
   PajeTraceEvent *traceEvent = event->traceEvent();
 
-  if (entities[type].size() == 0){
+  if (numberOfEntitiesTyped (type) == 0){
     std::stringstream line;
     line << *traceEvent;
     throw PajeVariableException ("Illegal subtraction from a variable that has no value (yet) in "+line.str());
@@ -391,10 +851,27 @@ void PajeContainer::pajeSubVariable (PajeEvent *event)
 
   checkTimeOrder (event);
 
+  PajeTimeline *timeline = timelineForType (type);
+  if (timeline){
+    size_t last = timeline->size() - 1;
+    if (timeline->start[last] == time){
+      //only update last value
+      timeline->doubleValue[last] -= value;
+    }else{
+      timeline->end[last] = time;
+      timeline->append (time, NULL, timeline->doubleValue[last] - value, 0, traceEvent);
+    }
+    return;
+  }
+
   double lastValue = 0;
   if (entities.count(type)){
     if (!entities[type].empty()){
       PajeEntity *last = entities[type].back();
+      lastValue = variableValue (type, last);
+      if (compactVariable (type, last, time, lastValue - value)){
+        return;
+      }
       if (last->startTime() == time){
         //only update last value
         last->subtractDoubleValue (value);
@@ -402,12 +879,11 @@ void PajeContainer::pajeSubVariable (PajeEvent *event)
       }else{
         last->setEndTime (time);
       }
-      lastValue = last->doubleValue();
     }
   }
 
   //create new
-  PajeUserVariable *val = new PajeUserVariable (this, type, time, lastValue - value, traceEvent);
+  PajeUserVariable *val = new (entityArena()) PajeUserVariable (this, type, time, lastValue - value, traceEvent);
   entities[type].push_back(val);
 }
 
@@ -415,24 +891,26 @@ void PajeContainer::pajeStartLink (PajeEvent *event)
 {
   double time = event->time();
   PajeType *type = event->type();
-  std::string key = event->key();
+  const std::string &key = event->key();
   PajeValue *value = event->value();
   PajeTraceEvent *traceEvent = event->traceEvent();
   PajeContainer *startContainer = event->startContainer();
 
-  if (linksUsedKeys[type].count(key)){
+  PajeLinkKeys *keys = linkKeysForType (type);
+  paje_link_key number = PajeLinkKeys::keyFor (key);
+  if (keys->isUsed (number, key)){
     std::stringstream eventdesc;
     eventdesc << *traceEvent;
     throw PajeLinkException ("Illegal event in "+eventdesc.str()+", the key was already used for another link");
   }
 
-  if (pendingLinks[type].count(key) == 0){
-    PajeUserLink *link = new PajeUserLink(this, type, time, value, key, startContainer, traceEvent);
-    pendingLinks[type].insert (std::make_pair(key, link));
+  PajeUserLink *link = keys->pendingLink (number, key);
+  if (!link){
+    link = new (entityArena()) PajeUserLink (this, type, time, value, key, startContainer, traceEvent);
+    keys->addPendingLink (number, link);
 
   }else{
     //there is a PajeEndLink
-    PajeUserLink *link = (pendingLinks[type].find(key))->second;
     link->setStartTime (time);
     link->setStartContainer (startContainer);
     link->addPajeTraceEvent (traceEvent);
@@ -451,8 +929,7 @@ void PajeContainer::pajeStartLink (PajeEvent *event)
     entities[type].push_back(link);
 
     //remove the link for the temporary pool, add the key to usedKeys
-    pendingLinks[type].erase(key);
-    linksUsedKeys[type].insert(key);
+    keys->completeLink (number, key);
   }
 }
 
@@ -460,27 +937,29 @@ void PajeContainer::pajeEndLink (PajeEvent *event)
 {
   double time = event->time();
   PajeType *type = event->type();
-  std::string key = event->key();
+  const std::string &key = event->key();
   PajeValue *value = event->value();
   PajeTraceEvent *traceEvent = event->traceEvent();
   PajeContainer *endContainer = event->endContainer();
 
-  if (linksUsedKeys[type].count(key)){
+  PajeLinkKeys *keys = linkKeysForType (type);
+  paje_link_key number = PajeLinkKeys::keyFor (key);
+  if (keys->isUsed (number, key)){
     std::stringstream eventdesc;
     eventdesc << *traceEvent;
     throw PajeLinkException ("Illegal event in "+eventdesc.str()+", the key was already used for another link");
   }
 
-  if (pendingLinks[type].count(key) == 0){
+  PajeUserLink *link = keys->pendingLink (number, key);
+  if (!link){
     //there is no corresponding PajeStartLink
-    PajeUserLink *link = new PajeUserLink(this, type, -1, value, key, NULL, traceEvent);
+    link = new (entityArena()) PajeUserLink (this, type, -1, value, key, NULL, traceEvent);
     link->setEndContainer (endContainer);
     link->setEndTime (time);
-    pendingLinks[type].insert (std::make_pair(key, link));
+    keys->addPendingLink (number, link);
 
   }else{
     //there is a PajeStartLink
-    PajeUserLink *link = (pendingLinks[type].find(key))->second;
     link->setEndContainer (endContainer);
     link->setEndTime (time);
     link->addPajeTraceEvent (traceEvent);
@@ -499,8 +978,7 @@ void PajeContainer::pajeEndLink (PajeEvent *event)
     entities[type].push_back(link);
 
     //remove the link for the temporary pool, add the key to usedKeys
-    pendingLinks[type].erase(key);
-    linksUsedKeys[type].insert(key);
+    keys->completeLink (number, key);
   }
 }
 
@@ -523,21 +1001,215 @@ void PajeContainer::recursiveDestroy (double time)
   }
 }
 
-std::vector<PajeEntity*> PajeContainer::enumeratorOfEntitiesTyped (double start, double end, PajeType *type)
+//PajeEntityRows: the entities of a type, as rows of a PajeIntervalIndex
+struct PajeEntityRows {
+  const std::vector<PajeEntity*> *entities;
+  double startTime (size_t row) const { return (*entities)[row]->startTime(); }
+  double endTime (size_t row) const { return (*entities)[row]->endTime(); }
+  double value (size_t row) const { return (*entities)[row]->doubleValue(); }
+};
+
+//PajeVariableRows: the columns of a variable timeline, as rows
+struct PajeVariableRows {
+  const PajeTimeline *timeline;
+  double startTime (size_t row) const { return timeline->start[row]; }
+  double endTime (size_t row) const { return timeline->end[row]; }
+  double value (size_t row) const { return timeline->doubleValue[row]; }
+};
+
+//windows of fewer rows are integrated row by row
+#define PAJE_INTEGRAL_SCAN_ROWS 32
+
+/*
+ * cumulativeIntegral: the integral of the values of a variable up to
+ * each row, count+1 of them, if its rows follow each other in time.
+ */
+template <class Rows>
+static bool cumulativeIntegral (const Rows &rows, size_t count, std::vector<double> *cumulative)
 {
-  std::vector<PajeEntity*> empty;
-  if (entities[type].size() == 0) return empty;
+  cumulative->assign (1, 0);
+  for (size_t i = 0; i < count; i++){
+    double s = rows.startTime (i);
+    double e = rows.endTime (i);
+    if (e < s || (i && (s < rows.startTime (i - 1) || e < rows.endTime (i - 1)))){
+      cumulative->clear ();
+      return false;
+    }
+    cumulative->push_back (cumulative->back() + (e - s) * rows.value (i));
+  }
+  return true;
+}
+
+/*
+ * integrate: the time integration of a variable in [start,end] with
+ * its cumulative integral, from the rows at both ends of the window.
+ */
+template <class Rows>
+static double integrate (const Rows &rows, const std::vector<double> &cumulative, double start, double end)
+{
+  size_t count = cumulative.size() - 1;
+  double tsDuration = end - start;
+
+  //the first row ending at or after start, the first starting at or after end
+  size_t low = 0, high = count;
+  while (low < high){
+    size_t middle = low + (high - low) / 2;
+    if (rows.endTime (middle) < start){
+      low = middle + 1;
+    }else{
+      high = middle;
+    }
+  }
+  size_t first = low;
+  high = count;
+  while (low < high){
+    size_t middle = low + (high - low) / 2;
+    if (rows.startTime (middle) < end){
+      low = middle + 1;
+    }else{
+      high = middle;
+    }
+  }
+  size_t up = low;
+  if (first >= up) return 0;
+
+  if (up - first < PAJE_INTEGRAL_SCAN_ROWS){
+    double integrated = 0;
+    for (size_t i = first; i < up; i++){
+      double s = rows.startTime (i);
+      double e = rows.endTime (i);
+      double value = rows.value (i);
+      if (!value) continue;
+      if (s < start) s = start;
+      if (e > end) e = end;
+      integrated += (e - s)/tsDuration * value;
+    }
+    return integrated;
+  }
+
+  double integral = cumulative[up] - cumulative[first];
+  if (rows.startTime (first) < start){
+    integral -= (start - rows.startTime (first)) * rows.value (first);
+  }
+  if (rows.endTime (up - 1) > end){
+    integral -= (rows.endTime (up - 1) - end) * rows.value (up - 1);
+  }
+  return integral / tsDuration;
+}
+
+/*
+ * buildIntervalIndex: indexes the entities of each type by time, and
+ * integrates the variables cumulatively, for the window queries.
+ * Called when the simulation is over, as they do not change anymore.
+ * The types whose index was restored from a snapshot are kept as they
+ * are, with their integral if they had one.
+ */
+void PajeContainer::buildIntervalIndex (void)
+{
+  std::map<PajeType*,PajeTimeline*>::iterator k;
+  for (k = timelines.begin(); k != timelines.end(); k++){
+    PajeTimeline *timeline = (*k).second;
+    if (intervals.count ((*k).first)) continue;
+    if (timeline->size()){
+      intervals[(*k).first].build (*timeline, timeline->size());
+    }
+    if (timeline->size() && (*k).first->nature() == PAJE_VariableType){
+      PajeVariableRows rows;
+      rows.timeline = timeline;
+      if (!cumulativeIntegral (rows, timeline->size(), &integrals[(*k).first])){
+        integrals.erase ((*k).first);
+      }
+    }
+  }
+  std::map<PajeType*,std::vector<PajeEntity*> >::iterator j;
+  for (j = entities.begin(); j != entities.end(); j++){
+    if (!(*j).second.empty() && !timelines.count ((*j).first) && !intervals.count ((*j).first)){
+      PajeEntityRows rows;
+      rows.entities = &(*j).second;
+      intervals[(*j).first].build (rows, (*j).second.size());
+      if ((*j).first->nature() == PAJE_VariableType &&
+          !cumulativeIntegral (rows, (*j).second.size(), &integrals[(*j).first])){
+        integrals.erase ((*j).first);
+      }
+    }
+  }
 
-  std::vector<PajeEntity*>::iterator low, up, it;
-  low = lower_bound (entities[type].begin(), entities[type].end(), start, PajeEntity::PajeEntityCompare());
-  up = lower_bound (entities[type].begin(), entities[type].end(), end, PajeEntity::PajeEntityCompare());
+  std::map<std::string,PajeContainer*>::iterator it;
+  for (it = children.begin(); it != children.end(); it++){
+    ((*it).second)->buildIntervalIndex ();
+  }
+}
+
+/*
+ * overlappingRows: the rows, in the timeline or the entities of type,
+ * that start before end and end at or after start. Before the interval
+ * index is built, the rows starting in the window and the one before.
+ */
+void PajeContainer::overlappingRows (double start, double end, PajeType *type, std::vector<size_t> *rows)
+{
+  rows->clear ();
+  PajeTimeline *timeline = NULL;
+  std::map<PajeType*,PajeTimeline*>::iterator found = timelines.find (type);
+  if (found != timelines.end()){
+    timeline = found->second;
+  }
+
+  std::map<PajeType*,PajeIntervalIndex>::iterator index = intervals.find (type);
+  if (index != intervals.end()){
+    if (timeline){
+      index->second.overlapping (*timeline, start, end, rows);
+    }else{
+      PajeEntityRows entityRows;
+      entityRows.entities = &entities[type];
+      index->second.overlapping (entityRows, start, end, rows);
+    }
+    return;
+  }
 
-  if (low != entities[type].begin()){
+  size_t low, up;
+  if (timeline){
+    low = timeline->lowerBound (start);
+    up = timeline->lowerBound (end);
+  }else{
+    std::vector<PajeEntity*> &list = entities[type];
+    low = lower_bound (list.begin(), list.end(), start, PajeEntity::PajeEntityCompare()) - list.begin();
+    up = lower_bound (list.begin(), list.end(), end, PajeEntity::PajeEntityCompare()) - list.begin();
+  }
+  if (low != 0){
     low--;
   }
+  for (size_t i = low; i < up; i++){
+    rows->push_back (i);
+  }
+}
 
-  for (it = low; it != up; it++){
-    empty.push_back (*it);
+std::vector<PajeEntity*> PajeContainer::enumeratorOfEntitiesTyped (double start, double end, PajeType *type)
+{
+  std::vector<PajeEntity*> empty;
+  std::vector<size_t> rows;
+  std::map<PajeType*,PajeTimeline*>::iterator found = timelines.find (type);
+  if (found != timelines.end()){
+    //the entities of the previous enumeration are released
+    std::vector<PajeEntity*> *previous = &timelineEntities[type];
+    for (size_t i = 0; i < previous->size(); i++){
+      delete (*previous)[i];
+    }
+    previous->clear();
+
+    PajeTimeline *timeline = found->second;
+    overlappingRows (start, end, type, &rows);
+    for (size_t i = 0; i < rows.size(); i++){
+      empty.push_back (timeline->entityAtIndex (rows[i]));
+    }
+    *previous = empty;
+    return empty;
+  }
+  if (entities[type].size() == 0) return empty;
+
+  overlappingRows (start, end, type, &rows);
+  std::vector<PajeEntity*> &list = entities[type];
+  for (size_t i = 0; i < rows.size(); i++){
+    empty.push_back (list[rows[i]]);
   }
   return empty;
 }
@@ -545,7 +1217,7 @@ std::vector<PajeEntity*> PajeContainer::enumeratorOfEntitiesTyped (double start,
 PajeAggregatedDict PajeContainer::timeIntegrationOfTypeInContainer (double start, double end, PajeType *type)
 {
   PajeAggregatedDict ret;
-  if (entities[type].size() == 0) return ret;
+  if (numberOfEntitiesTyped (type) == 0) return ret;
   if (type->nature() == PAJE_LinkType) return ret;
 
   if (type->nature() == PAJE_StateType){
@@ -556,29 +1228,52 @@ PajeAggregatedDict PajeContainer::timeIntegrationOfTypeInContainer (double start
   return ret;
 }
 
+/*
+ * accumulate: adds integrated to the entry of the value of type in
+ * dict, the keys are compared by name so one is allocated per value.
+ */
+static void accumulate (PajeAggregatedDict *dict, PajeType *type, PajeValue *value, double integrated)
+{
+  PajeAggregatedType *agtype = new PajeAggregatedType (type, value);
+  PajeAggregatedDict::iterator found = dict->find (agtype);
+  if (found != dict->end()){
+    found->second += integrated;
+    delete agtype;
+  }else{
+    (*dict)[agtype] = integrated;
+  }
+}
+
 PajeAggregatedDict PajeContainer::timeIntegrationOfStateTypeInContainer (double start, double end, PajeType *type)
 {
   PajeAggregatedDict ret;
-  std::vector<PajeEntity*> slice = enumeratorOfEntitiesTyped (start, end, type);
   double tsDuration = end - start;
+  PajeTimeline *timeline = timelineForType (type);
+  if (timeline){
+    //scan the columns, without creating the entities
+    std::vector<size_t> rows;
+    overlappingRows (start, end, type, &rows);
+    for (size_t r = 0; r < rows.size(); r++){
+      size_t i = rows[r];
+      double s = timeline->start[i];
+      double e = timeline->end[i];
+      if (s < start) s = start;
+      if (e > end) e = end;
+      if (e <= s) continue;
+      accumulate (&ret, type, timeline->valueAtIndex (i), (e - s)/tsDuration);
+    }
+    return ret;
+  }
+  std::vector<PajeEntity*> slice = enumeratorOfEntitiesTyped (start, end, type);
   std::vector<PajeEntity*>::iterator it;
   for (it = slice.begin(); it != slice.end(); it++){
     PajeEntity *var = *it;
     double s = var->startTime();
     double e = var->endTime();
-    if (!var->doubleValue()) continue;
     if (s < start) s = start;
     if (e > end) e = end;
-    double duration = e - s;
-    double var_integrated = duration/tsDuration;
-
-    PajeAggregatedType *agtype = new PajeAggregatedType (type, var->value());
-    PajeAggregatedDict::iterator found = ret.find (agtype);
-    if (found != ret.end()){
-      ret[agtype] += var_integrated;
-    }else{
-      ret[agtype] = var_integrated;
-    }
+    if (e <= s) continue;
+    accumulate (&ret, type, var->value(), (e - s)/tsDuration);
   }
   return ret;
 }
@@ -586,21 +1281,49 @@ PajeAggregatedDict PajeContainer::timeIntegrationOfStateTypeInContainer (double
 PajeAggregatedDict PajeContainer::timeIntegrationOfVariableTypeInContainer (double start, double end, PajeType *type)
 {
   PajeAggregatedDict ret;
-
-  std::vector<PajeEntity*> slice = enumeratorOfEntitiesTyped (start, end, type);
   double integrated = 0;
   double tsDuration = end - start;
-  std::vector<PajeEntity*>::iterator it;
-  for (it = slice.begin(); it != slice.end(); it++){
-    PajeEntity *var = *it;
-    double s = var->startTime();
-    double e = var->endTime();
-    if (!var->doubleValue()) continue;
-    if (s < start) s = start;
-    if (e > end) e = end;
-    double duration = e - s;
-    double var_integrated = duration/tsDuration * var->doubleValue();
-    integrated += var_integrated;
+
+  PajeTimeline *timeline = timelineForType (type);
+  std::map<PajeType*,std::vector<double> >::iterator cumulative = integrals.find (type);
+  if (cumulative != integrals.end()){
+    if (timeline){
+      PajeVariableRows rows;
+      rows.timeline = timeline;
+      integrated = integrate (rows, cumulative->second, start, end);
+    }else{
+      PajeEntityRows rows;
+      rows.entities = &entities[type];
+      integrated = integrate (rows, cumulative->second, start, end);
+    }
+  }else if (timeline){
+    //scan the columns, without creating the entities
+    std::vector<size_t> rows;
+    overlappingRows (start, end, type, &rows);
+    for (size_t r = 0; r < rows.size(); r++){
+      size_t i = rows[r];
+      double s = timeline->start[i];
+      double e = timeline->end[i];
+      double value = timeline->doubleValue[i];
+      if (!value) continue;
+      if (s < start) s = start;
+      if (e > end) e = end;
+      integrated += (e - s)/tsDuration * value;
+    }
+  }else{
+    std::vector<PajeEntity*> slice = enumeratorOfEntitiesTyped (start, end, type);
+    std::vector<PajeEntity*>::iterator it;
+    for (it = slice.begin(); it != slice.end(); it++){
+      PajeEntity *var = *it;
+      double s = var->startTime();
+      double e = var->endTime();
+      if (!var->doubleValue()) continue;
+      if (s < start) s = start;
+      if (e > end) e = end;
+      double duration = e - s;
+      double var_integrated = duration/tsDuration * var->doubleValue();
+      integrated += var_integrated;
+    }
   }
 
   if (integrated){
@@ -677,6 +1400,20 @@ bool PajeContainer::checkTimeOrder (PajeEvent *event)
 
 bool PajeContainer::checkTimeOrder (double time, PajeType *type, PajeTraceEvent *traceEvent)
 {
+  PajeTimeline *timeline = timelineForType (type);
+  if (timeline){
+    if (timeline->size()){
+      size_t last = timeline->size() - 1;
+      double end = timeline->endTime (last);
+      if (timeline->start[last] > time || (end != -1 && end > time)){
+        std::stringstream eventdesc;
+        eventdesc << *traceEvent;
+        throw PajeSimulationException ("Illegal, trace is not time-ordered in "+eventdesc.str());
+      }
+    }
+    return true;
+  }
+
   std::vector<PajeEntity*> *v = &entities[type];
   if (!v->empty()){
     PajeEntity *last = entities[type].back();
@@ -702,7 +1439,7 @@ PajeContainer *PajeContainer::pajeCreateContainer (double time, PajeType *type,
     throw PajeSimulationException ("Trying to create a container of a type that is not a container type in "+eventdesc.str());
   }
 
-  PajeContainer *newContainer = new PajeContainer (time, name, alias, this, type, event, stopat);
+  PajeContainer *newContainer = new (&arena) PajeContainer (time, name, alias, this, type, event, stopat);
   children[newContainer->identifier()] = newContainer;
   return newContainer;
 }
@@ -743,6 +1480,16 @@ void PajeContainer::destroy (double time)
       }
     }
   }
+  std::map<PajeType*,PajeTimeline*>::iterator it4;
+  for (it4 = timelines.begin(); it4 != timelines.end(); it4++){
+    PajeTimeline *timeline = (*it4).second;
+    if (timeline->size()){
+      size_t last = timeline->size() - 1;
+      if (timeline->endTime (last) == -1){
+        timeline->setEndTime (last, time);
+      }
+    }
+  }
 
   //check pendingLinks
   if (!ignoreIncompleteLinks){
@@ -761,4 +1508,25 @@ void PajeContainer::destroy (double time)
     }
     stack->clear();
   }
+  for (it4 = timelines.begin(); it4 != timelines.end(); it4++){
+    PajeTimeline *timeline = (*it4).second;
+    for (size_t i = 0; i < timeline->stack.size(); i++){
+      timeline->setEndTime (timeline->stack[i], time);
+    }
+    timeline->stack.clear();
+  }
+
+  //everything is finished now
+  if (sink){
+    sink->entityFinished (this);
+    for (it1 = entities.begin(); it1 != entities.end(); it1++){
+      std::vector<PajeEntity*> *list = &(*it1).second;
+      for (size_t i = 0; i < list->size(); i++){
+        sink->entityFinished ((*list)[i]);
+        releaseEntity ((*list)[i]);
+      }
+      releasedEntities += list->size();
+      list->clear();
+    }
+  }
 }
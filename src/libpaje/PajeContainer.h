@@ -24,10 +24,27 @@
 #include "PajeTraceEvent.h"
 #include "PajeEvent.h"
 #include "PajeEntity.h"
+#include "PajeTimeline.h"
+#include "PajeIntervalIndex.h"
+#include "PajeLinkKeys.h"
 
 class PajeContainer;
 class PajeEvent;
 
+/*
+ * PajeEntitySink: receives the entities of a streaming simulation as
+ * soon as they are finished, and containers when they are destroyed.
+ * Entities are released with releaseEntity after entityFinished. With
+ * simulation threads, it is still called in trace order by the thread
+ * reading the trace, see PajeShardSink.
+ */
+class PajeEntitySink {
+public:
+  virtual ~PajeEntitySink (void) {}
+  virtual void entityFinished (PajeEntity *entity) = 0;
+  virtual void releaseEntity (PajeEntity *entity) { delete entity; }
+};
+
 class PajeContainer : public PajeNamedEntity {
 private:
   double stopSimulationAtTime;
@@ -40,15 +57,46 @@ public:
   int depth;
 
 private:
-  std::map<PajeType*,std::set<std::string> > linksUsedKeys; //all used keys for this container
-  std::map<PajeType*,std::map<std::string,PajeUserLink*> > pendingLinks; //all pending links
+  //the entities and child containers of this container live here
+  PajeArena arena;
+
+  std::map<PajeType*,PajeLinkKeys*> linkKeys; //pending links and used keys
+  paje_link_key_strategy linkKeyStrategy;
   std::map<PajeType*,std::vector<PajeUserState*> > stackStates; //the simulation stack for state types
 
   //keeps all simulated entities (variables, links, states and events)
   std::map<PajeType*,std::vector<PajeEntity*> > entities;
 
+  //with columnar storage, the states, events and variables instead
+  bool columnar;
+  std::map<PajeType*,PajeTimeline*> timelines;
+  std::map<PajeType*,std::vector<PajeEntity*> > timelineEntities; //last enumerated
+
+  //the entities by time, once the simulation is over, see buildIntervalIndex
+  std::map<PajeType*,PajeIntervalIndex> intervals;
+  std::map<PajeType*,std::vector<double> > integrals; //cumulative, of variables by row
+
+  //with a sink, finished entities are passed on and released
+  PajeEntitySink *sink;
+  int releasedEntities;
+
+  //for the types with a compaction, what it removed and exact variable values
+  std::map<PajeType*,paje_compaction_stats> compacted;
+  std::map<PajeType*,double> variableValues;
+
 private:
   void init (std::string alias, PajeContainer *parent);
+  PajeTimeline *timelineForType (PajeType *type);
+  PajeArena *entityArena (void);
+  PajeLinkKeys *linkKeysForType (PajeType *type);
+  void releaseEntity (PajeEntity *entity);
+  void evict (PajeType *type);
+  bool compactVariable (PajeType *type, PajeEntity *last, double time, double value);
+  double variableValue (PajeType *type, PajeEntity *last);
+  bool reopenState (PajeType *type, double time, PajeValue *value, int imbrication);
+  void finishState (PajeType *type, PajeUserState *state, double time);
+  size_t numberOfEntitiesTyped (PajeType *type);
+  void overlappingRows (double start, double end, PajeType *type, std::vector<size_t> *rows);
 
 public:
   PajeContainer (double time, std::string name, std::string alias, PajeContainer *parent, PajeType *type, PajeTraceEvent *event);
@@ -62,6 +110,25 @@ public:
   std::vector<PajeContainer*> getChildren (void);
   bool isAncestorOf (PajeContainer *c);
   bool keepSimulating (void);
+  bool isDestroyed (void) const;
+  void openEntities (std::vector<PajeEntity*> *open);
+  void setColumnar (bool columnar);
+  void setEntitySink (PajeEntitySink *sink);
+  void setLinkKeyStrategy (paje_link_key_strategy strategy);
+  void compactionStatistics (std::map<PajeType*,paje_compaction_stats> *total); //recursive
+
+  //snapshots of finished simulations, see PajeSimulator+Snapshot.cc
+  std::vector<PajeType*> entityTypes (void);
+  PajeTimeline *timelineOfType (PajeType *type);
+  const std::vector<PajeEntity*> &entitiesOfType (PajeType *type);
+  const PajeIntervalIndex *intervalIndexOfType (PajeType *type);
+  const std::vector<double> *integralOfType (PajeType *type);
+  PajeContainer *restoreContainer (double start, std::string name, std::string alias, PajeType *type);
+  void restoreEnd (double end);
+  PajeTimeline *restoreTimeline (PajeType *type);
+  PajeIntervalIndex *restoreIntervalIndex (PajeType *type);
+  std::vector<double> *restoreIntegral (PajeType *type);
+  PajeUserLink *restoreLink (PajeType *type, double start, PajeValue *value, std::string key, PajeContainer *startContainer);
 
   //entry method
   void demuxer (PajeEvent *event);
@@ -88,6 +155,7 @@ private:
 
 public:
   void recursiveDestroy (double time); //not a PajeSimulator event, EOF found
+  void buildIntervalIndex (void); //recursive, once entities are final, with integrals
 
   //queries
   std::vector<PajeEntity*> enumeratorOfEntitiesTyped (double start, double end, PajeType *type);
@@ -21,11 +21,22 @@ PajeData::PajeData (int capacity)
   this->bytes = (char*) malloc (capacity * sizeof(char));
   this->capacity = capacity;
   this->length = 0;
+  this->owner = true;
+}
+
+PajeData::PajeData (char *bytes, int length)
+{
+  this->bytes = bytes;
+  this->capacity = length;
+  this->length = length;
+  this->owner = false;
 }
 
 PajeData::~PajeData (void)
 {
-  free (bytes);
+  if (owner){
+    free (bytes);
+  }
 }
 
 void PajeData::increaseCapacityOf (int additionalCapacity)
@@ -25,8 +25,10 @@ public:
   char *bytes;
   int length;
   int capacity;
+  bool owner; //false if bytes points to memory owned by someone else
 
   PajeData (int capacity);
+  PajeData (char *bytes, int length); //a view, bytes are not copied
   ~PajeData (void);
   void increaseCapacityOf (int additionalCapacity);
 };
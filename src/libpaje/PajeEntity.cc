@@ -24,35 +24,65 @@ PajeEntity::PajeEntity (PajeContainer *container, PajeType *type, PajeTraceEvent
 {
   _container = container;
   _type = type;
+  extra = NULL;
 
   addPajeTraceEvent (event);
 }
 
+PajeEntity::~PajeEntity (void)
+{
+  delete[] extra;
+}
+
+void *PajeEntity::operator new (size_t size)
+{
+  return ::operator new (size);
+}
+
+//without an arena, the entity is on the heap and released by delete
+void *PajeEntity::operator new (size_t size, PajeArena *arena)
+{
+  return arena ? arena->allocate (size) : ::operator new (size);
+}
+
+void PajeEntity::operator delete (void *pointer)
+{
+  ::operator delete (pointer);
+}
+
+//only called if the constructor of an entity in an arena throws
+void PajeEntity::operator delete (void *pointer, PajeArena *arena)
+{
+  if (!arena){
+    ::operator delete (pointer);
+  }
+}
+
 void PajeEntity::addPajeTraceEvent (PajeTraceEvent *event)
 {
-  if (!event) return;
-
-  PajeEventDefinition *def = event->definition();
-  std::vector<std::string> extra = def->extraFields();
-  std::vector<std::string>::iterator it;
-  for (it = extra.begin(); it != extra.end(); it++){
-    std::string fieldName = *it;
-    std::string value = event->valueForExtraField (fieldName);
-
-    //check if fieldName already exists
-    if (extraFields.count(fieldName)){
-      //if it does, check if value is NOT the same
-      if (extraFields[fieldName] != value){
-        std::stringstream line;
-        line << *event;
-        throw PajeDecodeException ("When treating event "+line.str()+", the value for "+fieldName+" is "+extraFields[fieldName]+", but it is different from "+value);
-      }
-    }else{
-      extraFields[fieldName] = value;
-    }
+  if (!PajeExtraFields::hasFields (event) || !_type) return;
+  std::vector<unsigned int> record;
+  _type->extraFields()->collect (event, extra, &record);
+  setExtraFields (&record[0]);
+}
+
+//setExtraFields: the entity gets a copy of record, NULL removes its fields
+void PajeEntity::setExtraFields (const unsigned int *record)
+{
+  delete[] extra;
+  extra = NULL;
+  if (record){
+    size_t length = PajeExtraFields::length (record);
+    extra = new unsigned int[length];
+    memcpy (extra, record, length * sizeof (unsigned int));
   }
 }
 
+const unsigned int *PajeEntity::extraFields (void) const
+{
+  return extra;
+}
+
 PajeContainer *PajeEntity::container (void) const
 {
   return _container;
@@ -96,8 +126,10 @@ void PajeEntity::subtractDoubleValue (double value)
 {
 }
 
+//doubleValue: 0 for the entities that have no double value
 double PajeEntity::doubleValue (void) const
 {
+  return 0;
 }
 
 PajeContainer *PajeEntity::startContainer (void) const
@@ -117,22 +149,18 @@ int PajeEntity::imbricationLevel (void) const
 
 std::string PajeEntity::extraDescription (bool printComma) const
 {
-  if (extraFields.size() == 0) return std::string();
+  if (!extra) return std::string();
+  paje_extra_list fields = _type->extraFields()->fields (extra);
 
   std::stringstream description;
   if (printComma){
     description << ", ";
   }
-  std::map<std::string,std::string>::const_iterator it;
-  for (it = extraFields.begin(); it != extraFields.end(); it++){
-    description << (*it).second;
-
-    //look forward to see if we ouput a comma
-    it++;
-    if (it != extraFields.end()){
+  for (unsigned int i = 0; i < fields.size(); i++){
+    description << fields[i].second;
+    if (i + 1 < fields.size()){
       description << ", ";
     }
-    it--;
   }
   return description.str();
 }
@@ -233,6 +261,11 @@ PajeValue *PajeValueEntity::value (void) const
   return _value;
 }
 
+void PajeValueEntity::setValue (PajeValue *value)
+{
+  _value = value;
+}
+
 /**************************************************************
  * PajeNamedEntity
  */
@@ -383,6 +416,11 @@ PajeContainer *PajeUserLink::startContainer (void) const
   return startCont;
 }
 
+const std::string &PajeUserLink::linkKey (void) const
+{
+  return key;
+}
+
 void PajeUserLink::setStartContainer (PajeContainer *startContainer)
 {
   this->startCont = startContainer;
@@ -19,6 +19,7 @@
 #include "PajeObject.h"
 #include "PajeType.h"
 #include "PajeTraceEvent.h"
+#include "PajeArena.h"
 
 class PajeContainer;
 
@@ -28,6 +29,7 @@ class PajeContainer;
 class PajeVirtualEntity : public PajeObject
 {
 public:
+  virtual ~PajeVirtualEntity (void) {}
   virtual void addPajeTraceEvent (PajeTraceEvent *event) = 0; //for Paje[Start|End]Link
   virtual PajeContainer *container (void) const = 0;
   virtual PajeType *type (void) const = 0;
@@ -64,11 +66,25 @@ class PajeEntity : public PajeVirtualEntity
 private:
   PajeContainer *_container;
   PajeType *_type;
-  std::map<std::string,std::string> extraFields;
+  unsigned int *extra; //the user-defined fields, a record of the PajeExtraFields of the type
+
+  //not copied, the record of the fields belongs to the entity
+  PajeEntity (const PajeEntity &entity);
+  PajeEntity &operator= (const PajeEntity &entity);
 
 public:
   PajeEntity (PajeContainer *container, PajeType *type, PajeTraceEvent *event);
+  ~PajeEntity (void);
+
+  //an entity in an arena is destroyed by calling its destructor
+  static void *operator new (size_t size);
+  static void *operator new (size_t size, PajeArena *arena);
+  static void operator delete (void *pointer);
+  static void operator delete (void *pointer, PajeArena *arena);
+
   void addPajeTraceEvent (PajeTraceEvent *event);
+  void setExtraFields (const unsigned int *record);
+  const unsigned int *extraFields (void) const;
   PajeContainer *container (void) const;
   PajeType *type (void) const;
   const std::string &name (void) const;
@@ -140,6 +156,7 @@ private:
 public:
   PajeValueEntity (PajeContainer *container, PajeType *type, double time, PajeValue *value, PajeTraceEvent *event);
   PajeValue *value (void) const;
+  void setValue (PajeValue *value);
 };
 
 /*
@@ -215,6 +232,7 @@ private:
 public:
   PajeUserLink (PajeContainer *container, PajeType *type, double time, PajeValue *value, std::string key, PajeContainer *startContainer, PajeTraceEvent *event);
   std::string description (void) const;
+  const std::string &linkKey (void) const;
 
   void setStartContainer (PajeContainer *startContainer);
   void setEndContainer (PajeContainer *EndContainer);
@@ -16,10 +16,17 @@
 */
 #ifndef __PAJE_ENUM_H__
 #define __PAJE_ENUM_H__
+#include <stddef.h>
 
 #define PAJE_MAX_FIELDS 20
+/*
+ * paje_line: the words of a trace line, pointing into the chunk the
+ * line was read from. Words are not terminated, the chunk is left
+ * untouched; each word is length bytes long.
+ */
 typedef struct {
-    char *word[PAJE_MAX_FIELDS];
+    const char *word[PAJE_MAX_FIELDS];
+    size_t length[PAJE_MAX_FIELDS];
     int word_count;
     long long lineNumber;
 } paje_line;
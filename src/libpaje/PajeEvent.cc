@@ -24,11 +24,9 @@ PajeEvent::PajeEvent (PajeTraceEvent *event, PajeContainer *container, PajeType
   _type = type;
 
   //extracing time
-  std::string t = _event->valueForField (PAJE_Time);
-  if (t.length() == 0){
-    PajeSimulationException ("Can't get time from trace event.");
+  if (!_event->doubleValueForField (PAJE_Time, &_time)){
+    _time = 0;
   }
-  _time = atof(t.c_str());
 }
 
 PajeTraceEvent *PajeEvent::traceEvent (void)
@@ -0,0 +1,302 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "PajeEventDecoder.h"
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#include <stdint.h>
+#define PAJE_VECTOR_TOKENIZER
+#endif
+
+/*
+ * The tokenizer of PajeEventDecoder. break_line splits the line that
+ * starts at s in words, recording where each word starts and how long
+ * it is, and returns the start of the next line. The chunk is never
+ * written to, so it can be a read-only mapping of the trace file. A
+ * word is a run of non-blank characters or a double-quoted string;
+ * '#' starts a comment that goes until the end of the line.
+ *
+ * The vectorized version looks for the next interesting character of
+ * the current state (end of word, start of word, end of string, end
+ * of comment) 16 or 32 bytes at a time. It only uses aligned loads,
+ * which never cross a page boundary, so it can look past the end of
+ * the line without faulting. Whitespace is the set of the C locale.
+ */
+
+//the word being read ends at end, if it got a slot in line
+static void end_word (paje_line *line, bool counted, const char *end)
+{
+  if (counted){
+    int last = line->word_count - 1;
+    line->length[last] = end - line->word[last];
+  }
+}
+
+static const char *break_line_scalar (const char *s, paje_line *line)
+{
+  bool in_string = false;
+  bool in_word = false;
+  bool counted = false;
+  const char *p;
+
+  for (p = s; *p != '\0'; p++) {
+    if (*p == '\n') {
+      if (in_string || in_word) {
+        end_word (line, counted, p);
+      }
+      return p + 1;
+    }
+    if (in_string) {
+      if (*p == '"') {
+        end_word (line, counted, p);
+        in_string = false;
+      }
+      continue;
+    }
+    if (*p == '#') {
+      if (in_word) {
+        end_word (line, counted, p);
+      }
+      while (true) {
+        p++;
+        if (*p == '\n') {
+          p++;
+          break;
+        } else if (*p == '\0') {
+          break;
+        }
+      }
+      return p;
+    }
+    if (in_word && isspace(*p)) {
+      end_word (line, counted, p);
+      in_word = false;
+      continue;
+    }
+    if (!in_word && !isspace(*p)) {
+      if (*p == '"') {
+        p++;
+        in_string = true;
+      } else {
+        in_word = true;
+      }
+      counted = line->word_count < PAJE_MAX_FIELDS;
+      if (counted) {
+        line->word[line->word_count] = p;
+        line->word_count ++;
+      }
+      continue;
+    }
+  }
+  if (in_string || in_word) {
+    end_word (line, counted, p);
+  }
+  return p;
+}
+
+#ifdef PAJE_VECTOR_TOKENIZER
+
+#define PAJE_TOKENIZER_BLOCK 32
+
+//one bit per byte of an aligned block of PAJE_TOKENIZER_BLOCK bytes
+typedef struct {
+  uint32_t blank;   //' ' or '\t' to '\r', so including '\n'
+  uint32_t newline;
+  uint32_t zero;
+  uint32_t quote;
+  uint32_t hash;
+} paje_tokenizer_masks;
+
+typedef void (*paje_classify_function) (const char *block, paje_tokenizer_masks *m);
+
+__attribute__((target("sse2")))
+static uint32_t classify_half_sse2 (__m128i v, uint32_t *newline, uint32_t *zero,
+                                    uint32_t *quote, uint32_t *hash)
+{
+  __m128i blank = _mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8(' ')),
+                                _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8('\t' - 1)),
+                                               _mm_cmplt_epi8 (v, _mm_set1_epi8('\r' + 1))));
+  *newline = _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, _mm_set1_epi8('\n')));
+  *zero = _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, _mm_setzero_si128()));
+  *quote = _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, _mm_set1_epi8('"')));
+  *hash = _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, _mm_set1_epi8('#')));
+  return _mm_movemask_epi8 (blank);
+}
+
+__attribute__((target("sse2")))
+static void classify_sse2 (const char *block, paje_tokenizer_masks *m)
+{
+  uint32_t newline, zero, quote, hash;
+  m->blank = classify_half_sse2 (_mm_load_si128 ((const __m128i*)block),
+                                 &m->newline, &m->zero, &m->quote, &m->hash);
+  m->blank |= classify_half_sse2 (_mm_load_si128 ((const __m128i*)(block + 16)),
+                                  &newline, &zero, &quote, &hash) << 16;
+  m->newline |= newline << 16;
+  m->zero |= zero << 16;
+  m->quote |= quote << 16;
+  m->hash |= hash << 16;
+}
+
+__attribute__((target("avx2")))
+static void classify_avx2 (const char *block, paje_tokenizer_masks *m)
+{
+  __m256i v = _mm256_load_si256 ((const __m256i*)block);
+  __m256i blank = _mm256_or_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8(' ')),
+                                   _mm256_and_si256 (_mm256_cmpgt_epi8 (v, _mm256_set1_epi8('\t' - 1)),
+                                                     _mm256_cmpgt_epi8 (_mm256_set1_epi8('\r' + 1), v)));
+  m->blank = _mm256_movemask_epi8 (blank);
+  m->newline = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8('\n')));
+  m->zero = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, _mm256_setzero_si256()));
+  m->quote = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8('"')));
+  m->hash = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8('#')));
+}
+
+//what paje_tokenizer_cursor::scan looks for
+typedef enum {
+  PAJE_SCAN_WORD_END,    //blank, '#' or '\0'
+  PAJE_SCAN_WORD_START,  //non-blank or '\n'
+  PAJE_SCAN_STRING_END,  //'"', '\n' or '\0'
+  PAJE_SCAN_COMMENT_END  //'\n' or '\0'
+} paje_scan_t;
+
+/*
+ * paje_tokenizer_cursor: classifies the block under the cursor once
+ * and answers every scan within it from the masks.
+ */
+class paje_tokenizer_cursor {
+  paje_classify_function classify;
+  const char *block;
+  paje_tokenizer_masks masks;
+
+  uint32_t select (paje_scan_t what) const
+  {
+    switch (what){
+    case PAJE_SCAN_WORD_END: return masks.blank | masks.hash | masks.zero;
+    case PAJE_SCAN_WORD_START: return ~masks.blank | masks.newline;
+    case PAJE_SCAN_STRING_END: return masks.quote | masks.newline | masks.zero;
+    default: return masks.newline | masks.zero;
+    }
+  }
+
+public:
+  paje_tokenizer_cursor (paje_classify_function f) : classify(f), block(NULL) {}
+
+  const char *scan (const char *p, paje_scan_t what)
+  {
+    const char *b = (const char*)((uintptr_t)p & ~(uintptr_t)(PAJE_TOKENIZER_BLOCK - 1));
+    if (b != block){
+      block = b;
+      classify (block, &masks);
+    }
+    uint32_t mask = select (what) & (0xffffffffu << (p - block));
+    while (mask == 0){
+      block += PAJE_TOKENIZER_BLOCK;
+      classify (block, &masks);
+      mask = select (what);
+    }
+    return block + __builtin_ctz (mask);
+  }
+
+  const char *skip_comment (const char *p)
+  {
+    p = scan (p + 1, PAJE_SCAN_COMMENT_END);
+    return *p == '\n' ? p + 1 : p;
+  }
+};
+
+/*
+ * break_line_vector: the same state machine as break_line_scalar,
+ * jumping from one interesting character to the next.
+ */
+static const char *break_line_vector (const char *p, paje_line *line, paje_classify_function classify)
+{
+  paje_tokenizer_cursor cursor(classify);
+  while (true) {
+    //between words
+    p = cursor.scan (p, PAJE_SCAN_WORD_START);
+    char c = *p;
+    if (c == '\n') {
+      return p + 1;
+    }
+    if (c == '\0') {
+      return p;
+    }
+    if (c == '#') {
+      return cursor.skip_comment (p);
+    }
+    bool counted = line->word_count < PAJE_MAX_FIELDS;
+    if (c == '"') {
+      //like break_line_scalar, the character after the quote is not checked
+      if (counted) {
+        line->word[line->word_count++] = p + 1;
+      }
+      p = cursor.scan (p + 2, PAJE_SCAN_STRING_END);
+      end_word (line, counted, p);
+      c = *p;
+      if (c == '"') {
+        p++;
+        continue;
+      }
+      return c == '\n' ? p + 1 : p;
+    }
+
+    //in a word
+    if (counted) {
+      line->word[line->word_count++] = p;
+    }
+    p = cursor.scan (p + 1, PAJE_SCAN_WORD_END);
+    end_word (line, counted, p);
+    c = *p;
+    if (c == '#') {
+      return cursor.skip_comment (p);
+    }
+    if (c == '\0') {
+      return p;
+    }
+    if (c == '\n') {
+      return p + 1;
+    }
+    p++;
+  }
+}
+
+static paje_classify_function select_classify_function (void)
+{
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2")){
+    return classify_avx2;
+  }
+  if (__builtin_cpu_supports ("sse2")){
+    return classify_sse2;
+  }
+  return NULL;
+}
+
+static paje_classify_function classify_function = select_classify_function ();
+
+#endif
+
+const char *PajeEventDecoder::break_line (const char *s, paje_line *line, long long lineNumber)
+{
+  line->word_count = 0;
+  line->lineNumber = lineNumber;
+#ifdef PAJE_VECTOR_TOKENIZER
+  if (classify_function){
+    return break_line_vector (s, line, classify_function);
+  }
+#endif
+  return break_line_scalar (s, line);
+}
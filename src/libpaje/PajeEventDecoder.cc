@@ -17,121 +17,219 @@
 #include "PajeEventDecoder.h"
 #include "PajeException.h"
 
+//chunks are not split in pieces smaller than this
+#define PAJE_DECODER_MIN_PIECE (16*1024)
+
 PajeEventDecoder::PajeEventDecoder (PajeDefinitions *definitions)
 {
   defStatus = OUT_DEF;
+  eventBeingDefined = NULL;
+  currentLineNumber = 0;
+  defs = definitions;
+  threads = 1;
+  workers = NULL;
+  definitionsChanged = false;
+}
+
+/*
+ * PajeEventDecoder (PajeDefinitions *, int): with more than one
+ * thread, lines of each chunk are tokenized and turned into
+ * PajeTraceEvent objects by a pool of worker threads. The main thread
+ * hands the events to the next component in the original line order
+ * and handles the definition lines itself, so event definitions act
+ * as a serial barrier.
+ */
+PajeEventDecoder::PajeEventDecoder (PajeDefinitions *definitions, int threads)
+{
+  defStatus = OUT_DEF;
+  eventBeingDefined = NULL;
   currentLineNumber = 0;
   defs = definitions;
+  this->threads = threads;
+  workers = NULL;
+  if (threads <= 1){
+    this->threads = 1;
+    return;
+  }
+
+  pthread_mutex_init (&mutex, NULL);
+  pthread_cond_init (&workCondition, NULL);
+  pthread_cond_init (&doneCondition, NULL);
+  pieceCount = 0;
+  nextPiece = 0;
+  finishing = false;
+  definitionsChanged = false;
+
+  //a few pieces per thread, so the main thread can start handing out
+  //events while the workers are still decoding the rest of the chunk
+  pieces.resize (2 * threads);
+  for (unsigned int i = 0; i < pieces.size(); i++){
+    pieces[i].count = 0;
+    pieces[i].lineCount = 0;
+    pieces[i].done = false;
+  }
+
+  workers = new pthread_t[threads];
+  for (int i = 0; i < threads; i++){
+    if (pthread_create (&workers[i], NULL, PajeEventDecoder::worker, this) != 0){
+      throw PajeDecodeException ("Could not create decoder thread");
+    }
+  }
 }
 
 PajeEventDecoder::~PajeEventDecoder ()
 {
-  eventDefinitions.clear ();
+  if (workers){
+    pthread_mutex_lock (&mutex);
+    finishing = true;
+    pthread_cond_broadcast (&workCondition);
+    pthread_mutex_unlock (&mutex);
+    for (int i = 0; i < threads; i++){
+      pthread_join (workers[i], NULL);
+    }
+    delete[] workers;
+    pthread_cond_destroy (&doneCondition);
+    pthread_cond_destroy (&workCondition);
+    pthread_mutex_destroy (&mutex);
+  }
+  eventDefinitions.dense.clear ();
+  eventDefinitions.sparse.clear ();
+  ownDefinitions.dense.clear ();
+  ownDefinitions.sparse.clear ();
 }
 
-char *PajeEventDecoder::break_line (char *s, paje_line *line)
+const paje_definition_table &PajeEventDecoder::definitions (void) const
 {
-  //a new line is born
-  currentLineNumber++;
+  return eventDefinitions;
+}
 
-  bool in_string = false;
-  bool in_word = false;
-  char *p;
-  line->word_count = 0;
-  line->lineNumber = currentLineNumber;
+//threadCount: the threads decoding, 1 when the decoder works alone
+int PajeEventDecoder::threadCount (void) const
+{
+  return threads;
+}
 
-  for (p = s; *p != '\0'; p++) {
-    if (*p == '\n') {
-      *p = '\0';
-      p++;
-      break;
-    }
-    if (in_string) {
-      if (*p == '"') {
-        *p = '\0';
-        in_string = false;
-      }
-      continue;
-    }
-    if (*p == '#') {
-      *p = '\0';
-      while (true) {
-        p++;
-        if (*p == '\n') {
-          p++;
-          break;
-        } else if (*p == '\0') {
-          break;
-        }
-      }
-      break;
+/*
+ * inheritDefinitions: a trace file without a header uses the event
+ * definitions of the trace that refers to it. Definitions in its own
+ * header take precedence over the inherited ones.
+ */
+void PajeEventDecoder::inheritDefinitions (const paje_definition_table &table)
+{
+  eventDefinitions = table;
+  definitionsChanged = true;
+}
+
+/*
+ * setLineNumber: the next line decoded is lineNumber, for a reader
+ * that skipped part of the trace.
+ */
+void PajeEventDecoder::setLineNumber (long long lineNumber)
+{
+  currentLineNumber = lineNumber - 1;
+}
+
+//the vector index of id, -1 if it belongs in the map
+static int denseIndex (const char *id, size_t length)
+{
+  //"07" and "7" are different ids, only plain numbers go to the vector
+  if (length == 0){
+    return -1;
+  }
+  if (id[0] == '0'){
+    return length == 1 ? 0 : -1;
+  }
+  int index = 0;
+  for (size_t i = 0; i < length; i++){
+    if (id[i] < '0' || id[i] > '9'){
+      return -1;
     }
-    if (in_word && isspace(*p)) {
-      *p = '\0';
-      in_word = false;
-      continue;
+    index = index * 10 + (id[i] - '0');
+    if (index >= PAJE_DECODER_DENSE_IDS){
+      return -1;
     }
-    if (!in_word && !isspace(*p)) {
-      if (*p == '"') {
-        p++;
-        in_string = true;
-      } else {
-        in_word = true;
-      }
-      if (line->word_count < PAJE_MAX_FIELDS) {
-        line->word[line->word_count] = p;
-        line->word_count ++;
-      }
-      continue;
+  }
+  return index;
+}
+
+PajeEventDefinition *PajeEventDecoder::definitionForId (paje_definition_table *table, const char *id, size_t length)
+{
+  int index = denseIndex (id, length);
+  if (index >= 0){
+    return (size_t)index < table->dense.size() ? table->dense[index] : NULL;
+  }
+  std::map<std::string,PajeEventDefinition*>::iterator it = table->sparse.find (std::string (id, length));
+  return it != table->sparse.end() ? it->second : NULL;
+}
+
+void PajeEventDecoder::setDefinitionForId (paje_definition_table *table, const std::string &id, PajeEventDefinition *def)
+{
+  int index = denseIndex (id.c_str(), id.length());
+  if (index >= 0){
+    if ((size_t)index >= table->dense.size()){
+      table->dense.resize (index + 1, NULL);
     }
+    table->dense[index] = def;
+  }else{
+    table->sparse[id] = def;
   }
-  return p;
+}
+
+//word n of line, empty past the last word
+static std::string lineWord (paje_line *line, int n)
+{
+  if (n >= line->word_count){
+    return std::string();
+  }
+  return std::string (line->word[n], line->length[n]);
 }
 
 void PajeEventDecoder::scanDefinitionLine (paje_line *line)
 {
-  char *str;
+  std::string str;
   int n = 0;
-  char *eventName;
-  char *eventId;
-  char *fieldName;
-  char *fieldType;
+  std::string eventName;
+  std::string eventId;
+  std::string fieldName;
+  std::string fieldType;
   std::stringstream st;
   st << *line;
   std::string lreport = st.str();
 
-  str = line->word[n++];
-  if (*str++ != '%') {
+  str = lineWord (line, n++);
+  if (str.empty() || str[0] != '%') {
     throw PajeDecodeException ("Line should start with a '%%'");
   }
-  if (*str == '\0') {
-    str = line->word[n++];
+  str.erase (0, 1);
+  if (str.empty()) {
+    str = lineWord (line, n++);
   }
 
   switch (defStatus) {
   case OUT_DEF:
   {
-    eventName = line->word[n++];
-    eventId   = line->word[n++];
+    eventName = lineWord (line, n++);
+    eventId   = lineWord (line, n++);
 
     //check if this event definition has a good start
-    if (n != line->word_count || strcmp(str, "EventDef") != 0) {
+    if (n != line->word_count || str != "EventDef") {
       throw PajeDecodeException ("'EventDef <event name> <event id>' expected in "+lreport);
     }
 
     //check if this event definition has been already defined
-    if (eventDefinitions[eventId]){
-      throw PajeDecodeException ("Redefinition of event with id '"+std::string(eventId)+"' in "+lreport);
+    if (definitionForId (&ownDefinitions, eventId.c_str(), eventId.length())){
+      throw PajeDecodeException ("Redefinition of event with id '"+eventId+"' in "+lreport);
     }
 
     //check if we know the event name found in the trace file
     PajeEventId pajeEventId = defs->idFromEventName (eventName);
     if (pajeEventId == PajeUnknownEventId) {
-      throw PajeDecodeException ("Unknown event name '"+std::string(eventName)+"' in "+lreport);
+      throw PajeDecodeException ("Unknown event name '"+eventName+"' in "+lreport);
     }
 
-    eventBeingDefined = new PajeEventDefinition (pajeEventId, atoi(eventId), line->lineNumber, defs);
-    eventDefinitions[eventId] = eventBeingDefined;
+    //published at %EndEventDef, once its fields are all known
+    eventBeingDefined = new PajeEventDefinition (pajeEventId, atoi(eventId.c_str()), line->lineNumber, defs);
+    idBeingDefined = eventId;
     defStatus = IN_DEF;
   }
   break;
@@ -143,7 +241,7 @@ void PajeEventDecoder::scanDefinitionLine (paje_line *line)
       throw PajeDecodeException ("Incomplete line, missing field name in "+lreport);
     }
 
-    if (strcmp(fieldName, "EndEventDef") == 0) {
+    if (fieldName == "EndEventDef") {
       if (!eventBeingDefined->isValid()){
         std::cout << "This event definition is invalid:" << std::endl;
         std::cout << *eventBeingDefined << std::endl;
@@ -151,6 +249,9 @@ void PajeEventDecoder::scanDefinitionLine (paje_line *line)
         std::cout << "When treating line " << lreport << std::endl;
         exit(1);
       }
+      setDefinitionForId (&ownDefinitions, idBeingDefined, eventBeingDefined);
+      setDefinitionForId (&eventDefinitions, idBeingDefined, eventBeingDefined);
+      eventBeingDefined = NULL;
       defStatus = OUT_DEF;
       break;
     }
@@ -160,7 +261,7 @@ void PajeEventDecoder::scanDefinitionLine (paje_line *line)
       throw PajeDecodeException ("Incomplete line, missing field type for " + name + " with id " + " in "+lreport);
     }
 
-    fieldType = line->word[n++];
+    fieldType = lineWord (line, n++);
 
     //convert fieldName to field
     //convert fieldType to type
@@ -182,9 +283,13 @@ void PajeEventDecoder::scanDefinitionLine (paje_line *line)
   }
 }
 
-PajeTraceEvent *PajeEventDecoder::scanEventLine (paje_line *line)
+/*
+ * scanEventLine: fills event with the line, whose words it refers to
+ * without copying them.
+ */
+void PajeEventDecoder::scanEventLine (paje_line *line, PajeTraceEvent *event)
 {
-  char *eventId = NULL;
+  const char *eventId = NULL;
   PajeEventDefinition *eventDefinition = NULL;
 
   eventId = line->word[0];
@@ -193,13 +298,200 @@ PajeTraceEvent *PajeEventDecoder::scanEventLine (paje_line *line)
     st << *line;
     throw PajeDecodeException ("Line should not start with a '%%' in "+st.str());
   }
-  eventDefinition = eventDefinitions[eventId];
+  eventDefinition = definitionForId (&eventDefinitions, eventId, line->length[0]);
   if (eventDefinition == NULL) {
     std::stringstream st;
     st << *line;
-    throw PajeDecodeException ("Event with id '"+std::string(eventId)+"' has not been defined in "+st.str());
+    throw PajeDecodeException ("Event with id '"+std::string(eventId, line->length[0])+"' has not been defined in "+st.str());
+  }
+  event->clear ();
+  event->setDefinition (eventDefinition);
+  event->setLineNumber (line->lineNumber);
+  event->setFields (line);
+  event->check (line);
+  event->convertFields ();
+}
+
+void *PajeEventDecoder::worker (void *decoder)
+{
+  ((PajeEventDecoder*)decoder)->workerLoop ();
+  return NULL;
+}
+
+void PajeEventDecoder::workerLoop (void)
+{
+  pthread_mutex_lock (&mutex);
+  while (true){
+    while (!finishing && nextPiece >= pieceCount){
+      pthread_cond_wait (&workCondition, &mutex);
+    }
+    if (finishing){
+      break;
+    }
+    paje_decoder_piece *piece = &pieces[nextPiece++];
+    pthread_mutex_unlock (&mutex);
+
+    decodePiece (piece);
+
+    pthread_mutex_lock (&mutex);
+    piece->done = true;
+    pthread_cond_broadcast (&doneCondition);
+  }
+  pthread_mutex_unlock (&mutex);
+}
+
+/*
+ * decodePiece: runs on a worker thread. Line numbers are relative to
+ * the start of the piece, the main thread fixes them when it hands the
+ * events out. Nothing is reported from here: lines that cannot be
+ * decoded are left with a NULL event so the main thread deals with
+ * them in order, exactly as the serial decoder would.
+ */
+void PajeEventDecoder::decodePiece (paje_decoder_piece *piece)
+{
+  const char *p = piece->start;
+  piece->count = 0;
+  piece->lineCount = 0;
+  while (p < piece->end){
+    if (piece->count == piece->lines.size()){
+      piece->lines.resize (2 * piece->lines.size() + 64);
+    }
+    paje_decoded_line *decoded = &piece->lines[piece->count];
+    p = break_line (p, &decoded->line, ++piece->lineCount);
+    if (decoded->line.word_count == 0) {
+      continue;
+    }
+    decoded->decoded = false;
+    if (decoded->line.word[0][0] != '%'){
+      PajeEventDefinition *def = definitionForId (&workerDefinitions, decoded->line.word[0], decoded->line.length[0]);
+      if (def){
+        PajeTraceEvent *event = &decoded->event;
+        event->clear ();
+        event->setDefinition (def);
+        event->setFields (&decoded->line);
+        event->convertFields ();
+        decoded->decoded = true;
+      }
+    }
+    piece->count++;
+  }
+}
+
+void PajeEventDecoder::emitLine (paje_line *line, PajeTraceEvent *decoded)
+{
+  if (decoded){
+    decoded->setLineNumber (line->lineNumber);
+    decoded->check (line);
+    PajeComponent::outputEntity (decoded);
+  }else if (line->word[0][0] == '%') {
+    PajeEventDecoder::scanDefinitionLine (line);
+    definitionsChanged = true;
+  }else{
+    PajeEventDecoder::scanEventLine (line, &event);
+    PajeComponent::outputEntity (&event);
+  }
+}
+
+/*
+ * discardPieces: stops handing out pieces and waits for the workers
+ * to be done with the pieces that were not sent, starting at first.
+ */
+void PajeEventDecoder::discardPieces (unsigned int first)
+{
+  pthread_mutex_lock (&mutex);
+  pieceCount = nextPiece;
+  for (unsigned int i = first; i < pieceCount; i++){
+    while (!pieces[i].done){
+      pthread_cond_wait (&doneCondition, &mutex);
+    }
+  }
+  pthread_mutex_unlock (&mutex);
+}
+
+//returns the start of the line following the one that contains from
+static char *nextLineStart (char *from, char *start, char *end)
+{
+  while (from < end){
+    char *eol = (char*)memchr (from, '\n', end - from);
+    if (eol == NULL){
+      return end;
+    }
+    //break_line skips the character after an opening quote, never cut
+    //a piece there or a worker could run into the next piece
+    if (eol > start && eol[-1] == '"'){
+      from = eol + 1;
+      continue;
+    }
+    return eol + 1;
+  }
+  return end;
+}
+
+void PajeEventDecoder::parallelInputEntity (PajeData *data)
+{
+  char *start = data->bytes;
+  char *end = data->bytes + data->length;
+
+  //workers look up event ids in their own copy of the definitions
+  if (definitionsChanged){
+    workerDefinitions = eventDefinitions;
+    definitionsChanged = false;
+  }
+
+  //split the chunk at line boundaries
+  size_t target = data->length / pieces.size() + 1;
+  if (target < PAJE_DECODER_MIN_PIECE){
+    target = PAJE_DECODER_MIN_PIECE;
+  }
+  unsigned int count = 0;
+  char *p = start;
+  while (p < end && count < pieces.size()){
+    char *cut = end;
+    if (count + 1 < pieces.size() && (size_t)(end - p) > target){
+      cut = nextLineStart (p + target, start, end);
+    }
+    pieces[count].start = p;
+    pieces[count].end = cut;
+    pieces[count].done = false;
+    count++;
+    p = cut;
+  }
+
+  pthread_mutex_lock (&mutex);
+  pieceCount = count;
+  nextPiece = 0;
+  pthread_cond_broadcast (&workCondition);
+  pthread_mutex_unlock (&mutex);
+
+  //hand the events out in line order
+  unsigned int i = 0;
+  try {
+    for (i = 0; i < count; i++){
+      paje_decoder_piece *piece = &pieces[i];
+      pthread_mutex_lock (&mutex);
+      while (!piece->done){
+        pthread_cond_wait (&doneCondition, &mutex);
+      }
+      pthread_mutex_unlock (&mutex);
+
+      for (size_t j = 0; j < piece->count; j++){
+        paje_decoded_line *decoded = &piece->lines[j];
+        decoded->line.lineNumber += currentLineNumber;
+        PajeTraceEvent *event = decoded->decoded ? &decoded->event : NULL;
+        //a definition earlier in the chunk may replace the one the worker
+        //used (a trace file redefining an inherited id), decode it again
+        if (event && definitionsChanged &&
+            event->definition() != definitionForId (&eventDefinitions, decoded->line.word[0], decoded->line.length[0])){
+          event = NULL;
+        }
+        emitLine (&decoded->line, event);
+      }
+      currentLineNumber += piece->lineCount;
+    }
+  }catch (...){
+    discardPieces (i);
+    throw;
   }
-  return new PajeTraceEvent (eventDefinition, line);
 }
 
 void PajeEventDecoder::inputEntity (PajeObject *data)
@@ -207,22 +499,24 @@ void PajeEventDecoder::inputEntity (PajeObject *data)
   PajeData *d = (PajeData*)data;
   paje_line line;
 
-  char *dataPointer = d->bytes;
-  char *initDataPointer = d->bytes;
+  if (workers){
+    parallelInputEntity (d);
+    return;
+  }
+
+  const char *dataPointer = d->bytes;
+  const char *initDataPointer = d->bytes;
   int length = d->length;
   while ((dataPointer - initDataPointer) < length){
-    dataPointer = PajeEventDecoder::break_line (dataPointer, &line);
+    dataPointer = PajeEventDecoder::break_line (dataPointer, &line, ++currentLineNumber);
     if (line.word_count == 0) {
       continue;
     }
     if (line.word[0][0] == '%') {
       PajeEventDecoder::scanDefinitionLine (&line);
     } else {
-      PajeTraceEvent *event = PajeEventDecoder::scanEventLine (&line);
-      if (event != NULL){
-        PajeComponent::outputEntity (event);
-        delete event;
-      }
+      PajeEventDecoder::scanEventLine (&line, &event);
+      PajeComponent::outputEntity (&event);
     }
   }
 }
@@ -24,27 +24,94 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include "PajeComponent.h"
 #include "PajeEventDefinition.h"
 #include "PajeTraceEvent.h"
 #include "PajeDefinitions.h"
 
+/*
+ * The event definitions by event id: ids written as decimal numbers
+ * below PAJE_DECODER_DENSE_IDS index a vector, so looking up the
+ * definition of a line is a parse and an index. Other ids (non
+ * numeric, huge or with leading zeros) are kept in a map.
+ */
+#define PAJE_DECODER_DENSE_IDS 65536
+
+typedef struct {
+  std::vector<PajeEventDefinition*> dense;
+  std::map<std::string,PajeEventDefinition*> sparse;
+} paje_definition_table;
+
+/*
+ * A piece of a chunk decoded by one of the worker threads: decoded is
+ * false for lines that must be handled by the main thread (definition
+ * lines and lines whose event id was unknown to the worker). The
+ * events are kept with the pieces and reused for the next chunks.
+ */
+typedef struct {
+  paje_line line;
+  PajeTraceEvent event;
+  bool decoded;
+} paje_decoded_line;
+
+typedef struct {
+  char *start;
+  char *end;
+  std::vector<paje_decoded_line> lines;
+  size_t count;
+  long long lineCount;
+  bool done;
+} paje_decoder_piece;
+
 class PajeEventDecoder : public PajeComponent {
 private:
   enum { OUT_DEF, IN_DEF } defStatus;
   PajeEventDefinition *eventBeingDefined;
-  std::map<std::string,PajeEventDefinition*> eventDefinitions;
+  std::string idBeingDefined;
+  paje_definition_table eventDefinitions; //including inherited ones
+  paje_definition_table ownDefinitions; //from the header of this trace
 
-  char *break_line (char *s, paje_line *line);
+  const char *break_line (const char *s, paje_line *line, long long lineNumber);
+  static PajeEventDefinition *definitionForId (paje_definition_table *table, const char *id, size_t length);
+  static void setDefinitionForId (paje_definition_table *table, const std::string &id, PajeEventDefinition *def);
   void scanDefinitionLine (paje_line *line);
-  PajeTraceEvent *scanEventLine (paje_line *line);
+  void scanEventLine (paje_line *line, PajeTraceEvent *event);
   long long currentLineNumber;
+  PajeTraceEvent event; //reused for every line decoded by the main thread
   PajeDefinitions *defs;
 
+  //parallel decoding
+  int threads;
+  pthread_t *workers;
+  pthread_mutex_t mutex;
+  pthread_cond_t workCondition;
+  pthread_cond_t doneCondition;
+  std::vector<paje_decoder_piece> pieces;
+  unsigned int pieceCount;
+  unsigned int nextPiece;
+  bool finishing;
+  paje_definition_table workerDefinitions;
+  bool definitionsChanged;
+
+  static void *worker (void *decoder);
+  void workerLoop (void);
+  void decodePiece (paje_decoder_piece *piece);
+  void emitLine (paje_line *line, PajeTraceEvent *event);
+  void discardPieces (unsigned int first);
+  void parallelInputEntity (PajeData *data);
+
 public:
   PajeEventDecoder (PajeDefinitions *definitions);
+  PajeEventDecoder (PajeDefinitions *definitions, int threads);
   ~PajeEventDecoder (void);
 
   void inputEntity (PajeObject *data);
+
+  //event definitions, for the trace files referred to by this trace
+  const paje_definition_table &definitions (void) const;
+  void inheritDefinitions (const paje_definition_table &table);
+  void setLineNumber (long long lineNumber);
+  int threadCount (void) const;
 };
 #endif
@@ -23,6 +23,9 @@ PajeEventDefinition::PajeEventDefinition (PajeEventId id, int unique, int line,
   defs = definitions;
   pajeEventIdentifier = id;
   uniqueIdentifier = unique;
+  for (int i = 0; i <= PAJE_Unknown_Field; i++){
+    fieldIndex[i] = -1;
+  }
   //the first field is always the event identification
   addField (PAJE_Event, PAJE_int, line);
 }
@@ -41,56 +44,48 @@ void PajeEventDefinition::addField (PajeField field, PajeFieldType type, int lin
   }
 
   //check if field is already defined
-  std::set<PajeField> fieldSet (fields.begin(), fields.end());
-  std::set<PajeField>::iterator present = fieldSet.find(field);
-  if (present != fieldSet.end() && field != PAJE_Extra){
+  if (fieldIndex[field] != -1 && field != PAJE_Extra){
     throw PajeDecodeException ("The field '" + defs->fieldNameFromID(field) + "' with type '" + defs->fieldTypeNameFromID(type)+"' is already defined when treating line "+st.str());
   }
 
+  if (fieldIndex[field] == -1){
+    fieldIndex[field] = fields.size();
+  }
   fields.push_back (field);
   types.push_back (type);
 }
 
 void PajeEventDefinition::addField (PajeField field, PajeFieldType type, int line, std::string userDefinedFieldName)
 {
-  if (field == PAJE_Extra){
-    userDefinedFieldNames.push_back (userDefinedFieldName);
-  }
+  int column = fields.size();
   addField (field, type, line);
-}
+  if (field == PAJE_Extra){
+    //a repeated name refers to the first field with that name
+    std::map<std::string,int>::iterator it = extraFieldIndexByName.find (userDefinedFieldName);
+    if (it != extraFieldIndexByName.end()){
+      column = it->second;
+    }else{
+      extraFieldIndexByName[userDefinedFieldName] = column;
 
-int PajeEventDefinition::indexForField (PajeField field)
-{
-  int i;
-  std::list<PajeField>::iterator it;
-  for (i = 0, it = fields.begin(); it != fields.end(); i++, it++){
-    if (field == *it) return i;
+      //keep the distinct names sorted, entities store fields in this order
+      std::vector<unsigned int>::iterator pos = extraFieldOrder.begin();
+      while (pos != extraFieldOrder.end() && userDefinedFieldNames[*pos] < userDefinedFieldName){
+        pos++;
+      }
+      extraFieldOrder.insert (pos, userDefinedFieldNames.size());
+    }
+    userDefinedFieldNames.push_back (userDefinedFieldName);
+    extraFieldIndex.push_back (column);
   }
-  if (i == fields.size()) return -1;
-  else return i;
 }
 
-int PajeEventDefinition::indexForExtraFieldNamed (std::string fieldName)
+int PajeEventDefinition::indexForExtraFieldNamed (const std::string &fieldName)
 {
-  int i;
-  std::vector<std::string>::iterator it;
-  for (i = 0, it = userDefinedFieldNames.begin(); it != userDefinedFieldNames.end(); i++, it++){
-    if (fieldName == *it) break;
-  }
-  if (i == fields.size()){
+  std::map<std::string,int>::iterator it = extraFieldIndexByName.find (fieldName);
+  if (it == extraFieldIndexByName.end()){
     throw PajeDecodeException ("The user-defined field '"+fieldName+"' was not found in event "+ defs->eventNameFromID(pajeEventIdentifier));
   }
-
-  //we are now looking for the i-th PAJE_Extra field in the fields (the attribute) list
-  int j = 0, k;
-  std::list<PajeField>::iterator field_iterator;
-  for (k = 0, field_iterator = fields.begin(); field_iterator != fields.end(); field_iterator++, k++){
-    if (*field_iterator == PAJE_Extra){
-      if (j == i) return k;
-      j++;
-    }
-  }
-  throw PajeDecodeException ("The user-defined field '"+fieldName+"' was found, but there is no correspondence in the fields vector of event "+ defs->eventNameFromID(pajeEventIdentifier));
+  return it->second;
 }
 
 bool PajeEventDefinition::isValid (void)
@@ -143,7 +138,7 @@ void PajeEventDefinition::showObligatoryFields (void)
   std::cout << std::endl;
 }
 
-std::vector<std::string> PajeEventDefinition::extraFields (void)
+const std::vector<std::string> &PajeEventDefinition::extraFields (void) const
 {
   return userDefinedFieldNames;
 }
@@ -190,7 +185,7 @@ std::ostream &operator<< (std::ostream &output, const paje_line &line)
   output << ", Fields: " << line.word_count;
   output << ", Contents: '";
   for (i = 0; i < line.word_count; i++){
-    output << std::string(line.word[i]);
+    output << std::string(line.word[i], line.length[i]);
     if (i+1 != line.word_count) output << " ";
   }
   output << "')";
@@ -39,18 +39,36 @@ class PajeEventDefinition {
   std::list<PajeFieldType> types;
   std::vector<std::string> userDefinedFieldNames;
 
+private:
+  //the column of each field, kept up to date by addField
+  int fieldIndex[PAJE_Unknown_Field + 1];
+  std::vector<int> extraFieldIndex; //by position in userDefinedFieldNames
+  std::map<std::string,int> extraFieldIndexByName;
+  std::vector<unsigned int> extraFieldOrder; //positions of distinct names, sorted by name
+
 public:
   PajeEventDefinition (PajeEventId id, int unique, int line, PajeDefinitions *definitions);
   ~PajeEventDefinition (void);
   void addField (PajeField field, PajeFieldType type, int line);
   void addField (PajeField field, PajeFieldType type, int line, std::string userDefinedFieldName);
 
-  int indexForField (PajeField field);
-  int indexForExtraFieldNamed (std::string fieldName);
+  int indexForField (PajeField field) const
+  {
+    return fieldIndex[field];
+  }
+  int indexForExtraField (unsigned int extra) const
+  {
+    return extraFieldIndex[extra];
+  }
+  int indexForExtraFieldNamed (const std::string &fieldName);
+  const std::vector<unsigned int> &sortedExtraFields (void) const
+  {
+    return extraFieldOrder;
+  }
   bool isValid (void);
   int fieldCount (void); //return number of fields
   void showObligatoryFields (void);
-  std::vector<std::string> extraFields (void);
+  const std::vector<std::string> &extraFields (void) const;
 
 private:
   bool knownFieldNamed (std::string name);
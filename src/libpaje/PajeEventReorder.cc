@@ -0,0 +1,95 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <math.h>
+#include <iomanip>
+#include "PajeEventReorder.h"
+#include "PajeException.h"
+
+PajeEventReorder::PajeEventReorder (double window)
+{
+  this->window = window;
+  latestTime = -HUGE_VAL;
+  sequence = 0;
+}
+
+PajeEventReorder::~PajeEventReorder (void)
+{
+  while (!held.empty()){
+    delete held.top().event;
+    held.pop ();
+  }
+  for (unsigned int i = 0; i < pool.size(); i++){
+    delete pool[i];
+  }
+}
+
+/*
+ * release: passes on, in order, the held events whose time is not
+ * after watermark. Their copies go back to the pool.
+ */
+void PajeEventReorder::release (double watermark)
+{
+  while (!held.empty() && held.top().time <= watermark){
+    PajeTraceEvent *event = held.top().event;
+    held.pop ();
+    pool.push_back (event);
+    outputEntity (event);
+  }
+}
+
+void PajeEventReorder::inputEntity (PajeObject *data)
+{
+  PajeTraceEvent *event = (PajeTraceEvent*)data;
+  double time;
+  if (event->doubleValueForField (PAJE_Time, &time)){
+    if (time < latestTime - window){
+      std::stringstream eventdesc;
+      eventdesc << *event;
+      std::stringstream latest;
+      latest << std::fixed << latestTime;
+      throw PajeDecodeException ("Illegal, event is older than the reorder window in "+eventdesc.str()+", the trace already reached time "+latest.str());
+    }
+    if (time > latestTime){
+      latestTime = time;
+    }
+  }else{
+    //nothing held, read before it, can refer to it
+    outputEntity (event);
+    return;
+  }
+
+  //the decoder reuses its events, hold a copy
+  paje_reorder_item item;
+  if (pool.empty()){
+    item.event = new PajeTraceEvent ();
+  }else{
+    item.event = pool.back();
+    pool.pop_back ();
+  }
+  item.event->assign (event);
+  item.time = time;
+  item.sequence = sequence++;
+  held.push (item);
+
+  release (latestTime - window);
+}
+
+void PajeEventReorder::finishedReading (void)
+{
+  release (HUGE_VAL);
+  PajeComponent::finishedReading ();
+}
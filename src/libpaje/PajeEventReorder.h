@@ -0,0 +1,69 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJEEVENTREORDER_H__
+#define __PAJEEVENTREORDER_H__
+#include <queue>
+#include <vector>
+#include "PajeComponent.h"
+#include "PajeTraceEvent.h"
+
+/*
+ * paje_reorder_item: a held event, ordered by time and then by the
+ * order it was read in, so events with the same time keep their order.
+ */
+typedef struct {
+  double time;
+  unsigned long long sequence;
+  PajeTraceEvent *event;
+} paje_reorder_item;
+
+struct PajeReorderItemCompare {
+  bool operator() (const paje_reorder_item &a, const paje_reorder_item &b) const
+  {
+    if (a.time != b.time) return a.time > b.time;
+    return a.sequence > b.sequence;
+  }
+};
+
+/*
+ * PajeEventReorder: sits between the decoder and the simulator of
+ * traces whose events are out of order by at most window seconds. It
+ * holds the events it receives and passes them on in time order once
+ * the latest time seen is window past them. An event older than that
+ * can no longer be put in order, and is rejected. Events without a
+ * time (type definitions, for instance) are passed on at once, ahead
+ * of the held events, so the events read after them can use them
+ * whatever their time.
+ */
+class PajeEventReorder : public PajeComponent {
+private:
+  double window;
+  double latestTime;
+  unsigned long long sequence;
+  std::priority_queue<paje_reorder_item, std::vector<paje_reorder_item>, PajeReorderItemCompare> held;
+  std::vector<PajeTraceEvent*> pool;
+
+  void release (double watermark);
+
+public:
+  PajeEventReorder (double window);
+  ~PajeEventReorder (void);
+  void inputEntity (PajeObject *data);
+  void finishedReading (void);
+};
+
+#endif
@@ -40,6 +40,17 @@ const std::string PajeFileReadException::reason (void) const throw()
   return std::string(exceptionName + ": Could not open '") + filename.c_str() + std::string("' for reading.");
 }
 
+PajeFileWriteException::PajeFileWriteException (std::string filename)
+{
+  this->filename = filename;
+}
+
+const std::string PajeFileWriteException::reason (void) const throw()
+{
+  std::string exceptionName (typeid(this).name());
+  return std::string(exceptionName + ": Could not open '") + filename.c_str() + std::string("' for writing.");
+}
+
 PajeDecodeException::PajeDecodeException (std::string message)
 {
   this->message = message;
@@ -91,6 +102,26 @@ PajeProtocolException::PajeProtocolException (std::string message) : PajeDecodeE
   exceptionName = std::string ("PajeProtocolException");
 }
 
+PajeTraceFileException::PajeTraceFileException (std::string filename, std::string reason) : PajeDecodeException ("In trace file '"+filename+"', "+reason)
+{
+  exceptionName = std::string ("PajeTraceFileException");
+}
+
+PajeCompactionException::PajeCompactionException (std::string message) : PajeDecodeException (message)
+{
+  exceptionName = std::string ("PajeCompactionException");
+}
+
+PajeIndexException::PajeIndexException (std::string filename, std::string reason) : PajeDecodeException ("In index '"+filename+"', "+reason)
+{
+  exceptionName = std::string ("PajeIndexException");
+}
+
+PajeSnapshotException::PajeSnapshotException (std::string filename, std::string reason) : PajeDecodeException ("In snapshot '"+filename+"', "+reason)
+{
+  exceptionName = std::string ("PajeSnapshotException");
+}
+
 PajeDefinitionsException::PajeDefinitionsException (std::string message) : PajeDecodeException (message)
 {
   exceptionName = std::string ("PajeDefinitionsException");
@@ -20,10 +20,21 @@
 #include <exception>
 #include "PajeObject.h"
 
+/*
+ * PAJE_EXCEPTION_COPY: clone and raise of an exception class, so that
+ * a copy kept by another thread is thrown again with its own type.
+ */
+#define PAJE_EXCEPTION_COPY(name) \
+  PajeException *clone (void) const { return new name (*this); } \
+  void raise (void) const { throw name (*this); }
+
 class PajeException : public PajeObject
 {
 public:
+  virtual ~PajeException (void) {}
   virtual const std::string reason () const throw () = 0;
+  virtual PajeException *clone (void) const = 0;
+  virtual void raise (void) const = 0;
   void report (void);
   void reportAndExit (void);
 };
@@ -34,10 +45,22 @@ private:
   std::string filename;
 
 public:
+  PAJE_EXCEPTION_COPY(PajeFileReadException)
   PajeFileReadException (std::string filename);
   const std::string reason () const throw ();
 };
 
+class PajeFileWriteException : public PajeException
+{
+private:
+  std::string filename;
+
+public:
+  PAJE_EXCEPTION_COPY(PajeFileWriteException)
+  PajeFileWriteException (std::string filename);
+  const std::string reason () const throw ();
+};
+
 class PajeDecodeException : public PajeException
 {
 private:
@@ -47,6 +70,7 @@ protected:
   std::string exceptionName;
 
 public:
+  PAJE_EXCEPTION_COPY(PajeDecodeException)
   PajeDecodeException (std::string message);
   PajeDecodeException ();
   const std::string reason () const throw ();
@@ -55,48 +79,84 @@ public:
 class PajeContainerException : public PajeDecodeException
 {
 public:
+  PAJE_EXCEPTION_COPY(PajeContainerException)
   PajeContainerException (std::string message);
 };
 
 class PajeTypeException : public PajeDecodeException
 {
 public:
+  PAJE_EXCEPTION_COPY(PajeTypeException)
   PajeTypeException (std::string message);
 };
 
 class PajeLinkException : public PajeDecodeException
 {
 public:
+  PAJE_EXCEPTION_COPY(PajeLinkException)
   PajeLinkException (std::string message);
 };
 
 class PajeStateException : public PajeDecodeException
 {
 public:
+  PAJE_EXCEPTION_COPY(PajeStateException)
   PajeStateException (std::string message);
 };
 
 class PajeVariableException : public PajeDecodeException
 {
 public:
+  PAJE_EXCEPTION_COPY(PajeVariableException)
   PajeVariableException (std::string message);
 };
 
 class PajeSimulationException : public PajeDecodeException
 {
 public:
+  PAJE_EXCEPTION_COPY(PajeSimulationException)
   PajeSimulationException (std::string message);
 };
 
 class PajeProtocolException : public PajeDecodeException
 {
 public:
+  PAJE_EXCEPTION_COPY(PajeProtocolException)
   PajeProtocolException (std::string message);
 };
 
+class PajeTraceFileException : public PajeDecodeException
+{
+public:
+  PAJE_EXCEPTION_COPY(PajeTraceFileException)
+  PajeTraceFileException (std::string filename, std::string reason);
+};
+
+class PajeCompactionException : public PajeDecodeException
+{
+public:
+  PAJE_EXCEPTION_COPY(PajeCompactionException)
+  PajeCompactionException (std::string message);
+};
+
+class PajeIndexException : public PajeDecodeException
+{
+public:
+  PAJE_EXCEPTION_COPY(PajeIndexException)
+  PajeIndexException (std::string filename, std::string reason);
+};
+
+class PajeSnapshotException : public PajeDecodeException
+{
+public:
+  PAJE_EXCEPTION_COPY(PajeSnapshotException)
+  PajeSnapshotException (std::string filename, std::string reason);
+};
+
 class PajeDefinitionsException : public PajeDecodeException
 {
  public:
+  PAJE_EXCEPTION_COPY(PajeDefinitionsException)
   PajeDefinitionsException (std::string message);
   PajeDefinitionsException ();
 };
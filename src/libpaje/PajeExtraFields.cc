@@ -0,0 +1,204 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <sstream>
+#include "PajeExtraFields.h"
+#include "PajeTraceEvent.h"
+#include "PajeException.h"
+
+PajeExtraFields::PajeExtraFields (void)
+{
+  pthread_mutex_init (&mutex, NULL);
+}
+
+PajeExtraFields::~PajeExtraFields (void)
+{
+  pthread_mutex_destroy (&mutex);
+}
+
+unsigned int PajeExtraFields::fieldId (const std::string &name)
+{
+  std::map<std::string,unsigned int>::iterator found = nameIds.find (name);
+  if (found != nameIds.end()){
+    return found->second;
+  }
+  unsigned int id = names.size();
+  nameIds.insert (found, std::make_pair (name, id));
+  names.push_back (name);
+  values.push_back (std::vector<std::string>());
+  valueIds.push_back (std::map<std::string,unsigned int>());
+  return id;
+}
+
+unsigned int PajeExtraFields::valueId (unsigned int field, const std::string &value)
+{
+  std::map<std::string,unsigned int> &ids = valueIds[field];
+  std::map<std::string,unsigned int>::iterator found = ids.find (value);
+  if (found != ids.end()){
+    return found->second;
+  }
+  unsigned int id = values[field].size();
+  ids.insert (found, std::make_pair (value, id));
+  values[field].push_back (value);
+  return id;
+}
+
+//fields are sorted by name
+unsigned int PajeExtraFields::schemaId (const std::vector<unsigned int> &fields)
+{
+  std::map<std::vector<unsigned int>,unsigned int>::iterator found = schemaIds.find (fields);
+  if (found != schemaIds.end()){
+    return found->second;
+  }
+  unsigned int id = schemas.size();
+  schemaIds.insert (found, std::make_pair (fields, id));
+  schemas.push_back (fields);
+  return id;
+}
+
+//the fields of def, in the order of its sortedExtraFields
+unsigned int PajeExtraFields::schemaForDefinition (PajeEventDefinition *def)
+{
+  std::map<PajeEventDefinition*,unsigned int>::iterator found = definitionSchemas.find (def);
+  if (found != definitionSchemas.end()){
+    return found->second;
+  }
+  const std::vector<std::string> &fieldNames = def->extraFields();
+  const std::vector<unsigned int> &order = def->sortedExtraFields();
+  std::vector<unsigned int> fields;
+  for (unsigned int i = 0; i < order.size(); i++){
+    fields.push_back (fieldId (fieldNames[order[i]]));
+  }
+  unsigned int id = schemaId (fields);
+  definitionSchemas.insert (found, std::make_pair (def, id));
+  return id;
+}
+
+bool PajeExtraFields::hasFields (PajeTraceEvent *event)
+{
+  return event && event->definition() && !event->definition()->sortedExtraFields().empty();
+}
+
+//length: the number of integers of record, a record starts with the number of its fields
+size_t PajeExtraFields::length (const unsigned int *record)
+{
+  return record ? 2 + record[0] : 0;
+}
+
+/*
+ * collect: result gets the record with the fields of record, which
+ * may be NULL, and the user-defined fields of event. A field that is
+ * already in record must have the same value in event.
+ */
+void PajeExtraFields::collect (PajeTraceEvent *event, const unsigned int *record, std::vector<unsigned int> *result)
+{
+  PajeEventDefinition *def = event->definition();
+  const std::vector<unsigned int> &order = def->sortedExtraFields();
+  std::string conflict;
+
+  result->clear ();
+  pthread_mutex_lock (&mutex);
+  unsigned int schema = schemaForDefinition (def);
+  //schemas is not changed until the merged schema is added
+  const std::vector<unsigned int> &fields = schemas[schema];
+  std::vector<unsigned int> ids;
+  for (unsigned int i = 0; i < order.size(); i++){
+    int index = def->indexForExtraField (order[i]);
+    std::string value (event->fieldAtIndex (index), event->fieldLengthAtIndex (index));
+    ids.push_back (valueId (fields[i], value));
+  }
+
+  if (record){
+    //merge with the fields already there, both are sorted by name
+    const std::vector<unsigned int> &current = schemas[record[1]];
+    const unsigned int *currentIds = record + 2;
+    std::vector<unsigned int> merged;
+    std::vector<unsigned int> mergedIds;
+    size_t i = 0, j = 0;
+    while (i < current.size() || j < fields.size()){
+      if (j == fields.size() || (i < current.size() && names[current[i]] < names[fields[j]])){
+        merged.push_back (current[i]);
+        mergedIds.push_back (currentIds[i++]);
+      }else if (i == current.size() || names[fields[j]] < names[current[i]]){
+        merged.push_back (fields[j]);
+        mergedIds.push_back (ids[j++]);
+      }else{
+        if (currentIds[i] != ids[j] && conflict.empty()){
+          std::stringstream line;
+          line << *event;
+          conflict = "When treating event "+line.str()+", the value for "+names[current[i]]+" is "+values[current[i]][currentIds[i]]+", but it is different from "+values[fields[j]][ids[j]];
+        }
+        merged.push_back (current[i]);
+        mergedIds.push_back (currentIds[i++]);
+        j++;
+      }
+    }
+    schema = schemaId (merged);
+    ids.swap (mergedIds);
+  }
+  pthread_mutex_unlock (&mutex);
+
+  if (!conflict.empty()){
+    throw PajeDecodeException (conflict);
+  }
+  result->push_back (ids.size());
+  result->push_back (schema);
+  result->insert (result->end(), ids.begin(), ids.end());
+}
+
+/*
+ * collect: result gets the record of fields, as given by the fields
+ * of a record. An empty list gives an empty record.
+ */
+void PajeExtraFields::collect (const paje_extra_list &list, std::vector<unsigned int> *result)
+{
+  result->clear ();
+  if (list.empty()) return;
+
+  paje_extra_list sorted = list;
+  std::sort (sorted.begin(), sorted.end());
+  std::vector<unsigned int> fields;
+  std::vector<unsigned int> ids;
+  pthread_mutex_lock (&mutex);
+  for (size_t i = 0; i < sorted.size(); i++){
+    if (i > 0 && sorted[i].first == sorted[i - 1].first) continue;
+    unsigned int field = fieldId (sorted[i].first);
+    fields.push_back (field);
+    ids.push_back (valueId (field, sorted[i].second));
+  }
+  unsigned int schema = schemaId (fields);
+  pthread_mutex_unlock (&mutex);
+
+  result->push_back (ids.size());
+  result->push_back (schema);
+  result->insert (result->end(), ids.begin(), ids.end());
+}
+
+//fields: the names and values of the fields of record, sorted by name
+paje_extra_list PajeExtraFields::fields (const unsigned int *record)
+{
+  paje_extra_list ret;
+  if (!record) return ret;
+
+  pthread_mutex_lock (&mutex);
+  const std::vector<unsigned int> &schema = schemas[record[1]];
+  for (size_t i = 0; i < schema.size(); i++){
+    ret.push_back (std::make_pair (names[schema[i]], values[schema[i]][record[2 + i]]));
+  }
+  pthread_mutex_unlock (&mutex);
+  return ret;
+}
@@ -0,0 +1,70 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJE_EXTRA_FIELDS_H
+#define __PAJE_EXTRA_FIELDS_H
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include <stddef.h>
+#include <pthread.h>
+
+class PajeTraceEvent;
+class PajeEventDefinition;
+
+//user-defined fields by name, with their values, sorted by name
+typedef std::vector<std::pair<std::string,std::string> > paje_extra_list;
+
+/*
+ * PajeExtraFields: the user-defined fields of the entities of one
+ * type. Field names and the distinct values of each field are
+ * numbered once; a schema is a set of fields sorted by name, one per
+ * event definition and per union of them. The fields of an entity are
+ * a record: its schema followed by the number of the value of each
+ * field of the schema. Records belong to their entity or timeline and
+ * go away with it, only the dictionaries stay. Entities of different
+ * containers are simulated by different threads, so the dictionaries
+ * are locked.
+ */
+class PajeExtraFields {
+private:
+  pthread_mutex_t mutex;
+  std::vector<std::string> names;
+  std::map<std::string,unsigned int> nameIds;
+  std::vector<std::vector<std::string> > values; //by field
+  std::vector<std::map<std::string,unsigned int> > valueIds; //by field
+  std::vector<std::vector<unsigned int> > schemas;
+  std::map<std::vector<unsigned int>,unsigned int> schemaIds;
+  std::map<PajeEventDefinition*,unsigned int> definitionSchemas;
+
+  unsigned int fieldId (const std::string &name);
+  unsigned int valueId (unsigned int field, const std::string &value);
+  unsigned int schemaId (const std::vector<unsigned int> &fields);
+  unsigned int schemaForDefinition (PajeEventDefinition *def);
+
+public:
+  PajeExtraFields (void);
+  ~PajeExtraFields (void);
+
+  static bool hasFields (PajeTraceEvent *event);
+  static size_t length (const unsigned int *record);
+  void collect (PajeTraceEvent *event, const unsigned int *record, std::vector<unsigned int> *result);
+  void collect (const paje_extra_list &fields, std::vector<unsigned int> *result);
+  paje_extra_list fields (const unsigned int *record);
+};
+
+#endif
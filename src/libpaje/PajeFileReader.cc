@@ -17,13 +17,43 @@
 #include "PajeFileReader.h"
 #include "PajeException.h"
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 PajeFileReader::PajeFileReader (std::string f)
+{
+  openStream (f);
+}
+
+PajeFileReader::PajeFileReader (std::string f, bool mapped)
+{
+  if (!mapped || !mapFile (f)){
+    openStream (f);
+  }
+}
+
+PajeFileReader::PajeFileReader ()
+{
+  chunkSize = PAJE_DEFAULT_CHUNK_SIZE;
+  moreData = true;
+  currentChunk = 0;
+  filename = std::string ("stdin");
+  mapped = false;
+  map = NULL;
+
+  input = &std::cin;
+}
+
+void PajeFileReader::openStream (std::string f)
 {
   chunkSize = PAJE_DEFAULT_CHUNK_SIZE;
   moreData = true;
   currentChunk = 0;
   filename = f;
+  mapped = false;
+  map = NULL;
   file.open (filename.c_str());
   if (file.fail()){
     throw PajeFileReadException (f);
@@ -35,23 +65,75 @@ PajeFileReader::PajeFileReader (std::string f)
   input = &file;
 }
 
-PajeFileReader::PajeFileReader ()
+/*
+ * mapFile: map the whole trace file in memory. The chunks given to
+ * the output component are views on this mapping, so no byte is
+ * copied by the reader. The mapping is read-only, PajeEventDecoder
+ * never writes to the chunks, so the pages stay shared with the page
+ * cache; it is followed by at least one zero byte so the last line is
+ * always terminated, even when the file does not end with a newline.
+ * Returns false if the file can't be mapped (a pipe, for instance),
+ * so the caller can fall back to the stream-based reader.
+ */
+bool PajeFileReader::mapFile (std::string f)
 {
+  int fd = ::open (f.c_str(), O_RDONLY);
+  if (fd == -1){
+    throw PajeFileReadException (f);
+  }
+
+  struct stat st;
+  if (fstat (fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0){
+    close (fd);
+    return false;
+  }
+
+  //reserve the file size plus a zeroed guard byte, then map the file over it
+  size_t pagesize = sysconf (_SC_PAGESIZE);
+  size_t reserve = ((st.st_size + 1 + pagesize - 1) / pagesize) * pagesize;
+  void *base = mmap (NULL, reserve, PROT_READ, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED){
+    close (fd);
+    return false;
+  }
+  if (mmap (base, st.st_size, PROT_READ, MAP_PRIVATE|MAP_FIXED, fd, 0) == MAP_FAILED){
+    munmap (base, reserve);
+    close (fd);
+    return false;
+  }
+  close (fd);
+  madvise (base, st.st_size, MADV_SEQUENTIAL);
+
   chunkSize = PAJE_DEFAULT_CHUNK_SIZE;
   moreData = true;
   currentChunk = 0;
-  filename = std::string ("stdin");
-
-  input = &std::cin;
+  filename = f;
+  mapped = true;
+  map = (char*)base;
+  mapLength = reserve;
+  length = st.st_size;
+  current = 0;
+  released = 0;
+  input = NULL;
+  return true;
 }
 
 PajeFileReader::~PajeFileReader (void)
 {
-  file.close();
+  if (mapped){
+    munmap (map, mapLength);
+  }else{
+    file.close();
+  }
 }
 
 void PajeFileReader::readNextChunk (void)
 {
+  if (mapped){
+    readNextMappedChunk ();
+    return;
+  }
+
   if (input->eof()) moreData = false;
   if (!moreData) return;
 
@@ -79,6 +161,34 @@ void PajeFileReader::readNextChunk (void)
   delete buffer;
 }
 
+void PajeFileReader::readNextMappedChunk (void)
+{
+  if (current >= length) moreData = false;
+  if (!moreData) return;
+
+  //the chunk goes until the first \n after chunkSize bytes
+  unsigned long long end = current + chunkSize;
+  if (end >= length){
+    end = length;
+  }else{
+    char *newline = (char*)memchr (map + end, '\n', length - end);
+    end = newline ? newline - map + 1 : length;
+  }
+
+  PajeData chunk (map + current, end - current);
+  PajeComponent::outputEntity (&chunk);
+  current = end;
+  if (current >= length) moreData = false;
+
+  //give back the pages that have been completely consumed
+  size_t pagesize = sysconf (_SC_PAGESIZE);
+  unsigned long long consumed = (current / pagesize) * pagesize;
+  if (consumed > released){
+    madvise (map + released, consumed - released, MADV_DONTNEED);
+    released = consumed;
+  }
+}
+
 bool PajeFileReader::hasMoreData (void)
 {
   return moreData;
@@ -96,8 +206,25 @@ unsigned long long PajeFileReader::traceSize (void)
 
 unsigned long long PajeFileReader::traceRead (void)
 {
-  if (!input->eof())
+  if (mapped || !input->eof())
     return current;
   else
     return length;
 }
+
+//seek: the next chunk starts at offset, which should start a line
+void PajeFileReader::seek (unsigned long long offset)
+{
+  if (mapped){
+    current = offset;
+    released = (offset / sysconf (_SC_PAGESIZE)) * sysconf (_SC_PAGESIZE);
+  }else{
+    input->clear ();
+    input->seekg (offset);
+    if (input->fail()){
+      throw PajeFileReadException (filename);
+    }
+    current = offset;
+  }
+  moreData = offset < length;
+}
@@ -39,8 +39,19 @@ private:
   unsigned long long length;
   unsigned long long current;
 
+  //memory-mapped mode
+  bool mapped;
+  char *map;
+  size_t mapLength;
+  unsigned long long released;
+
+  void openStream (std::string f);
+  bool mapFile (std::string f);
+  void readNextMappedChunk (void);
+
 public:
   PajeFileReader (std::string f);
+  PajeFileReader (std::string f, bool mapped); //mmap the file if possible
   PajeFileReader (void); //reads from stdin
   ~PajeFileReader (void);
   void readNextChunk (void);
@@ -48,5 +59,6 @@ public:
   void setUserChunkSize (std::streamoff userChunkSize);
   unsigned long long traceSize (void);
   unsigned long long traceRead (void);
+  void seek (unsigned long long offset);
 };
 #endif
@@ -60,7 +60,5 @@ void PajeFlexReader::readNextChunk()
 
 PajeFlexReader::~PajeFlexReader()
 {
-  /* print number of events */
-  printf ("%lld events and %lld lines\n", counter, yylineno);
 }
 
@@ -0,0 +1,190 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJEINTERVALINDEX_H__
+#define __PAJEINTERVALINDEX_H__
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+
+/*
+ * PajeIntervalIndex: the entities of one type in one container, split
+ * in chains along which both start and end times never decrease, to
+ * find the ones overlapping a time window with a binary search per
+ * chain. Nested states make one chain per imbrication level; events
+ * and variables, one chain. The rows are read through an object with
+ * startTime (row) and endTime (row), see PajeContainer.
+ */
+class PajeIntervalIndex {
+private:
+  std::vector<std::vector<unsigned int> > chains;
+  bool rowOrdered; //rows of each chain are increasing
+
+  template <class Rows>
+  struct StartOrder {
+    const Rows *rows;
+    bool operator() (unsigned int a, unsigned int b) const {
+      return rows->startTime (a) < rows->startTime (b);
+    }
+  };
+
+public:
+  PajeIntervalIndex (void)
+  {
+    rowOrdered = true;
+  }
+
+  /*
+   * build: each row, by start time, goes to the chain that ended last
+   * before its end, or to a new chain if none did.
+   */
+  template <class Rows>
+  void build (const Rows &rows, size_t count)
+  {
+    //events, variables and states without nesting are one chain already
+    size_t sorted = 1;
+    while (sorted < count &&
+           rows.startTime (sorted - 1) <= rows.startTime (sorted) &&
+           rows.endTime (sorted - 1) <= rows.endTime (sorted)){
+      sorted++;
+    }
+    chains.clear ();
+    rowOrdered = true;
+    if (sorted >= count){
+      chains.push_back (std::vector<unsigned int> (count));
+      for (size_t i = 0; i < count; i++){
+        chains[0][i] = i;
+      }
+      return;
+    }
+
+    std::vector<unsigned int> order (count);
+    for (size_t i = 0; i < count; i++){
+      order[i] = i;
+    }
+    StartOrder<Rows> startOrder;
+    startOrder.rows = &rows;
+    std::stable_sort (order.begin(), order.end(), startOrder);
+
+    std::multimap<double,size_t> lastEnds;
+    for (size_t i = 0; i < count; i++){
+      double end = rows.endTime (order[i]);
+      std::multimap<double,size_t>::iterator found = lastEnds.upper_bound (end);
+      size_t chain;
+      if (found == lastEnds.begin()){
+        chain = chains.size();
+        chains.push_back (std::vector<unsigned int>());
+      }else{
+        found--;
+        chain = found->second;
+        lastEnds.erase (found);
+      }
+      if (!chains[chain].empty() && chains[chain].back() > order[i]){
+        rowOrdered = false;
+      }
+      chains[chain].push_back (order[i]);
+      lastEnds.insert (std::make_pair (end, chain));
+    }
+  }
+
+  /*
+   * words: the index as words, to be restored without building it
+   * again: whether rows are ordered, the number of chains, then the
+   * length and the rows of each chain.
+   */
+  void words (std::vector<unsigned int> *words) const
+  {
+    words->clear ();
+    words->push_back (rowOrdered);
+    words->push_back (chains.size());
+    for (size_t c = 0; c < chains.size(); c++){
+      words->push_back (chains[c].size());
+      words->insert (words->end(), chains[c].begin(), chains[c].end());
+    }
+  }
+
+  /*
+   * restore: the index from count words, of rows rows. False if they
+   * are not an index of that many rows, in which case it is empty.
+   */
+  bool restore (const unsigned int *words, size_t count, size_t rows)
+  {
+    chains.clear ();
+    rowOrdered = true;
+    if (count < 2 || words[0] > 1){
+      return false;
+    }
+    size_t position = 2;
+    for (size_t c = 0; c < words[1]; c++){
+      if (position >= count || words[position] > count - position - 1){
+        chains.clear ();
+        return false;
+      }
+      const unsigned int *chain = words + position + 1;
+      size_t length = words[position];
+      for (size_t i = 0; i < length; i++){
+        if (chain[i] >= rows){
+          chains.clear ();
+          return false;
+        }
+      }
+      chains.push_back (std::vector<unsigned int> (chain, chain + length));
+      position += length + 1;
+    }
+    if (position != count){
+      chains.clear ();
+      return false;
+    }
+    rowOrdered = words[0];
+    return true;
+  }
+
+  /*
+   * overlapping: the rows that start before end and end at or after
+   * start, in row order.
+   */
+  template <class Rows>
+  void overlapping (const Rows &rows, double start, double end, std::vector<size_t> *found) const
+  {
+    found->clear ();
+    size_t contributing = 0;
+    for (size_t c = 0; c < chains.size(); c++){
+      const std::vector<unsigned int> &chain = chains[c];
+      size_t low = 0, high = chain.size();
+      while (low < high){
+        size_t middle = low + (high - low) / 2;
+        if (rows.endTime (chain[middle]) < start){
+          low = middle + 1;
+        }else{
+          high = middle;
+        }
+      }
+      size_t before = found->size();
+      for (size_t i = low; i < chain.size() && rows.startTime (chain[i]) < end; i++){
+        found->push_back (chain[i]);
+      }
+      if (found->size() != before){
+        contributing++;
+      }
+    }
+    if (contributing > 1 || !rowOrdered){
+      std::sort (found->begin(), found->end());
+    }
+  }
+};
+
+#endif
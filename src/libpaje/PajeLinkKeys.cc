@@ -0,0 +1,317 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdlib.h>
+#include "PajeLinkKeys.h"
+#include "PajeEntity.h"
+#include "PajeException.h"
+
+PajeLinkKeyTable::PajeLinkKeyTable (void)
+{
+  count = 0;
+}
+
+/*
+ * lookup: the slot of key, or the free slot where it should go. The
+ * key strings are compared for hashed keys when name is given.
+ */
+size_t PajeLinkKeyTable::lookup (paje_link_key key, const std::string *name) const
+{
+  size_t mask = slots.size() - 1;
+  for (size_t i = hash (key) & mask; ; i = (i + 1) & mask){
+    const paje_link_key_slot &slot = slots[i];
+    if (slot.key == PAJE_LINK_KEY_NONE) return i;
+    if (slot.key == key){
+      if (!name || !(key & PAJE_LINK_KEY_HASHED) || slot.link->linkKey() == *name){
+        return i;
+      }
+    }
+  }
+}
+
+void PajeLinkKeyTable::grow (void)
+{
+  std::vector<paje_link_key_slot> old;
+  old.swap (slots);
+  paje_link_key_slot empty = { PAJE_LINK_KEY_NONE, NULL };
+  slots.assign (old.empty() ? 16 : old.size() * 2, empty);
+  count = 0;
+  for (size_t i = 0; i < old.size(); i++){
+    if (old[i].key != PAJE_LINK_KEY_NONE){
+      insert (old[i].key, old[i].link);
+    }
+  }
+}
+
+PajeUserLink *PajeLinkKeyTable::find (paje_link_key key, const std::string *name) const
+{
+  if (slots.empty()) return NULL;
+  const paje_link_key_slot &slot = slots[lookup (key, name)];
+  return slot.key == PAJE_LINK_KEY_NONE ? NULL : slot.link;
+}
+
+//insert: the key is added even if an entry has it already
+void PajeLinkKeyTable::insert (paje_link_key key, PajeUserLink *link)
+{
+  if ((count + 1) * 2 > slots.size()) grow ();
+  size_t mask = slots.size() - 1;
+  size_t i = hash (key) & mask;
+  while (slots[i].key != PAJE_LINK_KEY_NONE){
+    i = (i + 1) & mask;
+  }
+  slots[i].key = key;
+  slots[i].link = link;
+  count++;
+}
+
+/*
+ * erase: the entries after the erased one in its probe sequence are
+ * shifted back, so the table never has tombstones.
+ */
+void PajeLinkKeyTable::erase (paje_link_key key, const std::string *name)
+{
+  if (slots.empty()) return;
+  size_t mask = slots.size() - 1;
+  size_t i = lookup (key, name);
+  if (slots[i].key == PAJE_LINK_KEY_NONE) return;
+  slots[i].key = PAJE_LINK_KEY_NONE;
+  count--;
+
+  for (size_t j = (i + 1) & mask; slots[j].key != PAJE_LINK_KEY_NONE; j = (j + 1) & mask){
+    size_t home = hash (slots[j].key) & mask;
+    bool reachable = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+    if (!reachable){
+      slots[i] = slots[j];
+      slots[j].key = PAJE_LINK_KEY_NONE;
+      i = j;
+    }
+  }
+}
+
+size_t PajeLinkKeyTable::size (void) const
+{
+  return count;
+}
+
+void PajeLinkKeyTable::links (std::vector<PajeUserLink*> *links) const
+{
+  for (size_t i = 0; i < slots.size(); i++){
+    if (slots[i].key != PAJE_LINK_KEY_NONE){
+      links->push_back (slots[i].link);
+    }
+  }
+}
+
+void PajeLinkKeyTable::clear (void)
+{
+  slots.clear ();
+  count = 0;
+}
+
+PajeLinkKeySet::PajeLinkKeySet (void)
+{
+  count = 0;
+}
+
+size_t PajeLinkKeySet::lookup (paje_link_key key) const
+{
+  size_t mask = slots.size() - 1;
+  size_t i = PajeLinkKeyTable::hash (key) & mask;
+  while (slots[i] != PAJE_LINK_KEY_NONE && slots[i] != key){
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+void PajeLinkKeySet::grow (void)
+{
+  std::vector<paje_link_key> old;
+  old.swap (slots);
+  slots.assign (old.empty() ? 16 : old.size() * 2, PAJE_LINK_KEY_NONE);
+  count = 0;
+  for (size_t i = 0; i < old.size(); i++){
+    if (old[i] != PAJE_LINK_KEY_NONE){
+      insert (old[i]);
+    }
+  }
+}
+
+bool PajeLinkKeySet::contains (paje_link_key key) const
+{
+  if (slots.empty()) return false;
+  return slots[lookup (key)] != PAJE_LINK_KEY_NONE;
+}
+
+void PajeLinkKeySet::insert (paje_link_key key)
+{
+  if ((count + 1) * 2 > slots.size()) grow ();
+  size_t i = lookup (key);
+  if (slots[i] == PAJE_LINK_KEY_NONE){
+    slots[i] = key;
+    count++;
+  }
+}
+
+//erase: as PajeLinkKeyTable::erase
+void PajeLinkKeySet::erase (paje_link_key key)
+{
+  if (slots.empty()) return;
+  size_t mask = slots.size() - 1;
+  size_t i = lookup (key);
+  if (slots[i] == PAJE_LINK_KEY_NONE) return;
+  slots[i] = PAJE_LINK_KEY_NONE;
+  count--;
+
+  for (size_t j = (i + 1) & mask; slots[j] != PAJE_LINK_KEY_NONE; j = (j + 1) & mask){
+    size_t home = PajeLinkKeyTable::hash (slots[j]) & mask;
+    bool reachable = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+    if (!reachable){
+      slots[i] = slots[j];
+      slots[j] = PAJE_LINK_KEY_NONE;
+      i = j;
+    }
+  }
+}
+
+PajeLinkKeys::PajeLinkKeys (paje_link_key_strategy strategy)
+{
+  this->strategy = strategy;
+  recentNext = 0;
+}
+
+paje_link_key PajeLinkKeys::keyFor (const std::string &key)
+{
+  //up to 18 digits, a number is below 2^63
+  size_t length = key.length();
+  if (length > 0 && length <= 18 && (key[0] != '0' || length == 1)){
+    paje_link_key number = 0;
+    size_t i;
+    for (i = 0; i < length && key[i] >= '0' && key[i] <= '9'; i++){
+      number = number * 10 + (key[i] - '0');
+    }
+    if (i == length) return number;
+  }
+
+  //FNV-1a
+  paje_link_key hash = 14695981039346656037ull;
+  for (size_t i = 0; i < length; i++){
+    hash ^= (unsigned char)key[i];
+    hash *= 1099511628211ull;
+  }
+  hash |= PAJE_LINK_KEY_HASHED;
+  return hash == PAJE_LINK_KEY_NONE ? hash - 1 : hash;
+}
+
+/*
+ * strategyFor: the strategy named by spec, which is exact, off or
+ * recent=N with N the number of keys remembered.
+ */
+paje_link_key_strategy PajeLinkKeys::strategyFor (const std::string &spec)
+{
+  paje_link_key_strategy strategy = { PAJE_LINK_KEYS_EXACT, 0 };
+  if (spec.empty() || spec == "exact"){
+    return strategy;
+  }
+  if (spec == "off"){
+    strategy.mode = PAJE_LINK_KEYS_OFF;
+    return strategy;
+  }
+  if (spec.compare (0, 7, "recent=") == 0 && spec.length() > 7){
+    const char *number = spec.c_str() + 7;
+    char *end;
+    unsigned long history = strtoul (number, &end, 10);
+    if (*end == '\0' && history > 0 && number[0] != '-'){
+      strategy.mode = PAJE_LINK_KEYS_RECENT;
+      strategy.history = history;
+      return strategy;
+    }
+  }
+  throw PajeLinkException ("Invalid link key strategy '"+spec+"', expected exact, recent=N or off");
+}
+
+PajeUserLink *PajeLinkKeys::pendingLink (paje_link_key number, const std::string &key) const
+{
+  return pending.find (number, &key);
+}
+
+void PajeLinkKeys::addPendingLink (paje_link_key number, PajeUserLink *link)
+{
+  pending.insert (number, link);
+}
+
+/*
+ * completeLink: the pending link of key is removed, and the key is
+ * remembered as the strategy says. The recent strategy compares the
+ * hashed keys by number only, a collision among the last keys of a
+ * type is too unlikely to matter.
+ */
+void PajeLinkKeys::completeLink (paje_link_key number, const std::string &key)
+{
+  pending.erase (number, &key);
+
+  switch (strategy.mode){
+  case PAJE_LINK_KEYS_EXACT:
+    if (number & PAJE_LINK_KEY_HASHED){
+      usedNames.insert (key);
+    }else{
+      used.insert (number);
+    }
+    break;
+  case PAJE_LINK_KEYS_RECENT:
+    if (recent.size() < strategy.history){
+      recent.push_back (number);
+    }else{
+      used.erase (recent[recentNext]);
+      recent[recentNext] = number;
+    }
+    recentNext = (recentNext + 1) % strategy.history;
+    used.insert (number);
+    break;
+  case PAJE_LINK_KEYS_OFF:
+    break;
+  }
+}
+
+bool PajeLinkKeys::isUsed (paje_link_key number, const std::string &key) const
+{
+  switch (strategy.mode){
+  case PAJE_LINK_KEYS_EXACT:
+    if (number & PAJE_LINK_KEY_HASHED){
+      return usedNames.count (key) != 0;
+    }
+    return used.contains (number);
+  case PAJE_LINK_KEYS_RECENT:
+    return used.contains (number);
+  case PAJE_LINK_KEYS_OFF:
+    break;
+  }
+  return false;
+}
+
+void PajeLinkKeys::pendingLinks (std::vector<PajeUserLink*> *links) const
+{
+  pending.links (links);
+}
+
+size_t PajeLinkKeys::numberOfPendingLinks (void) const
+{
+  return pending.size();
+}
+
+void PajeLinkKeys::clearPendingLinks (void)
+{
+  pending.clear ();
+}
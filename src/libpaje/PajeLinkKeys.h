@@ -0,0 +1,131 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJE_LINK_KEYS_H
+#define __PAJE_LINK_KEYS_H
+#include <string>
+#include <vector>
+#include <set>
+#include <stddef.h>
+
+class PajeUserLink;
+
+/*
+ * paje_link_key: the key of a link as a number. Keys written as
+ * decimal integers below 2^63, without sign or leading zeros, are
+ * their own value; other keys are hashed, with the top bit set.
+ */
+typedef unsigned long long paje_link_key;
+
+#define PAJE_LINK_KEY_HASHED (1ull << 63)
+#define PAJE_LINK_KEY_NONE (~0ull)
+
+/*
+ * paje_link_key_strategy: how the keys of completed links are kept to
+ * detect that a later link reuses one of them. All of them (exact),
+ * the last N of each link type in each container (recent), or none.
+ */
+typedef enum {
+  PAJE_LINK_KEYS_EXACT,
+  PAJE_LINK_KEYS_RECENT,
+  PAJE_LINK_KEYS_OFF
+} paje_link_key_mode;
+
+typedef struct {
+  paje_link_key_mode mode;
+  size_t history;
+} paje_link_key_strategy;
+
+/*
+ * PajeLinkKeyTable: an open addressing hash table from link keys to
+ * links, with linear probing. Several entries may have the same
+ * hashed key, they are told apart by the key of their link.
+ */
+class PajeLinkKeyTable {
+private:
+  typedef struct {
+    paje_link_key key;
+    PajeUserLink *link;
+  } paje_link_key_slot;
+
+  std::vector<paje_link_key_slot> slots;
+  size_t count;
+
+  size_t lookup (paje_link_key key, const std::string *name) const;
+  void grow (void);
+
+public:
+  static size_t hash (paje_link_key key)
+  {
+    return (size_t)((key ^ (key >> 29)) * 0x9e3779b97f4a7c15ull >> 17);
+  }
+
+  PajeLinkKeyTable (void);
+  PajeUserLink *find (paje_link_key key, const std::string *name) const;
+  void insert (paje_link_key key, PajeUserLink *link);
+  void erase (paje_link_key key, const std::string *name);
+  size_t size (void) const;
+  void links (std::vector<PajeUserLink*> *links) const;
+  void clear (void);
+};
+
+/*
+ * PajeLinkKeySet: the same table without links, for the used keys.
+ */
+class PajeLinkKeySet {
+private:
+  std::vector<paje_link_key> slots;
+  size_t count;
+
+  size_t lookup (paje_link_key key) const;
+  void grow (void);
+
+public:
+  PajeLinkKeySet (void);
+  bool contains (paje_link_key key) const;
+  void insert (paje_link_key key);
+  void erase (paje_link_key key);
+};
+
+/*
+ * PajeLinkKeys: the pending links and the used keys of one link type
+ * in one container. Links are matched by number, and by key string
+ * for the hashed keys.
+ */
+class PajeLinkKeys {
+private:
+  paje_link_key_strategy strategy;
+  PajeLinkKeyTable pending;
+  PajeLinkKeySet used;
+  std::set<std::string> usedNames; //exact strategy, keys that are not numbers
+  std::vector<paje_link_key> recent; //recent strategy, ring of used keys
+  size_t recentNext;
+
+public:
+  PajeLinkKeys (paje_link_key_strategy strategy);
+  static paje_link_key keyFor (const std::string &key);
+  static paje_link_key_strategy strategyFor (const std::string &spec);
+
+  PajeUserLink *pendingLink (paje_link_key number, const std::string &key) const;
+  void addPendingLink (paje_link_key number, PajeUserLink *link);
+  void completeLink (paje_link_key number, const std::string &key);
+  bool isUsed (paje_link_key number, const std::string &key) const;
+  void pendingLinks (std::vector<PajeUserLink*> *links) const;
+  size_t numberOfPendingLinks (void) const;
+  void clearPendingLinks (void);
+};
+
+#endif
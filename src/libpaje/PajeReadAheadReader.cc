@@ -0,0 +1,359 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "PajeReadAheadReader.h"
+#include "PajeException.h"
+#include <sys/stat.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+
+bool PajeReadAheadReader::isStream (std::string f)
+{
+  struct stat st;
+  return stat (f.c_str(), &st) == 0 && !S_ISREG(st.st_mode);
+}
+
+/*
+ * PajeReadAheadReader: a reading thread fills the next chunk while
+ * the current one is decoded. The chunks come from a fixed pool of
+ * PajeData buffers that are given back to the reading thread once
+ * the output component is done with them. Each chunk ends at a line
+ * boundary; the partial line at the end of a buffer is carried to
+ * the next one. Chunks of streams are handed out as soon as a read
+ * returns less than asked, so a trace written by a running program
+ * is simulated as it comes.
+ */
+PajeReadAheadReader::PajeReadAheadReader (void)
+{
+  initialize ();
+  filename = std::string ("stdin");
+  fd = 0;
+  struct stat st;
+  stream = fstat (fd, &st) != 0 || !S_ISREG(st.st_mode);
+  start ();
+}
+
+PajeReadAheadReader::PajeReadAheadReader (std::string f)
+{
+  initialize ();
+  openInput (f);
+  start ();
+}
+
+/*
+ * PajeReadAheadReader (std::string, bool): for subclasses, which
+ * open the input and start the reading thread themselves, once they
+ * are ready to fill buffers.
+ */
+PajeReadAheadReader::PajeReadAheadReader (std::string f, bool start)
+{
+  initialize ();
+  openInput (f);
+  if (start){
+    this->start ();
+  }
+}
+
+void PajeReadAheadReader::initialize (void)
+{
+  fd = -1;
+  chunkSize = PAJE_DEFAULT_CHUNK_SIZE;
+  length = 0;
+  inputRead = 0;
+  current = 0;
+  moreData = true;
+  finished = false;
+  cancelled = false;
+  running = false;
+  stream = false;
+  //tests split their input in short reads with PAJE_STREAM_READ_SIZE
+  const char *readSize = getenv ("PAJE_STREAM_READ_SIZE");
+  streamReadSize = readSize ? strtoul (readSize, NULL, 10) : 0;
+  if (pipe (stopPipe) == -1){
+    throw PajeDecodeException ("Could not create the stop pipe of the reading thread");
+  }
+  pthread_mutex_init (&mutex, NULL);
+  pthread_cond_init (&filled, NULL);
+  pthread_cond_init (&released, NULL);
+  for (int i = 0; i < PAJE_READ_AHEAD_BUFFERS; i++){
+    pool.push_back (new PajeData (chunkSize + PAJE_DEFAULT_LINE_SIZE));
+    freeBuffers.push_back (pool.back());
+  }
+}
+
+void PajeReadAheadReader::openInput (std::string f)
+{
+  filename = f;
+  fd = ::open (f.c_str(), O_RDONLY);
+  if (fd == -1){
+    throw PajeFileReadException (f);
+  }
+  struct stat st;
+  if (fstat (fd, &st) == 0 && S_ISREG(st.st_mode)){
+    length = st.st_size;
+  }else{
+    stream = true;
+  }
+}
+
+void PajeReadAheadReader::start (void)
+{
+  if (pthread_create (&thread, NULL, PajeReadAheadReader::readAhead, this) != 0){
+    throw PajeDecodeException ("Could not create reading thread for '" + filename + "'");
+  }
+  running = true;
+}
+
+/*
+ * stop: subclasses call it in their destructor, so the reading thread
+ * does not call fill on a half-destroyed object. A thread waiting for
+ * input is woken up by the stop pipe, so stopping never waits for the
+ * writer of a stream.
+ */
+void PajeReadAheadReader::stop (void)
+{
+  if (!running) return;
+  pthread_mutex_lock (&mutex);
+  cancelled = true;
+  pthread_cond_broadcast (&released);
+  pthread_mutex_unlock (&mutex);
+  char byte = 0;
+  while (write (stopPipe[1], &byte, 1) == -1 && errno == EINTR);
+  pthread_join (thread, NULL);
+  running = false;
+}
+
+PajeReadAheadReader::~PajeReadAheadReader (void)
+{
+  stop ();
+  for (unsigned int i = 0; i < pool.size(); i++){
+    delete pool[i];
+  }
+  pthread_cond_destroy (&released);
+  pthread_cond_destroy (&filled);
+  pthread_mutex_destroy (&mutex);
+  close (stopPipe[0]);
+  close (stopPipe[1]);
+  if (fd > 0){
+    close (fd);
+  }
+}
+
+/*
+ * waitForInput: waits until fd can be read, false if the reader is
+ * stopped first.
+ */
+bool PajeReadAheadReader::waitForInput (void)
+{
+  struct pollfd fds[2];
+  fds[0].fd = fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = stopPipe[0];
+  fds[1].events = POLLIN;
+  int n;
+  do {
+    fds[0].revents = fds[1].revents = 0;
+    n = poll (fds, 2, -1);
+  } while (n < 0 && errno == EINTR);
+  return n > 0 && !fds[1].revents;
+}
+
+/*
+ * fill: reads at most capacity bytes of input in buffer. Returns
+ * false at the end of the input, with fillError set if something
+ * went wrong.
+ */
+bool PajeReadAheadReader::fill (char *buffer, size_t capacity, size_t *produced)
+{
+  ssize_t n;
+  if (!waitForInput ()){
+    *produced = 0;
+    return false;
+  }
+  if (stream && streamReadSize > 0 && capacity > streamReadSize){
+    capacity = streamReadSize;
+  }
+  do {
+    n = read (fd, buffer, capacity);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0){
+    fillError = strerror (errno);
+    return false;
+  }
+  inputRead += n;
+  *produced = n;
+  return n > 0;
+}
+
+void *PajeReadAheadReader::readAhead (void *reader)
+{
+  ((PajeReadAheadReader*)reader)->readAheadLoop ();
+  return NULL;
+}
+
+//takeBuffer: waits for a free buffer, NULL if the reader is stopping
+PajeData *PajeReadAheadReader::takeBuffer (void)
+{
+  PajeData *buffer = NULL;
+  pthread_mutex_lock (&mutex);
+  while (!cancelled && freeBuffers.empty()){
+    pthread_cond_wait (&released, &mutex);
+  }
+  if (!cancelled){
+    buffer = freeBuffers.front();
+    freeBuffers.pop_front();
+  }
+  pthread_mutex_unlock (&mutex);
+  if (buffer){
+    buffer->length = 0;
+  }
+  return buffer;
+}
+
+bool PajeReadAheadReader::pushChunk (PajeData *chunk)
+{
+  pthread_mutex_lock (&mutex);
+  bool ret = !cancelled;
+  if (ret){
+    chunks.push_back (chunk);
+    offsets.push_back (inputRead);
+    pthread_cond_signal (&filled);
+  }else{
+    freeBuffers.push_back (chunk);
+  }
+  pthread_mutex_unlock (&mutex);
+  return ret;
+}
+
+void PajeReadAheadReader::readAheadLoop (void)
+{
+  PajeData *chunk = takeBuffer ();
+  while (chunk){
+    //one byte is always kept to terminate the chunk
+    if (chunk->capacity - chunk->length < PAJE_DEFAULT_LINE_SIZE){
+      chunk->increaseCapacityOf (chunkSize);
+    }
+    size_t produced = 0;
+    size_t asked = chunk->capacity - chunk->length - 1;
+    bool more = fill (chunk->bytes + chunk->length, asked, &produced);
+    chunk->length += produced;
+    if (!more){
+      break;
+    }
+    if (chunk->length < chunkSize && !(stream && produced < asked)){
+      continue;
+    }
+
+    //hand out everything up to the last complete line
+    char *eol = (char*) memrchr (chunk->bytes, '\n', chunk->length);
+    if (eol == NULL){
+      continue;
+    }
+    PajeData *next = takeBuffer ();
+    if (next == NULL){
+      break;
+    }
+    int used = eol - chunk->bytes + 1;
+    int carry = chunk->length - used;
+    if (carry + PAJE_DEFAULT_LINE_SIZE > next->capacity){
+      next->increaseCapacityOf (carry + PAJE_DEFAULT_LINE_SIZE - next->capacity);
+    }
+    memcpy (next->bytes, eol + 1, carry);
+    next->length = carry;
+    chunk->length = used;
+    chunk->bytes[chunk->length] = '\0';
+    if (!pushChunk (chunk)){
+      chunk = next;
+      break;
+    }
+    chunk = next;
+  }
+
+  if (chunk){
+    if (fillError.empty() && chunk->length > 0){
+      chunk->bytes[chunk->length] = '\0';
+      pushChunk (chunk);
+    }else{
+      pthread_mutex_lock (&mutex);
+      freeBuffers.push_back (chunk);
+      pthread_mutex_unlock (&mutex);
+    }
+  }
+
+  pthread_mutex_lock (&mutex);
+  error = fillError;
+  finished = true;
+  pthread_cond_signal (&filled);
+  pthread_mutex_unlock (&mutex);
+}
+
+void PajeReadAheadReader::readNextChunk (void)
+{
+  if (!moreData) return;
+
+  pthread_mutex_lock (&mutex);
+  while (chunks.empty() && !finished){
+    pthread_cond_wait (&filled, &mutex);
+  }
+  if (chunks.empty()){
+    moreData = false;
+    std::string message = error;
+    pthread_mutex_unlock (&mutex);
+    if (!message.empty()){
+      throw PajeDecodeException ("Could not read '" + filename + "': " + message);
+    }
+    return;
+  }
+  PajeData *chunk = chunks.front();
+  chunks.pop_front();
+  current = offsets.front();
+  offsets.pop_front();
+  pthread_mutex_unlock (&mutex);
+
+  try {
+    PajeComponent::outputEntity (chunk);
+  }catch (...){
+    pthread_mutex_lock (&mutex);
+    freeBuffers.push_back (chunk);
+    pthread_cond_signal (&released);
+    pthread_mutex_unlock (&mutex);
+    throw;
+  }
+
+  //the buffer goes back to the pool
+  pthread_mutex_lock (&mutex);
+  freeBuffers.push_back (chunk);
+  pthread_cond_signal (&released);
+  pthread_mutex_unlock (&mutex);
+}
+
+bool PajeReadAheadReader::hasMoreData (void)
+{
+  return moreData;
+}
+
+unsigned long long PajeReadAheadReader::traceSize (void)
+{
+  return length;
+}
+
+unsigned long long PajeReadAheadReader::traceRead (void)
+{
+  return current;
+}
@@ -0,0 +1,82 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJEREADAHEADREADER_H__
+#define __PAJEREADAHEADREADER_H__
+#include <deque>
+#include <vector>
+#include <string>
+#include <pthread.h>
+#include "PajeComponent.h"
+#include "PajeFileReader.h"
+
+//number of buffers shared by the reading thread and the decoder
+#define PAJE_READ_AHEAD_BUFFERS 3
+
+class PajeReadAheadReader : public PajeComponent {
+private:
+  //reading thread and the buffers it fills
+  pthread_t thread;
+  bool running;
+  pthread_mutex_t mutex;
+  pthread_cond_t filled;
+  pthread_cond_t released;
+  std::vector<PajeData*> pool;
+  std::deque<PajeData*> freeBuffers;
+  std::deque<PajeData*> chunks;
+  std::deque<unsigned long long> offsets;
+  bool finished;
+  bool cancelled;
+  std::string error;
+  bool moreData;
+  unsigned long long current;
+  int stopPipe[2]; //written by stop, to wake up a reading thread waiting for input
+
+  void initialize (void);
+  static void *readAhead (void *reader);
+  void readAheadLoop (void);
+  PajeData *takeBuffer (void);
+  bool pushChunk (PajeData *chunk);
+
+protected:
+  std::string filename;
+  int fd;
+  int chunkSize;
+  bool stream; //pipes and the like, whose lines are handed out as they come
+  size_t streamReadSize; //largest read of a stream, 0 for no limit
+  unsigned long long length; //input size, 0 if unknown
+  unsigned long long inputRead; //input bytes consumed by fill
+  std::string fillError;
+
+  PajeReadAheadReader (std::string f, bool start);
+  void openInput (std::string f);
+  void start (void);
+  void stop (void);
+  bool waitForInput (void);
+  virtual bool fill (char *buffer, size_t capacity, size_t *produced);
+
+public:
+  PajeReadAheadReader (void); //reads from stdin
+  PajeReadAheadReader (std::string f);
+  ~PajeReadAheadReader (void);
+  void readNextChunk (void);
+  bool hasMoreData (void);
+  unsigned long long traceSize (void);
+  unsigned long long traceRead (void);
+
+  static bool isStream (std::string f); //pipes, fifos, devices
+};
+#endif
@@ -0,0 +1,247 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include <iomanip>
+#include "PajeSimulator.h"
+#include "PajeEventDecoder.h"
+#include "PajeException.h"
+
+/*
+ * The header of checkpoints, with the events needed to rebuild the
+ * state of a simulation. Fields are always given, empty if unset,
+ * but colors, which have their own events for types and values
+ * without one.
+ */
+static const char *checkpointHeader =
+  "%EventDef PajeDefineContainerType 0\n"
+  "% Alias string\n% Type string\n% Name string\n"
+  "%EndEventDef\n"
+  "%EventDef PajeDefineVariableType 1\n"
+  "% Alias string\n% Type string\n% Name string\n% Color color\n"
+  "%EndEventDef\n"
+  "%EventDef PajeDefineStateType 2\n"
+  "% Alias string\n% Type string\n% Name string\n"
+  "%EndEventDef\n"
+  "%EventDef PajeDefineEventType 3\n"
+  "% Alias string\n% Type string\n% Name string\n"
+  "%EndEventDef\n"
+  "%EventDef PajeDefineLinkType 4\n"
+  "% Alias string\n% Type string\n% StartContainerType string\n% EndContainerType string\n% Name string\n"
+  "%EndEventDef\n"
+  "%EventDef PajeDefineEntityValue 5\n"
+  "% Alias string\n% Type string\n% Name string\n% Color color\n"
+  "%EndEventDef\n"
+  "%EventDef PajeCreateContainer 6\n"
+  "% Time date\n% Alias string\n% Type string\n% Container string\n% Name string\n"
+  "%EndEventDef\n"
+  "%EventDef PajeDestroyContainer 7\n"
+  "% Time date\n% Type string\n% Name string\n"
+  "%EndEventDef\n"
+  "%EventDef PajeSetVariable 8\n"
+  "% Time date\n% Type string\n% Container string\n% Value double\n"
+  "%EndEventDef\n"
+  "%EventDef PajePushState 11\n"
+  "% Time date\n% Type string\n% Container string\n% Value string\n"
+  "%EndEventDef\n"
+  "%EventDef PajeStartLink 14\n"
+  "% Time date\n% Type string\n% Container string\n% Value string\n% StartContainer string\n% Key string\n"
+  "%EndEventDef\n"
+  "%EventDef PajeEndLink 15\n"
+  "% Time date\n% Type string\n% Container string\n% Value string\n% EndContainer string\n% Key string\n"
+  "%EndEventDef\n"
+  "%EventDef PajeDefineVariableType 16\n"
+  "% Alias string\n% Type string\n% Name string\n"
+  "%EndEventDef\n"
+  "%EventDef PajeDefineEntityValue 17\n"
+  "% Alias string\n% Type string\n% Name string\n"
+  "%EndEventDef\n";
+
+static std::string quoted (const std::string &str)
+{
+  return "\"" + str + "\"";
+}
+
+//colorField: the color field, with its leading space, empty without color
+static std::string colorField (PajeColor *color)
+{
+  if (!color) return std::string();
+  std::stringstream field;
+  field << " \"" << color->r << " " << color->g << " " << color->b << " " << color->a << "\"";
+  return field.str();
+}
+
+static void writeTypes (std::ostream &output, PajeType *containerType, bool containerTypes)
+{
+  std::map<std::string,PajeType*> children = containerType->children();
+  std::map<std::string,PajeType*>::iterator it;
+  for (it = children.begin(); it != children.end(); it++){
+    PajeType *type = (*it).second;
+    std::string ids = quoted (type->alias()) + " " + quoted (containerType->identifier());
+    PajeTypeNature nature = type->nature();
+    if (nature == PAJE_ContainerType){
+      if (containerTypes){
+        output << "0 " << ids << " " << quoted (type->name()) << "\n";
+      }
+      writeTypes (output, type, containerTypes);
+      continue;
+    }
+    if (containerTypes) continue;
+
+    switch (nature){
+    case PAJE_VariableType:
+      output << (type->color() ? "1 " : "16 ") << ids << " " << quoted (type->name())
+             << colorField (type->color()) << "\n";
+      break;
+    case PAJE_StateType:
+      output << "2 " << ids << " " << quoted (type->name()) << "\n";
+      break;
+    case PAJE_EventType:
+      output << "3 " << ids << " " << quoted (type->name()) << "\n";
+      break;
+    case PAJE_LinkType:
+      output << "4 " << ids << " " << quoted (type->startType()->identifier()) << " "
+             << quoted (type->endType()->identifier()) << " " << quoted (type->name()) << "\n";
+      break;
+    default:
+      break;
+    }
+
+    if (type->isCategorizedType()){
+      PajeCategorizedType *categorized = (PajeCategorizedType*)type;
+      std::map<std::string,PajeValue*>::iterator value;
+      for (value = categorized->values.begin(); value != categorized->values.end(); value++){
+        PajeValue *v = (*value).second;
+        output << (v->color() ? "5 " : "17 ") << quoted (v->alias()) << " "
+               << quoted (type->identifier()) << " " << quoted (v->name())
+               << colorField (v->color()) << "\n";
+      }
+    }
+  }
+}
+
+static void writeContainers (std::ostream &output, PajeContainer *container)
+{
+  std::map<std::string,PajeContainer*>::iterator it;
+  for (it = container->children.begin(); it != container->children.end(); it++){
+    PajeContainer *child = (*it).second;
+    output << "6 " << child->startTime() << " " << quoted (child->_alias) << " "
+           << quoted (child->type()->identifier()) << " " << quoted (container->identifier()) << " "
+           << quoted (child->name()) << "\n";
+    writeContainers (output, child);
+  }
+}
+
+static void writeOpenEntities (std::ostream &output, PajeContainer *container)
+{
+  if (!container->isDestroyed()){
+    std::vector<PajeEntity*> open;
+    container->openEntities (&open);
+    std::string ids = quoted (container->identifier());
+    for (size_t i = 0; i < open.size(); i++){
+      PajeEntity *entity = open[i];
+      std::string type = quoted (entity->type()->identifier());
+      switch (entity->type()->nature()){
+      case PAJE_StateType:
+        output << "11 " << entity->startTime() << " " << type << " " << ids << " "
+               << quoted (entity->value()->identifier()) << "\n";
+        break;
+      case PAJE_VariableType:
+        output << "8 " << entity->startTime() << " " << type << " " << ids << " "
+               << entity->doubleValue() << "\n";
+        break;
+      case PAJE_LinkType:
+        if (entity->startContainer()){
+          output << "14 " << entity->startTime() << " " << type << " " << ids << " "
+                 << quoted (entity->value()->identifier()) << " "
+                 << quoted (entity->startContainer()->identifier()) << " "
+                 << quoted (((PajeUserLink*)entity)->linkKey()) << "\n";
+        }else{
+          output << "15 " << entity->endTime() << " " << type << " " << ids << " "
+                 << quoted (entity->value()->identifier()) << " "
+                 << quoted (entity->endContainer()->identifier()) << " "
+                 << quoted (((PajeUserLink*)entity)->linkKey()) << "\n";
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  std::map<std::string,PajeContainer*>::iterator it;
+  for (it = container->children.begin(); it != container->children.end(); it++){
+    writeOpenEntities (output, (*it).second);
+  }
+}
+
+static void writeDestroyedContainers (std::ostream &output, PajeContainer *container)
+{
+  std::map<std::string,PajeContainer*>::iterator it;
+  for (it = container->children.begin(); it != container->children.end(); it++){
+    PajeContainer *child = (*it).second;
+    writeDestroyedContainers (output, child);
+    if (child->isDestroyed()){
+      output << "7 " << child->endTime() << " " << quoted (child->type()->identifier()) << " "
+             << quoted (child->identifier()) << "\n";
+    }
+  }
+}
+
+/*
+ * writeCheckpoint: writes the state of the simulation as a trace that
+ * rebuilds it, see PajeTraceIndex.h. Finished entities are not part
+ * of it, nor are the user-defined fields of the open ones. It is meant
+ * for simulations without columns, sink or compaction.
+ */
+void PajeSimulator::writeCheckpoint (std::ostream &output)
+{
+  if (!pendingTraceFiles.empty()){
+    simulateTraceFiles ();
+  }
+  synchronize ();
+
+  output << checkpointHeader << std::setprecision (17);
+  writeTypes (output, rootType, true);
+  writeTypes (output, rootType, false);
+  writeContainers (output, root);
+  writeOpenEntities (output, root);
+  writeDestroyedContainers (output, root);
+}
+
+/*
+ * restoreCheckpoint: simulates a checkpoint written by writeCheckpoint,
+ * the simulation then continues from where it was taken.
+ */
+void PajeSimulator::restoreCheckpoint (const std::string &checkpoint)
+{
+  PajeDefinitions definitions (true);
+  PajeEventDecoder decoder (&definitions);
+  decoder.setOutputComponent (this);
+
+  PajeData data (checkpoint.length() + 1);
+  memcpy (data.bytes, checkpoint.data(), checkpoint.length());
+  data.bytes[checkpoint.length()] = '\0';
+  data.length = checkpoint.length();
+  restoring = true;
+  try {
+    decoder.inputEntity (&data);
+  }catch (PajeException& e){
+    restoring = false;
+    throw;
+  }
+  restoring = false;
+}
@@ -0,0 +1,145 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdlib.h>
+#include "PajeSimulator.h"
+#include "PajeException.h"
+#include <boost/foreach.hpp>
+#include <boost/tokenizer.hpp>
+
+static double compactionNumber (const std::string &policy, const std::string &number)
+{
+  char *end;
+  double ret = strtod (number.c_str(), &end);
+  if (number.empty() || *end != '\0' || ret < 0){
+    throw PajeCompactionException ("Invalid value '"+number+"' for the compaction policy '"+policy+"'");
+  }
+  return ret;
+}
+
+/*
+ * addCompaction: adds the compaction policies of spec, in the form
+ * TYPE:POLICY[,POLICY]...[;TYPE:POLICY...]. TYPE is the name or the
+ * alias of a variable type, with the policies quantum=SECONDS and
+ * epsilon=VALUE, or of a state type, with merge and short=SECONDS.
+ * It should be called before the types are defined.
+ */
+void PajeSimulator::addCompaction (const std::string &spec)
+{
+  boost::char_separator<char> typeSep(";");
+  boost::tokenizer< boost::char_separator<char> > types(spec, typeSep);
+  BOOST_FOREACH(std::string t, types) {
+    size_t colon = t.rfind (':');
+    if (colon == std::string::npos || colon == 0){
+      throw PajeCompactionException ("Invalid compaction '"+t+"', expected TYPE:POLICY[,POLICY]...");
+    }
+    std::string typeName = t.substr (0, colon);
+    paje_compaction compaction = { 0, 0, false, 0, NULL };
+
+    boost::char_separator<char> policySep(",");
+    std::string policies = t.substr (colon + 1);
+    boost::tokenizer< boost::char_separator<char> > tokens(policies, policySep);
+    BOOST_FOREACH(std::string p, tokens) {
+      size_t equal = p.find ('=');
+      std::string name = p.substr (0, equal);
+      std::string value = equal == std::string::npos ? std::string() : p.substr (equal + 1);
+      if (name == "quantum"){
+        compaction.quantum = compactionNumber (name, value);
+      }else if (name == "epsilon"){
+        compaction.epsilon = compactionNumber (name, value);
+      }else if (name == "short"){
+        compaction.shortest = compactionNumber (name, value);
+      }else if (name == "merge" && equal == std::string::npos){
+        compaction.merge = true;
+      }else{
+        throw PajeCompactionException ("Unknown compaction policy '"+p+"' for type '"+typeName+"'");
+      }
+    }
+    compactions[typeName] = compaction;
+  }
+}
+
+/*
+ * applyCompaction: gives type the compaction policies configured for
+ * its name or its alias, checking they fit its nature.
+ */
+void PajeSimulator::applyCompaction (PajeType *type)
+{
+  std::map<std::string,paje_compaction>::iterator found = compactions.find (type->name());
+  if (found == compactions.end() && !type->alias().empty()){
+    found = compactions.find (type->alias());
+  }
+  if (found == compactions.end()) return;
+
+  paje_compaction *compaction = &(*found).second;
+  bool variable = compaction->quantum > 0 || compaction->epsilon > 0;
+  bool state = compaction->merge || compaction->shortest > 0;
+  if ((variable && type->nature() != PAJE_VariableType) ||
+      (state && type->nature() != PAJE_StateType)){
+    throw PajeCompactionException ("The compaction policies given for '"+type->name()+"' do not apply to a "+type->kind()+" type");
+  }
+  type->setCompaction (*compaction);
+  compactedTypes.push_back (type);
+}
+
+/*
+ * prepareCompaction: creates the value short states of type get, on
+ * first use. It is done here and not by the containers, which may be
+ * simulated by several threads.
+ */
+void PajeSimulator::prepareCompaction (PajeType *type)
+{
+  paje_compaction *compaction = type->compaction();
+  if (!compaction || compaction->shortest <= 0 || compaction->other) return;
+
+  compaction->other = type->valueForIdentifier (PAJE_COMPACTION_OTHER);
+  if (!compaction->other){
+    compaction->other = type->addValue (PAJE_COMPACTION_OTHER, PAJE_COMPACTION_OTHER, NULL);
+  }
+}
+
+/*
+ * reportCompaction: how many entities the compaction of each type
+ * removed, on the standard error.
+ */
+void PajeSimulator::reportCompaction (void)
+{
+  synchronize ();
+  std::map<PajeType*,paje_compaction_stats> stats;
+  root->compactionStatistics (&stats);
+
+  for (size_t i = 0; i < compactedTypes.size(); i++){
+    PajeType *type = compactedTypes[i];
+    paje_compaction_stats *s = &stats[type];
+    paje_compaction *compaction = type->compaction();
+    std::stringstream removed;
+    if (compaction->quantum > 0){
+      removed << "; " << s->coalesced << " changes coalesced within " << compaction->quantum;
+    }
+    if (compaction->epsilon > 0){
+      removed << "; " << s->dropped << " changes smaller than " << compaction->epsilon << " dropped";
+    }
+    if (compaction->merge){
+      removed << "; " << s->merged << " states merged";
+    }
+    if (compaction->shortest > 0){
+      removed << "; " << s->shortened << " states shorter than " << compaction->shortest
+              << " made " << PAJE_COMPACTION_OTHER << ", " << s->joined << " of them joined to the previous one";
+    }
+    std::cerr << "Compaction of " << type->kind() << " " << type->name() << ": " << removed.str().substr (2);
+    std::cerr << std::endl;
+  }
+}
@@ -0,0 +1,391 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdint.h>
+#include "PajeSimulator.h"
+#include "PajeException.h"
+
+/*
+ * The parallel simulation: events addressed to different containers
+ * are independent, they only touch the container they are addressed
+ * to. Links are matched by the container of the link, so they need
+ * nothing more. Containers are spread over the simulation threads,
+ * the simulator validates each event and hands it to the thread of
+ * its container, which simulates the events it gets in trace order.
+ * The other events (definitions, creation and destruction of
+ * containers, trace files) wait for the threads to be done first.
+ * In a streaming simulation, the entities finished by the threads are
+ * passed on to the sink when the simulator waits for them, in the
+ * order of the events that finished them; it also waits every few
+ * batches so that they do not pile up.
+ */
+
+//the shard of the simulation thread running, NULL in the others
+static pthread_key_t currentShard;
+static pthread_once_t currentShardOnce = PTHREAD_ONCE_INIT;
+
+static void createCurrentShard (void)
+{
+  pthread_key_create (&currentShard, NULL);
+}
+
+static paje_simulation_shard *shardForContainer (std::vector<paje_simulation_shard*> &shards, PajeContainer *container)
+{
+  uint64_t hash = ((uint64_t)(uintptr_t)container >> 4) * 0x9e3779b97f4a7c15ull;
+  return shards[(hash >> 32) % shards.size()];
+}
+
+static void simulateItem (paje_simulation_item *item)
+{
+  PajeTraceEvent *traceEvent = &item->traceEvent;
+  PajeContainer *container = item->container;
+  PajeType *type = item->type;
+
+  switch (traceEvent->pajeEventId()){
+  case PajeNewEventEventId: {
+    PajeNewEventEvent event (traceEvent, container, type, item->value);
+    container->demuxer (&event);
+    break;
+  }
+  case PajeSetStateEventId: {
+    PajeSetStateEvent event (traceEvent, container, type, item->value);
+    container->demuxer (&event);
+    break;
+  }
+  case PajePushStateEventId: {
+    PajePushStateEvent event (traceEvent, container, type, item->value);
+    container->demuxer (&event);
+    break;
+  }
+  case PajePopStateEventId: {
+    PajePopStateEvent event (traceEvent, container, type);
+    container->demuxer (&event);
+    break;
+  }
+  case PajeResetStateEventId: {
+    PajeResetStateEvent event (traceEvent, container, type);
+    container->demuxer (&event);
+    break;
+  }
+  case PajeSetVariableEventId: {
+    PajeSetVariableEvent event (traceEvent, container, type, item->doubleValue);
+    container->demuxer (&event);
+    break;
+  }
+  case PajeAddVariableEventId: {
+    PajeAddVariableEvent event (traceEvent, container, type, item->doubleValue);
+    container->demuxer (&event);
+    break;
+  }
+  case PajeSubVariableEventId: {
+    PajeSubVariableEvent event (traceEvent, container, type, item->doubleValue);
+    container->demuxer (&event);
+    break;
+  }
+  case PajeStartLinkEventId: {
+    PajeStartLinkEvent event (traceEvent, container, type, item->value, item->linkedContainer, item->key);
+    container->demuxer (&event);
+    break;
+  }
+  case PajeEndLinkEventId: {
+    PajeEndLinkEvent event (traceEvent, container, type, item->value, item->linkedContainer, item->key);
+    container->demuxer (&event);
+    break;
+  }
+  default:
+    throw PajeSimulationException ("Unknow event id.");
+  }
+}
+
+/*
+ * simulationLoop: after an error, the thread keeps taking batches
+ * without simulating them, the simulator reports the error once it
+ * waits for the thread. Once a thread has failed, the others only
+ * simulate, from their next batch on, the events before the one that
+ * failed; the events they simulated before that are not undone.
+ */
+static void *simulationLoop (void *arg)
+{
+  paje_simulation_shard *shard = (paje_simulation_shard*)arg;
+  pthread_setspecific (currentShard, shard);
+  pthread_mutex_lock (&shard->mutex);
+  while (true){
+    while (shard->batches.empty() && !shard->stop){
+      pthread_cond_wait (&shard->filled, &shard->mutex);
+    }
+    if (shard->stop) break;
+    paje_simulation_batch *batch = shard->batches.front();
+    shard->batches.pop_front();
+    shard->busy = true;
+    bool failed = shard->failed;
+    pthread_mutex_unlock (&shard->mutex);
+
+    pthread_mutex_lock (&shard->failure->mutex);
+    long long stopAt = shard->failure->sequence;
+    pthread_mutex_unlock (&shard->failure->mutex);
+
+    PajeException *error = NULL;
+    long long errorSequence = 0;
+    for (size_t i = 0; i < batch->count && !failed; i++){
+      if (stopAt != -1 && batch->items[i].sequence > stopAt) break;
+      shard->sequence = batch->items[i].sequence;
+      try {
+        simulateItem (&batch->items[i]);
+      }catch (PajeException& e){
+        error = e.clone();
+        errorSequence = batch->items[i].sequence;
+        failed = true;
+      }
+    }
+
+    if (failed && !shard->failed){
+      pthread_mutex_lock (&shard->failure->mutex);
+      if (shard->failure->sequence == -1 || errorSequence < shard->failure->sequence){
+        shard->failure->sequence = errorSequence;
+      }
+      pthread_mutex_unlock (&shard->failure->mutex);
+    }
+
+    pthread_mutex_lock (&shard->mutex);
+    if (failed && !shard->failed){
+      shard->failed = true;
+      shard->error = error;
+      shard->errorSequence = errorSequence;
+    }
+    batch->count = 0;
+    shard->freeBatches.push_back (batch);
+    shard->busy = false;
+    pthread_cond_broadcast (&shard->released);
+  }
+  pthread_mutex_unlock (&shard->mutex);
+  return NULL;
+}
+
+/*
+ * setSimulationThreads: containers are simulated by threads threads.
+ * With one or less, they are simulated by the thread reading the trace.
+ * It should be called before the first event.
+ */
+void PajeSimulator::setSimulationThreads (int threads)
+{
+  stopShards ();
+  if (threads > 1){
+    pthread_once (&currentShardOnce, createCurrentShard);
+    failure = new paje_simulation_failure;
+    pthread_mutex_init (&failure->mutex, NULL);
+    failure->sequence = -1;
+  }
+  for (int i = 0; i < threads && threads > 1; i++){
+    paje_simulation_shard *shard = new paje_simulation_shard;
+    pthread_mutex_init (&shard->mutex, NULL);
+    pthread_cond_init (&shard->filled, NULL);
+    pthread_cond_init (&shard->released, NULL);
+    for (int j = 0; j < PAJE_SIMULATOR_BATCHES; j++){
+      paje_simulation_batch *batch = new paje_simulation_batch;
+      batch->items.resize (PAJE_SIMULATOR_BATCH);
+      batch->count = 0;
+      shard->pool.push_back (batch);
+      shard->freeBatches.push_back (batch);
+    }
+    shard->current = NULL;
+    shard->busy = false;
+    shard->stop = false;
+    shard->failed = false;
+    shard->errorSequence = 0;
+    shard->error = NULL;
+    shard->failure = failure;
+    shard->sequence = 0;
+    pthread_create (&shard->thread, NULL, simulationLoop, shard);
+    shards.push_back (shard);
+  }
+  setEntitySink (entitySink);
+}
+
+void PajeSimulator::stopShards (void)
+{
+  for (unsigned int i = 0; i < shards.size(); i++){
+    paje_simulation_shard *shard = shards[i];
+    pthread_mutex_lock (&shard->mutex);
+    shard->stop = true;
+    pthread_cond_broadcast (&shard->filled);
+    pthread_mutex_unlock (&shard->mutex);
+    pthread_join (shard->thread, NULL);
+    for (unsigned int j = 0; j < shard->pool.size(); j++){
+      delete shard->pool[j];
+    }
+    for (unsigned int j = 0; j < shard->finished.size(); j++){
+      if (shard->finished[j].release){
+        entitySink->releaseEntity (shard->finished[j].entity);
+      }
+    }
+    delete shard->error;
+    pthread_cond_destroy (&shard->released);
+    pthread_cond_destroy (&shard->filled);
+    pthread_mutex_destroy (&shard->mutex);
+    delete shard;
+  }
+  shards.clear ();
+  if (failure){
+    pthread_mutex_destroy (&failure->mutex);
+    delete failure;
+    failure = NULL;
+  }
+}
+
+/*
+ * dispatch: simulates event right away without simulation threads,
+ * otherwise copies it to the batch of the thread of its container.
+ */
+void PajeSimulator::dispatch (PajeEvent *event)
+{
+  PajeContainer *container = event->container();
+  if (shards.empty()){
+    container->demuxer (event);
+    return;
+  }
+
+  paje_simulation_shard *shard = shardForContainer (shards, container);
+  if (!shard->current){
+    pthread_mutex_lock (&shard->mutex);
+    while (shard->freeBatches.empty()){
+      pthread_cond_wait (&shard->released, &shard->mutex);
+    }
+    shard->current = shard->freeBatches.front();
+    shard->freeBatches.pop_front();
+    pthread_mutex_unlock (&shard->mutex);
+  }
+
+  paje_simulation_item *item = &shard->current->items[shard->current->count++];
+  item->traceEvent.assign (event->traceEvent());
+  item->container = container;
+  item->type = event->type();
+  item->value = event->value();
+  item->doubleValue = event->doubleValue();
+  item->linkedContainer = event->startContainer() ? event->startContainer() : event->endContainer();
+  item->key = event->key();
+  item->sequence = sequence;
+
+  if (shard->current->count == PAJE_SIMULATOR_BATCH){
+    submit (shard);
+  }
+  if (shardSink && ++dispatched == PAJE_SIMULATOR_BATCH * PAJE_SIMULATOR_BATCHES){
+    synchronize ();
+  }
+}
+
+void PajeSimulator::submit (paje_simulation_shard *shard)
+{
+  pthread_mutex_lock (&shard->mutex);
+  shard->batches.push_back (shard->current);
+  shard->current = NULL;
+  pthread_cond_signal (&shard->filled);
+  pthread_mutex_unlock (&shard->mutex);
+}
+
+/*
+ * synchronize: waits until every event handed to the threads has been
+ * simulated, passes on the entities they finished before the earliest
+ * event that failed, if any, then throws its error.
+ */
+void PajeSimulator::synchronize (void)
+{
+  paje_simulation_shard *failed = NULL;
+  for (unsigned int i = 0; i < shards.size(); i++){
+    paje_simulation_shard *shard = shards[i];
+    if (shard->current && shard->current->count){
+      submit (shard);
+    }
+    pthread_mutex_lock (&shard->mutex);
+    while (!shard->batches.empty() || shard->busy){
+      pthread_cond_wait (&shard->released, &shard->mutex);
+    }
+    pthread_mutex_unlock (&shard->mutex);
+    if (shard->failed && (!failed || shard->errorSequence < failed->errorSequence)){
+      failed = shard;
+    }
+  }
+  if (shardSink){
+    passFinished (failed ? failed->errorSequence : sequence);
+    dispatched = 0;
+  }
+  if (failed){
+    failed->error->raise ();
+  }
+}
+
+/*
+ * passFinished: passes the entities finished by the threads on to the
+ * sink in the order of the events that finished them, which is the
+ * order of a simulation without threads, up to the event last. The
+ * ones finished after it, by threads that went past an error, are
+ * only released.
+ */
+void PajeSimulator::passFinished (long long last)
+{
+  std::vector<size_t> next (shards.size(), 0);
+  while (true){
+    paje_finished_entity *first = NULL;
+    unsigned int from = 0;
+    for (unsigned int i = 0; i < shards.size(); i++){
+      std::vector<paje_finished_entity> *finished = &shards[i]->finished;
+      if (next[i] < finished->size() && (!first || (*finished)[next[i]].sequence < first->sequence)){
+        first = &(*finished)[next[i]];
+        from = i;
+      }
+    }
+    if (!first) break;
+    next[from]++;
+    if (first->sequence <= last){
+      entitySink->entityFinished (first->entity);
+    }
+    if (first->release){
+      entitySink->releaseEntity (first->entity);
+    }
+  }
+  for (unsigned int i = 0; i < shards.size(); i++){
+    shards[i]->finished.clear();
+  }
+}
+
+PajeShardSink::PajeShardSink (PajeEntitySink *sink)
+{
+  this->sink = sink;
+}
+
+void PajeShardSink::entityFinished (PajeEntity *entity)
+{
+  paje_simulation_shard *shard = (paje_simulation_shard*)pthread_getspecific (currentShard);
+  if (!shard){
+    sink->entityFinished (entity);
+    return;
+  }
+  paje_finished_entity finished;
+  finished.sequence = shard->sequence;
+  finished.entity = entity;
+  finished.release = false;
+  shard->finished.push_back (finished);
+}
+
+//entities kept by a thread are released once they are passed on
+void PajeShardSink::releaseEntity (PajeEntity *entity)
+{
+  paje_simulation_shard *shard = (paje_simulation_shard*)pthread_getspecific (currentShard);
+  if (shard && !shard->finished.empty() && shard->finished.back().entity == entity){
+    shard->finished.back().release = true;
+  }else{
+    sink->releaseEntity (entity);
+  }
+}
@@ -119,20 +119,12 @@ double PajeSimulator::selectionEndTime (void)
 
 PajeType *PajeSimulator::entityTypeWithName (std::string name)
 {
-  if (typeNamesMap.count(name)){
-    return typeNamesMap[name];
-  }else{
-    return NULL;
-  }
+  return typeNamesMap.find (symbols.find (name));
 }
 
 PajeContainer *PajeSimulator::containerWithName (std::string name)
 {
-  if (contNamesMap.count(name)){
-    return contNamesMap[name];
-  }else{
-    return NULL;
-  }
+  return contNamesMap.find (symbols.find (name));
 }
 
 PajeColor *PajeSimulator::colorForValueOfEntityType (PajeType *type, PajeValue *value)
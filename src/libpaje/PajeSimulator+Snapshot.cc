@@ -0,0 +1,496 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "PajeSimulator.h"
+#include "PajeSnapshot.h"
+
+typedef std::map<PajeType*,uint32_t> paje_type_ids;
+typedef std::map<PajeValue*,uint32_t> paje_value_ids;
+typedef std::map<PajeContainer*,uint32_t> paje_container_ids;
+
+static void colorRecord (PajeColor *color, uint32_t *hasColor, float *record)
+{
+  *hasColor = color != NULL;
+  record[0] = color ? color->r : 0;
+  record[1] = color ? color->g : 0;
+  record[2] = color ? color->b : 0;
+  record[3] = color ? color->a : 0;
+}
+
+static PajeColor *recordColor (uint32_t hasColor, const float *record)
+{
+  return hasColor ? new PajeColor (record[0], record[1], record[2], record[3]) : NULL;
+}
+
+/*
+ * writeTypes: the types under containerType, parents first, container
+ * types in the first pass and the others, which may refer to any of
+ * them, in the second.
+ */
+static void writeTypes (PajeSnapshotWriter *writer, PajeType *containerType, bool containerTypes, paje_type_ids *typeIds, paje_value_ids *valueIds)
+{
+  std::map<std::string,PajeType*> children = containerType->children();
+  std::map<std::string,PajeType*>::iterator it;
+  for (it = children.begin(); it != children.end(); it++){
+    PajeType *type = (*it).second;
+    bool isContainerType = type->nature() == PAJE_ContainerType;
+    if (isContainerType == containerTypes){
+      uint32_t id = writer->types.size();
+      (*typeIds)[type] = id;
+
+      paje_snapshot_type record;
+      memset (&record, 0, sizeof (record));
+      record.nature = type->nature();
+      record.parent = (*typeIds)[containerType];
+      record.name = writer->stringId (type->name());
+      record.alias = writer->stringId (type->alias());
+      record.startType = type->nature() == PAJE_LinkType ? (*typeIds)[type->startType()] : PAJE_SNAPSHOT_NONE;
+      record.endType = type->nature() == PAJE_LinkType ? (*typeIds)[type->endType()] : PAJE_SNAPSHOT_NONE;
+      colorRecord (type->nature() == PAJE_VariableType ? type->color() : NULL, &record.hasColor, record.color);
+      writer->types.push_back (record);
+
+      if (type->isCategorizedType()){
+        PajeCategorizedType *categorized = (PajeCategorizedType*)type;
+        std::map<std::string,PajeValue*>::iterator value;
+        for (value = categorized->values.begin(); value != categorized->values.end(); value++){
+          paje_snapshot_value v;
+          v.type = id;
+          v.name = writer->stringId ((*value).second->name());
+          v.alias = writer->stringId ((*value).second->alias());
+          colorRecord ((*value).second->color(), &v.hasColor, v.color);
+          (*valueIds)[(*value).second] = writer->values.size();
+          writer->values.push_back (v);
+        }
+      }
+    }
+    if (isContainerType){
+      writeTypes (writer, type, containerTypes, typeIds, valueIds);
+    }
+  }
+}
+
+/* writeContainers: container and the containers in it, parents first */
+static void writeContainers (PajeSnapshotWriter *writer, PajeContainer *container, uint32_t parent, paje_type_ids *typeIds, paje_container_ids *containerIds, std::vector<PajeContainer*> *all)
+{
+  uint32_t id = writer->containers.size();
+  (*containerIds)[container] = id;
+  all->push_back (container);
+
+  paje_snapshot_container record;
+  memset (&record, 0, sizeof (record));
+  record.start = container->startTime();
+  record.end = container->endTime();
+  record.parent = parent;
+  record.type = (*typeIds)[container->type()];
+  record.name = writer->stringId (container->name());
+  record.alias = writer->stringId (container->_alias);
+  record.extra = writer->extraId (container->type()->extraFields()->fields (container->extraFields()));
+  writer->containers.push_back (record);
+
+  std::map<std::string,PajeContainer*>::iterator it;
+  for (it = container->children.begin(); it != container->children.end(); it++){
+    writeContainers (writer, (*it).second, id, typeIds, containerIds, all);
+  }
+}
+
+template <class T>
+static void writeColumn (PajeSnapshotWriter *writer, const std::vector<T> &column)
+{
+  if (!column.empty()){
+    writer->writeColumn (&column[0], column.size() * sizeof (T));
+  }
+}
+
+/*
+ * writeTimeline: the states, events or variables of type in a
+ * container, from its columns or else from its entities.
+ */
+static void writeTimeline (PajeSnapshotWriter *writer, PajeContainer *container, PajeType *type, uint32_t containerId, paje_type_ids *typeIds, paje_value_ids *valueIds)
+{
+  std::vector<PajeValue*> values;
+  std::vector<double> start, end, doubleValue;
+  std::vector<unsigned int> value;
+  std::vector<int> imbrication;
+  std::vector<uint32_t> extra;
+  PajeExtraFields *fields = type->extraFields();
+
+  PajeTimeline *timeline = container->timelineOfType (type);
+  if (timeline){
+    if (!timeline->size()) return;
+    values = timeline->valueTable();
+    start = timeline->start;
+    end = timeline->end;
+    value = timeline->value;
+    imbrication = timeline->imbrication;
+    doubleValue = timeline->doubleValue;
+    if (!timeline->extra.empty()){
+      //rows share records, each record is looked up once
+      std::map<const unsigned int*,uint32_t> ids;
+      for (size_t i = 0; i < timeline->size(); i++){
+        const unsigned int *record = timeline->extraRecord (i);
+        std::map<const unsigned int*,uint32_t>::iterator found = ids.find (record);
+        if (found == ids.end()){
+          found = ids.insert (std::make_pair (record, writer->extraId (fields->fields (record)))).first;
+        }
+        extra.push_back (found->second);
+      }
+    }
+  }else{
+    const std::vector<PajeEntity*> &entities = container->entitiesOfType (type);
+    if (entities.empty()) return;
+    PajeTimeline columns (container, type);
+    bool extras = false;
+    for (size_t i = 0; i < entities.size(); i++){
+      PajeEntity *entity = entities[i];
+      size_t row = columns.append (entity->startTime(), entity->value(), entity->doubleValue(), entity->imbricationLevel(), NULL);
+      columns.setEndTime (row, entity->endTime());
+      extra.push_back (writer->extraId (fields->fields (entity->extraFields())));
+      extras = extras || extra.back() != PAJE_SNAPSHOT_NONE;
+    }
+    values = columns.valueTable();
+    start = columns.start;
+    end = columns.end;
+    value = columns.value;
+    imbrication = columns.imbrication;
+    doubleValue = columns.doubleValue;
+    if (!extras){
+      extra.clear ();
+    }
+  }
+
+  //the index of the rows, built when the simulation ended
+  std::vector<unsigned int> index;
+  const PajeIntervalIndex *intervals = container->intervalIndexOfType (type);
+  if (intervals){
+    intervals->words (&index);
+  }
+  const std::vector<double> *integral = intervals ? container->integralOfType (type) : NULL;
+
+  paje_snapshot_timeline record;
+  record.rows = start.size();
+  record.container = containerId;
+  record.type = (*typeIds)[type];
+  record.values = values.size();
+  record.hasExtra = !extra.empty();
+  record.indexWords = index.size();
+  record.hasIntegral = integral != NULL;
+  record.padding = 0;
+  writer->writeTimeline (record);
+
+  std::vector<uint32_t> ids;
+  for (size_t i = 0; i < values.size(); i++){
+    ids.push_back ((*valueIds)[values[i]]);
+  }
+  writeColumn (writer, ids);
+  writeColumn (writer, start);
+  writeColumn (writer, end);
+  writeColumn (writer, value);
+  writeColumn (writer, imbrication);
+  writeColumn (writer, doubleValue);
+  writeColumn (writer, extra);
+  writeColumn (writer, index);
+  if (integral){
+    writeColumn (writer, *integral);
+  }
+}
+
+/*
+ * writeSnapshot: saves the finished simulation to filename, for the
+ * trace file as it is now and the settings of the simulation, see
+ * PajeSnapshot. Entities released to a sink are not in it.
+ */
+void PajeSimulator::writeSnapshot (std::string filename, std::string tracefilename, std::string settings)
+{
+  synchronize ();
+  PajeSnapshotWriter writer (filename, tracefilename, settings);
+
+  paje_type_ids typeIds;
+  paje_value_ids valueIds;
+  paje_snapshot_type record;
+  memset (&record, 0, sizeof (record));
+  record.nature = PAJE_ContainerType;
+  record.parent = record.startType = record.endType = PAJE_SNAPSHOT_NONE;
+  record.name = writer.stringId (rootType->name());
+  record.alias = writer.stringId (rootType->alias());
+  typeIds[rootType] = 0;
+  writer.types.push_back (record);
+  writeTypes (&writer, rootType, true, &typeIds, &valueIds);
+  writeTypes (&writer, rootType, false, &typeIds, &valueIds);
+
+  paje_container_ids containerIds;
+  std::vector<PajeContainer*> containers;
+  writeContainers (&writer, root, PAJE_SNAPSHOT_NONE, &typeIds, &containerIds, &containers);
+
+  writer.beginTimelines ();
+  for (size_t i = 0; i < containers.size(); i++){
+    std::vector<PajeType*> types = containers[i]->entityTypes();
+    for (size_t j = 0; j < types.size(); j++){
+      if (types[j]->nature() != PAJE_LinkType){
+        writeTimeline (&writer, containers[i], types[j], i, &typeIds, &valueIds);
+      }
+    }
+  }
+
+  writer.beginLinks ();
+  for (size_t i = 0; i < containers.size(); i++){
+    std::vector<PajeType*> types = containers[i]->entityTypes();
+    for (size_t j = 0; j < types.size(); j++){
+      if (types[j]->nature() != PAJE_LinkType) continue;
+      const std::vector<PajeEntity*> &links = containers[i]->entitiesOfType (types[j]);
+      for (size_t k = 0; k < links.size(); k++){
+        PajeUserLink *link = (PajeUserLink*)links[k];
+        paje_snapshot_link record;
+        memset (&record, 0, sizeof (record));
+        record.start = link->startTime();
+        record.end = link->endTime();
+        record.container = i;
+        record.type = typeIds[types[j]];
+        record.value = link->value() ? valueIds[link->value()] : PAJE_SNAPSHOT_NONE;
+        record.startContainer = link->startContainer() ? containerIds[link->startContainer()] : PAJE_SNAPSHOT_NONE;
+        record.endContainer = link->endContainer() ? containerIds[link->endContainer()] : PAJE_SNAPSHOT_NONE;
+        record.key = writer.stringId (link->linkKey());
+        record.extra = writer.extraId (types[j]->extraFields()->fields (link->extraFields()));
+        writer.writeLink (record);
+      }
+    }
+  }
+
+  writer.finish ();
+}
+
+static void corrupted (PajeSnapshot *snapshot)
+{
+  throw PajeSnapshotException (snapshot->fileName(), "it is corrupted");
+}
+
+//restoreExtraFields: entity gets the fields extra of the snapshot
+static void restoreExtraFields (PajeEntity *entity, const std::vector<paje_extra_list> &extras, uint32_t extra)
+{
+  std::vector<unsigned int> record;
+  if (extra != PAJE_SNAPSHOT_NONE){
+    entity->type()->extraFields()->collect (extras[extra], &record);
+  }
+  entity->setExtraFields (record.empty() ? NULL : &record[0]);
+}
+
+template <class T>
+static const char *readColumn (const char *column, uint64_t rows, std::vector<T> *target)
+{
+  const T *data = (const T*)column;
+  target->assign (data, data + rows);
+  return column + paje_snapshot_align (rows * sizeof (T));
+}
+
+/*
+ * loadSnapshot: rebuilds a finished simulation from snapshot, instead
+ * of reading a trace. The states, events and variables are kept in
+ * columns, see setColumnar.
+ */
+void PajeSimulator::loadSnapshot (PajeSnapshot *snapshot)
+{
+  setColumnar (true);
+
+  std::vector<PajeType*> types;
+  const paje_snapshot_type *t = snapshot->types();
+  for (uint64_t i = 0; i < snapshot->count (PAJE_SNAPSHOT_TYPES); i++){
+    if (i == 0){
+      types.push_back (rootType);
+      continue;
+    }
+    uint32_t parent = snapshot->checkId (t[i].parent, PAJE_SNAPSHOT_TYPES);
+    if (parent >= i || types[parent]->nature() != PAJE_ContainerType){
+      corrupted (snapshot);
+    }
+    PajeType *containerType = types[parent];
+    std::string name = snapshot->string (t[i].name);
+    std::string alias = snapshot->string (t[i].alias);
+    PajeType *type = NULL;
+    switch (t[i].nature){
+    case PAJE_ContainerType:
+      type = containerType->addContainerType (name, alias);
+      break;
+    case PAJE_VariableType:
+      type = containerType->addVariableType (name, alias, recordColor (t[i].hasColor, t[i].color));
+      break;
+    case PAJE_StateType:
+      type = containerType->addStateType (name, alias);
+      break;
+    case PAJE_EventType:
+      type = containerType->addEventType (name, alias);
+      break;
+    case PAJE_LinkType: {
+      uint32_t start = snapshot->checkId (t[i].startType, PAJE_SNAPSHOT_TYPES);
+      uint32_t end = snapshot->checkId (t[i].endType, PAJE_SNAPSHOT_TYPES);
+      if (start == PAJE_SNAPSHOT_NONE || end == PAJE_SNAPSHOT_NONE || start >= i || end >= i){
+        corrupted (snapshot);
+      }
+      type = containerType->addLinkType (name, alias, types[start], types[end]);
+      break;
+    }
+    default:
+      corrupted (snapshot);
+    }
+    typeMap.insert (symbols.intern (type->identifier()), type);
+    typeNamesMap.insert (symbols.intern (type->name()), type);
+    types.push_back (type);
+  }
+
+  std::vector<PajeValue*> values;
+  const paje_snapshot_value *v = snapshot->values();
+  for (uint64_t i = 0; i < snapshot->count (PAJE_SNAPSHOT_VALUES); i++){
+    uint32_t type = snapshot->checkId (v[i].type, PAJE_SNAPSHOT_TYPES);
+    if (type == PAJE_SNAPSHOT_NONE || !types[type]->isCategorizedType()){
+      corrupted (snapshot);
+    }
+    values.push_back (types[type]->addValue (snapshot->string (v[i].alias),
+                                             snapshot->string (v[i].name),
+                                             recordColor (v[i].hasColor, v[i].color)));
+  }
+
+  //the extra fields, numbered by the type of each entity that has them
+  std::vector<paje_extra_list> extras;
+  for (uint64_t i = 0; i < snapshot->count (PAJE_SNAPSHOT_EXTRAS); i++){
+    extras.push_back (snapshot->extraFields (i));
+  }
+
+  std::vector<PajeContainer*> containers;
+  const paje_snapshot_container *c = snapshot->containers();
+  for (uint64_t i = 0; i < snapshot->count (PAJE_SNAPSHOT_CONTAINERS); i++){
+    PajeContainer *container;
+    if (i == 0){
+      container = root;
+      container->setStartTime (c[i].start);
+    }else{
+      uint32_t parent = snapshot->checkId (c[i].parent, PAJE_SNAPSHOT_CONTAINERS);
+      uint32_t type = snapshot->checkId (c[i].type, PAJE_SNAPSHOT_TYPES);
+      if (parent >= i || type == PAJE_SNAPSHOT_NONE || types[type]->parent() != containers[parent]->type()){
+        corrupted (snapshot);
+      }
+      container = containers[parent]->restoreContainer (c[i].start,
+                                                         snapshot->string (c[i].name),
+                                                         snapshot->string (c[i].alias),
+                                                         types[type]);
+      contMap.insert (symbols.intern (container->identifier()), container);
+      contNamesMap.insert (symbols.intern (container->name()), container);
+    }
+    container->restoreEnd (c[i].end);
+    uint32_t extra = snapshot->checkId (c[i].extra, PAJE_SNAPSHOT_EXTRAS);
+    restoreExtraFields (container, extras, extra);
+    containers.push_back (container);
+  }
+
+  const char *position = NULL;
+  for (uint64_t i = 0; i < snapshot->count (PAJE_SNAPSHOT_TIMELINES); i++){
+    const char *column;
+    const paje_snapshot_timeline *record = snapshot->nextTimeline (&position, &column);
+    uint32_t container = snapshot->checkId (record->container, PAJE_SNAPSHOT_CONTAINERS);
+    PajeType *type = types[record->type];
+    if (container == PAJE_SNAPSHOT_NONE || type->parent() != containers[container]->type()){
+      corrupted (snapshot);
+    }
+    PajeTimeline *timeline = containers[container]->restoreTimeline (type);
+    PajeTypeNature nature = type->nature();
+    uint64_t rows = record->rows;
+
+    std::vector<uint32_t> ids;
+    column = readColumn (column, record->values, &ids);
+    std::vector<PajeValue*> table;
+    for (size_t j = 0; j < ids.size(); j++){
+      uint32_t id = snapshot->checkId (ids[j], PAJE_SNAPSHOT_VALUES);
+      table.push_back (id == PAJE_SNAPSHOT_NONE ? NULL : values[id]);
+    }
+    timeline->setValueTable (table);
+
+    column = readColumn (column, rows, &timeline->start);
+    if (nature == PAJE_StateType || nature == PAJE_VariableType){
+      column = readColumn (column, rows, &timeline->end);
+    }
+    if (nature == PAJE_StateType || nature == PAJE_EventType){
+      column = readColumn (column, rows, &timeline->value);
+      for (size_t j = 0; j < timeline->value.size(); j++){
+        if (timeline->value[j] >= table.size()){
+          corrupted (snapshot);
+        }
+      }
+    }
+    if (nature == PAJE_StateType){
+      column = readColumn (column, rows, &timeline->imbrication);
+    }
+    if (nature == PAJE_VariableType){
+      column = readColumn (column, rows, &timeline->doubleValue);
+    }
+    if (record->hasExtra){
+      column = readColumn (column, rows, &ids);
+      timeline->extra.resize (rows);
+      std::map<uint32_t,unsigned int> positions;
+      for (size_t j = 0; j < rows; j++){
+        uint32_t extra = snapshot->checkId (ids[j], PAJE_SNAPSHOT_EXTRAS);
+        if (extra == PAJE_SNAPSHOT_NONE){
+          timeline->extra[j] = PAJE_TIMELINE_NO_EXTRA;
+          continue;
+        }
+        std::map<uint32_t,unsigned int>::iterator found = positions.find (extra);
+        if (found == positions.end()){
+          std::vector<unsigned int> record;
+          type->extraFields()->collect (extras[extra], &record);
+          found = positions.insert (std::make_pair (extra, timeline->addExtraRecord (&record[0]))).first;
+        }
+        timeline->extra[j] = found->second;
+      }
+    }
+
+    //the index is restored instead of being built again, see buildIntervalIndex
+    if (record->indexWords){
+      PajeIntervalIndex *index = containers[container]->restoreIntervalIndex (type);
+      if (!index->restore ((const uint32_t*)column, record->indexWords, rows)){
+        corrupted (snapshot);
+      }
+      column += paje_snapshot_align (record->indexWords * sizeof (uint32_t));
+      if (record->hasIntegral){
+        column = readColumn (column, rows + 1, containers[container]->restoreIntegral (type));
+      }
+    }else if (record->hasIntegral){
+      corrupted (snapshot);
+    }
+  }
+
+  const paje_snapshot_link *l = snapshot->links();
+  for (uint64_t i = 0; i < snapshot->count (PAJE_SNAPSHOT_LINKS); i++){
+    uint32_t container = snapshot->checkId (l[i].container, PAJE_SNAPSHOT_CONTAINERS);
+    uint32_t type = snapshot->checkId (l[i].type, PAJE_SNAPSHOT_TYPES);
+    uint32_t value = snapshot->checkId (l[i].value, PAJE_SNAPSHOT_VALUES);
+    uint32_t start = snapshot->checkId (l[i].startContainer, PAJE_SNAPSHOT_CONTAINERS);
+    uint32_t end = snapshot->checkId (l[i].endContainer, PAJE_SNAPSHOT_CONTAINERS);
+    uint32_t extra = snapshot->checkId (l[i].extra, PAJE_SNAPSHOT_EXTRAS);
+    if (container == PAJE_SNAPSHOT_NONE || type == PAJE_SNAPSHOT_NONE ||
+        types[type]->nature() != PAJE_LinkType || types[type]->parent() != containers[container]->type()){
+      corrupted (snapshot);
+    }
+    PajeUserLink *link = containers[container]->restoreLink (types[type], l[i].start,
+                                                             value == PAJE_SNAPSHOT_NONE ? NULL : values[value],
+                                                             snapshot->string (l[i].key),
+                                                             start == PAJE_SNAPSHOT_NONE ? NULL : containers[start]);
+    link->setEndContainer (end == PAJE_SNAPSHOT_NONE ? NULL : containers[end]);
+    link->setEndTime (l[i].end);
+    restoreExtraFields (link, extras, extra);
+  }
+
+  lastKnownTime = root->endTime();
+  root->buildIntervalIndex ();
+  hierarchyChanged ();
+  timeLimitsChanged ();
+  setSelectionStartEndTime (startTime(), endTime());
+}
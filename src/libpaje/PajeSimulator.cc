@@ -14,7 +14,10 @@
     You should have received a copy of the GNU Public License
     along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
 */
+#include <limits.h>
+#include <stdlib.h>
 #include "PajeSimulator.h"
+#include "PajeTraceFile.h"
 #include "PajeException.h"
 #include <boost/foreach.hpp>
 #include <boost/tokenizer.hpp>
@@ -63,12 +66,24 @@ void PajeSimulator::init (void)
   invocation[PajeTraceFileEventId] = &PajeSimulator::pajeTraceFile;
   rootType = new PajeContainerType ("0", "0", NULL);
   root = new PajeContainer (0, "0", "0", NULL, rootType, NULL);
-  typeMap[rootType->identifier()] = rootType;
-  typeNamesMap[rootType->name()] = rootType;
-  contMap[root->identifier()] = root;
-  contNamesMap[root->name()] = root;
+  typeMap.insert (symbols.intern (rootType->identifier()), rootType);
+  typeNamesMap.insert (symbols.intern (rootType->name()), rootType);
+  contMap.insert (symbols.intern (root->identifier()), root);
+  contNamesMap.insert (symbols.intern (root->name()), root);
   lastKnownTime = -1;
 
+  traceFileDefinitions = NULL;
+  ownTraceFileDefinitions = false;
+  traceFileDecoder = NULL;
+  currentTraceFile = NULL;
+  sequence = 0;
+  failure = NULL;
+  entitySink = NULL;
+  shardSink = NULL;
+  dispatched = 0;
+  teardown = true;
+  restoring = false;
+
   selectionStart = -1;
   selectionEnd = -1;
 }
@@ -125,15 +140,16 @@ bool PajeSimulator::keepSimulating (void)
   if (stopSimulationAtTime == -1){
     return true;
   }else{
+    //the simulation threads change the end time of containers
+    synchronize ();
     return root->keepSimulating ();
   }
 }
 
 void PajeSimulator::setLastKnownTime (PajeTraceEvent *event)
 {
-  std::string time = event->valueForField (PAJE_Time);
-  if (time.length()){
-    double evttime = atof(time.c_str());
+  double evttime;
+  if (event->doubleValueForField (PAJE_Time, &evttime)){
     lastKnownTime = evttime;
   }
 }
@@ -163,8 +179,18 @@ PajeColor *PajeSimulator::getColor (std::string color, PajeTraceEvent *event)
 
 PajeSimulator::~PajeSimulator ()
 {
-  delete root;
-  delete rootType;
+  stopShards ();
+  for (unsigned int i = 0; i < pendingTraceFiles.size(); i++){
+    delete pendingTraceFiles[i];
+  }
+  if (ownTraceFileDefinitions){
+    delete traceFileDefinitions;
+  }
+  if (teardown){
+    delete root;
+    delete rootType;
+  }
+  delete shardSink;
   typeMap.clear ();
   typeNamesMap.clear ();
   contMap.clear();
@@ -175,12 +201,43 @@ void PajeSimulator::inputEntity (PajeObject *data)
 {
   //get event, set last known time
   PajeTraceEvent *event = (PajeTraceEvent*)data;
+  if (!pendingTraceFiles.empty() && event->pajeEventId() != PajeTraceFileEventId){
+    simulateTraceFiles ();
+  }
   setLastKnownTime (event);
+  sequence++;
   //change the simulated behavior according to the event
   PajeEventId eventId = event->pajeEventId();
   if (eventId < PajeEventIdCount){
     if (invocation[eventId]){
-      CALL_MEMBER_PAJE_SIMULATOR(*this,invocation[eventId])(event);
+      if (shards.empty()){
+        CALL_MEMBER_PAJE_SIMULATOR(*this,invocation[eventId])(event);
+        return;
+      }
+      //events that change types or containers wait for the threads
+      switch (eventId){
+      case PajeNewEventEventId:
+      case PajeSetStateEventId:
+      case PajePushStateEventId:
+      case PajePopStateEventId:
+      case PajeResetStateEventId:
+      case PajeSetVariableEventId:
+      case PajeAddVariableEventId:
+      case PajeSubVariableEventId:
+      case PajeStartLinkEventId:
+      case PajeEndLinkEventId:
+        break;
+      default:
+        synchronize ();
+        break;
+      }
+      try {
+        CALL_MEMBER_PAJE_SIMULATOR(*this,invocation[eventId])(event);
+      }catch (PajeException&){
+        //an error of an earlier event, found by a thread, comes first
+        synchronize ();
+        throw;
+      }
     }
   }else{
     throw PajeSimulationException ("Unknow event id.");
@@ -193,12 +250,18 @@ void PajeSimulator::startReading (void)
 
 void PajeSimulator::finishedReading (void)
 {
+  if (!pendingTraceFiles.empty()){
+    simulateTraceFiles ();
+  }
+  synchronize ();
+
   //file has ended, mark all containers as destroyed
   if (stopSimulationAtTime == -1){
     root->recursiveDestroy (lastKnownTime);
   }else{
     root->recursiveDestroy (stopSimulationAtTime);
   }
+  root->buildIntervalIndex ();
   hierarchyChanged ();
   timeLimitsChanged ();
   setSelectionStartEndTime (startTime(), endTime());
@@ -207,7 +270,7 @@ void PajeSimulator::finishedReading (void)
 void PajeSimulator::pajeDefineContainerType (PajeTraceEvent *event)
 {
   std::string name = event->valueForField (PAJE_Name);
-  std::string type = event->valueForField (PAJE_Type);
+  paje_symbol type = symbols.intern (event->keyForField (PAJE_Type));
   std::string alias = event->valueForField (PAJE_Alias);
 
   //first, check if the name is allowed (it should be
@@ -219,139 +282,140 @@ void PajeSimulator::pajeDefineContainerType (PajeTraceEvent *event)
   }
 
   //search for parent type
-  PajeType *containerType = typeMap[type];
+  PajeType *containerType = typeMap.find (type);
   if (!containerType){
     std::stringstream line;
     line << *event;
-    throw PajeTypeException ("Unknow container type '"+type+"' in "+line.str());
+    throw PajeTypeException ("Unknow container type '"+symbols.name (type)+"' in "+line.str());
   }
 
   std::string identifier = !alias.empty() ? alias : name;
-  PajeType *newType = typeMap[identifier];
+  PajeType *newType = typeMap.find (symbols.find (identifier));
   if (newType){
     std::stringstream line;
     line << *event;
     throw PajeTypeException ("Container type '"+identifier+"' in "+line.str()+" already defined.");
   }
   newType = containerType->addContainerType (name, alias);
-  typeMap[newType->identifier()] = newType;
-  typeNamesMap[newType->name()] = newType;
+  typeMap.insert (symbols.intern (newType->identifier()), newType);
+  typeNamesMap.insert (symbols.intern (newType->name()), newType);
 }
 
 void PajeSimulator::pajeDefineLinkType (PajeTraceEvent *event)
 {
   std::string name = event->valueForField (PAJE_Name);
-  std::string type = event->valueForField (PAJE_Type);
-  std::string starttype = event->valueForField (PAJE_StartContainerType);
-  std::string endtype = event->valueForField (PAJE_EndContainerType);
+  paje_symbol type = symbols.intern (event->keyForField (PAJE_Type));
+  paje_symbol starttype = symbols.intern (event->keyForField (PAJE_StartContainerType));
+  paje_symbol endtype = symbols.intern (event->keyForField (PAJE_EndContainerType));
   std::string alias = event->valueForField (PAJE_Alias);
 
   //search for parent type
-  PajeType *containerType = typeMap[type];
+  PajeType *containerType = typeMap.find (type);
   if (!containerType){
     std::stringstream line;
     line << *event;
-    throw PajeTypeException ("Unknow container type '"+type+"' in "+line.str());
+    throw PajeTypeException ("Unknow container type '"+symbols.name (type)+"' in "+line.str());
   }
 
   //search for start container type
-  PajeType *startcontainertype = typeMap[starttype];
+  PajeType *startcontainertype = typeMap.find (starttype);
   if (!startcontainertype){
     std::stringstream line;
     line << *event;
-    throw PajeTypeException ("Unknow start container type '"+starttype+"' for link definition in "+line.str());
+    throw PajeTypeException ("Unknow start container type '"+symbols.name (starttype)+"' for link definition in "+line.str());
   }
 
   //search for end container type
-  PajeType *endcontainertype = typeMap[endtype];
+  PajeType *endcontainertype = typeMap.find (endtype);
   if (!endcontainertype){
     std::stringstream line;
     line << *event;
-    throw PajeTypeException ("Unknow end container type '"+endtype+"' for link definition in "+line.str());
+    throw PajeTypeException ("Unknow end container type '"+symbols.name (endtype)+"' for link definition in "+line.str());
   }
 
   //check if the new type already exists
   std::string identifier = !alias.empty() ? alias : name;
-  PajeType *newType = typeMap[identifier];
+  PajeType *newType = typeMap.find (symbols.find (identifier));
   if (newType){
     std::stringstream line;
     line << *event;
     throw PajeTypeException ("Link type '"+identifier+"' in "+line.str()+" already defined");
   }
   newType = containerType->addLinkType (name, alias, startcontainertype, endcontainertype);
-  typeMap[newType->identifier()] = newType;
-  typeNamesMap[newType->name()] = newType;
+  typeMap.insert (symbols.intern (newType->identifier()), newType);
+  typeNamesMap.insert (symbols.intern (newType->name()), newType);
 }
 
 void PajeSimulator::pajeDefineEventType (PajeTraceEvent *event)
 {
   std::string name = event->valueForField (PAJE_Name);
-  std::string type = event->valueForField (PAJE_Type);
+  paje_symbol type = symbols.intern (event->keyForField (PAJE_Type));
   std::string alias = event->valueForField (PAJE_Alias);
 
   //search for parent type
-  PajeType *containerType = typeMap[type];
+  PajeType *containerType = typeMap.find (type);
   if (!containerType){
     std::stringstream line;
     line << *event;
-    throw PajeTypeException ("Unknow container type '"+type+"' in "+line.str());
+    throw PajeTypeException ("Unknow container type '"+symbols.name (type)+"' in "+line.str());
   }
 
   std::string identifier = !alias.empty() ? alias : name;
-  PajeType *newType = typeMap[identifier];
+  PajeType *newType = typeMap.find (symbols.find (identifier));
   if (newType){
     std::stringstream line;
     line << *event;
     throw PajeTypeException ("Event type '"+identifier+"' in "+line.str()+" already defined");
   }
   newType = containerType->addEventType (name, alias);
-  typeMap[newType->identifier()] = newType;
-  typeNamesMap[newType->name()] = newType;
+  typeMap.insert (symbols.intern (newType->identifier()), newType);
+  typeNamesMap.insert (symbols.intern (newType->name()), newType);
 }
 
 void PajeSimulator::pajeDefineStateType (PajeTraceEvent *event)
 {
   std::string name = event->valueForField (PAJE_Name);
-  std::string type = event->valueForField (PAJE_Type);
+  paje_symbol type = symbols.intern (event->keyForField (PAJE_Type));
   std::string alias = event->valueForField (PAJE_Alias);
 
   //search for parent type
-  PajeType *containerType = typeMap[type];
+  PajeType *containerType = typeMap.find (type);
   if (!containerType){
     std::stringstream line;
     line << *event;
-    throw PajeTypeException ("Unknow container type '"+type+"' in "+line.str());
+    throw PajeTypeException ("Unknow container type '"+symbols.name (type)+"' in "+line.str());
   }
 
   std::string identifier = !alias.empty() ? alias : name;
-  PajeType *newType = typeMap[identifier];
+  PajeType *newType = typeMap.find (symbols.find (identifier));
   if (newType){
     std::stringstream line;
     line << *event;
     throw PajeTypeException ("State type '"+identifier+"' in "+line.str()+" already defined");
   }
   newType = containerType->addStateType (name, alias);
-  typeMap[newType->identifier()] = newType;
-  typeNamesMap[newType->name()] = newType;
+  typeMap.insert (symbols.intern (newType->identifier()), newType);
+  typeNamesMap.insert (symbols.intern (newType->name()), newType);
+  applyCompaction (newType);
 }
 
 void PajeSimulator::pajeDefineVariableType (PajeTraceEvent *event)
 {
   std::string name = event->valueForField (PAJE_Name);
-  std::string type = event->valueForField (PAJE_Type);
+  paje_symbol type = symbols.intern (event->keyForField (PAJE_Type));
   std::string alias = event->valueForField (PAJE_Alias);
   std::string color = event->valueForField (PAJE_Color);
 
   //search for parent type
-  PajeType *containerType = typeMap[type];
+  PajeType *containerType = typeMap.find (type);
   if (!containerType){
     std::stringstream line;
     line << *event;
-    throw PajeTypeException ("Unknow container type '"+type+"' in "+line.str());
+    throw PajeTypeException ("Unknow container type '"+symbols.name (type)+"' in "+line.str());
   }
 
   std::string identifier = !alias.empty() ? alias : name;
-  PajeType *newType = typeMap[identifier];
+  PajeType *newType = typeMap.find (symbols.find (identifier));
   if (newType){
     std::stringstream line;
     line << *event;
@@ -362,47 +426,48 @@ void PajeSimulator::pajeDefineVariableType (PajeTraceEvent *event)
   PajeColor *pajeColor = getColor (color, event);
 
   newType = containerType->addVariableType (name, alias, pajeColor);
-  typeMap[newType->identifier()] = newType;
-  typeNamesMap[newType->name()] = newType;
+  typeMap.insert (symbols.intern (newType->identifier()), newType);
+  typeNamesMap.insert (symbols.intern (newType->name()), newType);
+  applyCompaction (newType);
 }
 
 void PajeSimulator::pajeDefineEntityValue (PajeTraceEvent *event)
 {
   std::string name = event->valueForField (PAJE_Name);
-  std::string typestr = event->valueForField (PAJE_Type);
+  paje_symbol typestr = symbols.intern (event->keyForField (PAJE_Type));
   std::string color = event->valueForField (PAJE_Color);
   std::string alias = event->valueForField (PAJE_Alias);
 
   //search for type
-  PajeType *type = typeMap[typestr];
+  PajeType *type = typeMap.find (typestr);
   if (!type){
     std::stringstream line;
     line << *event;
-    throw PajeTypeException ("Unknow type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Unknow type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   //check if the type accepts values
   if (this->isContainerType (type)){
     std::stringstream line;
     line << *event;
-    throw PajeTypeException ("Trying to define the value '"+name+"' for the type '"+typestr+"' (which is a container type) is invalid in "+line.str());
+    throw PajeTypeException ("Trying to define the value '"+name+"' for the type '"+symbols.name (typestr)+"' (which is a container type) is invalid in "+line.str());
   }
 
   if (this->isVariableType (type)){
     std::stringstream line;
     line << *event;
-    throw PajeTypeException ("Trying to define the value '"+name+"' for the type '"+typestr+"' (which is a variable type) is invalid in "+line.str());
+    throw PajeTypeException ("Trying to define the value '"+name+"' for the type '"+symbols.name (typestr)+"' (which is a variable type) is invalid in "+line.str());
   }
 
   //check if the value already exists using the alias or the name
   if (!alias.empty() && type->hasValueForIdentifier (alias)){
     std::stringstream line;
     line << *event;
-    throw PajeTypeException ("Trying to redefine the value identified by '"+alias+"' for the type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Trying to redefine the value identified by '"+alias+"' for the type '"+symbols.name (typestr)+"' in "+line.str());
   }else if (type->hasValueForIdentifier (name)){
     std::stringstream line;
     line << *event;
-    throw PajeTypeException ("Trying to redefine the value identified by '"+name+"' for the type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Trying to redefine the value identified by '"+name+"' for the type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   //validate the color, if provided
@@ -413,9 +478,8 @@ void PajeSimulator::pajeDefineEntityValue (PajeTraceEvent *event)
 
 void PajeSimulator::pajeCreateContainer (PajeTraceEvent *traceEvent)
 {
-  std::string time = traceEvent->valueForField (PAJE_Time);
-  std::string typestr = traceEvent->valueForField (PAJE_Type);
-  std::string containerid = traceEvent->valueForField (PAJE_Container);
+  paje_symbol typestr = symbols.intern (traceEvent->keyForField (PAJE_Type));
+  paje_symbol containerid = symbols.intern (traceEvent->keyForField (PAJE_Container));
   std::string name = traceEvent->valueForField (PAJE_Name);
   std::string alias = traceEvent->valueForField (PAJE_Alias);
 
@@ -429,25 +493,25 @@ void PajeSimulator::pajeCreateContainer (PajeTraceEvent *traceEvent)
   }
 
   //search the container type for the new container
-  PajeType *type = typeMap[typestr];
+  PajeType *type = typeMap.find (typestr);
   if (!type){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeTypeException ("Unknown container type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Unknown container type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   if (type->nature() != PAJE_ContainerType){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeTypeException ("Not a container type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Not a container type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   //search the container of the new container
-  PajeContainer *container = contMap[containerid];
+  PajeContainer *container = contMap.find (containerid);
   if (!container){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown container '"+containerid+"' in "+line.str());
+    throw PajeContainerException ("Unknown container '"+symbols.name (containerid)+"' in "+line.str());
   }
 
   //verify if the container type is correctly informed
@@ -463,7 +527,7 @@ void PajeSimulator::pajeCreateContainer (PajeTraceEvent *traceEvent)
 
   //verify if there is a container with the same name
   std::string identifier = !alias.empty() ? alias : name;  
-  PajeContainer *cont = contMap[identifier];
+  PajeContainer *cont = contMap.find (symbols.find (identifier));
   if (cont){
     std::stringstream eventdesc;
     eventdesc << *traceEvent;
@@ -473,8 +537,8 @@ void PajeSimulator::pajeCreateContainer (PajeTraceEvent *traceEvent)
   //everything seems ok, create the container
   PajeContainer *newContainer = container->pajeCreateContainer (lastKnownTime, type, traceEvent, stopSimulationAtTime);
   if (newContainer){
-    contMap[newContainer->identifier()] = newContainer;
-    contNamesMap[newContainer->name()] = newContainer;
+    contMap.insert (symbols.intern (newContainer->identifier()), newContainer);
+    contNamesMap.insert (symbols.intern (newContainer->name()), newContainer);
   }else{
     std::stringstream eventdesc;
     eventdesc << *traceEvent;
@@ -484,24 +548,23 @@ void PajeSimulator::pajeCreateContainer (PajeTraceEvent *traceEvent)
 
 void PajeSimulator::pajeDestroyContainer (PajeTraceEvent *traceEvent)
 {
-  std::string time = traceEvent->valueForField (PAJE_Time);
-  std::string type = traceEvent->valueForField (PAJE_Type);
-  std::string name = traceEvent->valueForField (PAJE_Name);
+  paje_symbol type = symbols.intern (traceEvent->keyForField (PAJE_Type));
+  paje_symbol name = symbols.intern (traceEvent->keyForField (PAJE_Name));
 
   //search the container type for the new container
-  PajeType *containerType = typeMap[type];
+  PajeType *containerType = typeMap.find (type);
   if (!containerType){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeTypeException ("Unknown container type '"+type+"' in "+line.str());
+    throw PajeTypeException ("Unknown container type '"+symbols.name (type)+"' in "+line.str());
   }
 
   //search the container to be destroyed
-  PajeContainer *container = contMap[name];
+  PajeContainer *container = contMap.find (name);
   if (!container){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown container '"+name+"' in "+line.str());
+    throw PajeContainerException ("Unknown container '"+symbols.name (name)+"' in "+line.str());
   }
 
   //checks
@@ -524,25 +587,24 @@ void PajeSimulator::pajeDestroyContainer (PajeTraceEvent *traceEvent)
 
 void PajeSimulator::pajeNewEvent (PajeTraceEvent *traceEvent)
 {
-  std::string time = traceEvent->valueForField (PAJE_Time);
-  std::string typestr = traceEvent->valueForField (PAJE_Type);
-  std::string containerstr = traceEvent->valueForField (PAJE_Container);
-  std::string value = traceEvent->valueForField (PAJE_Value);
+  paje_symbol typestr = symbols.intern (traceEvent->keyForField (PAJE_Type));
+  paje_symbol containerstr = symbols.intern (traceEvent->keyForField (PAJE_Container));
+  paje_string_key value = traceEvent->keyForField (PAJE_Value);
 
   //search the container
-  PajeContainer *container = contMap[containerstr];
+  PajeContainer *container = contMap.find (containerstr);
   if (!container){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown container '"+containerstr+"' in "+line.str());
+    throw PajeContainerException ("Unknown container '"+symbols.name (containerstr)+"' in "+line.str());
   }
 
   //search the type
-  PajeType *type = typeMap[typestr];
+  PajeType *type = typeMap.find (typestr);
   if (!type){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeTypeException ("Unknown type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Unknown type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   //verify if the type is a event type
@@ -566,38 +628,36 @@ void PajeSimulator::pajeNewEvent (PajeTraceEvent *traceEvent)
   }
 
   //check if the value was previously declared
-  PajeValue *val = NULL;
-  if (type->hasValueForIdentifier (value)){
-    val = type->valueForIdentifier (value);
-  }else{
-    val = type->addValue (value, value, NULL);
+  PajeValue *val = type->valueForKey (value);
+  if (!val){
+    std::string valuestr (value.str, value.length);
+    val = type->addValue (valuestr, valuestr, NULL);
   }
 
   PajeNewEventEvent event (traceEvent, container, type, val);
-  container->demuxer (&event);
+  dispatch (&event);
 }
 
 void PajeSimulator::pajeSetState (PajeTraceEvent *traceEvent)
 {
-  std::string time = traceEvent->valueForField (PAJE_Time);
-  std::string typestr = traceEvent->valueForField (PAJE_Type);
-  std::string containerstr = traceEvent->valueForField (PAJE_Container);
-  std::string value = traceEvent->valueForField (PAJE_Value);
+  paje_symbol typestr = symbols.intern (traceEvent->keyForField (PAJE_Type));
+  paje_symbol containerstr = symbols.intern (traceEvent->keyForField (PAJE_Container));
+  paje_string_key value = traceEvent->keyForField (PAJE_Value);
 
   //search the container
-  PajeContainer *container = contMap[containerstr];
+  PajeContainer *container = contMap.find (containerstr);
   if (!container){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown container '"+containerstr+"' in "+line.str());
+    throw PajeContainerException ("Unknown container '"+symbols.name (containerstr)+"' in "+line.str());
   }
 
   //search the type
-  PajeType *type = typeMap[typestr];
+  PajeType *type = typeMap.find (typestr);
   if (!type){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeTypeException ("Unknown type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Unknown type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   //verify if the type is a state type
@@ -621,38 +681,38 @@ void PajeSimulator::pajeSetState (PajeTraceEvent *traceEvent)
   }
 
   //check if the value was previously declared
-  PajeValue *val = NULL;
-  if (type->hasValueForIdentifier (value)){
-    val = type->valueForIdentifier (value);
-  }else{
-    val = type->addValue (value, value, NULL);
+  PajeValue *val = type->valueForKey (value);
+  if (!val){
+    std::string valuestr (value.str, value.length);
+    val = type->addValue (valuestr, valuestr, NULL);
   }
 
+  prepareCompaction (type);
+
   PajeSetStateEvent event (traceEvent, container, type, val);
-  container->demuxer (&event);
+  dispatch (&event);
 }
 
 void PajeSimulator::pajePushState (PajeTraceEvent *traceEvent)
 {
-  std::string time = traceEvent->valueForField (PAJE_Time);
-  std::string typestr = traceEvent->valueForField (PAJE_Type);
-  std::string containerstr = traceEvent->valueForField (PAJE_Container);
-  std::string value = traceEvent->valueForField (PAJE_Value);
+  paje_symbol typestr = symbols.intern (traceEvent->keyForField (PAJE_Type));
+  paje_symbol containerstr = symbols.intern (traceEvent->keyForField (PAJE_Container));
+  paje_string_key value = traceEvent->keyForField (PAJE_Value);
 
   //search the container
-  PajeContainer *container = contMap[containerstr];
+  PajeContainer *container = contMap.find (containerstr);
   if (!container){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown container '"+containerstr+"' in "+line.str());
+    throw PajeContainerException ("Unknown container '"+symbols.name (containerstr)+"' in "+line.str());
   }
 
   //search the type
-  PajeType *type = typeMap[typestr];
+  PajeType *type = typeMap.find (typestr);
   if (!type){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeTypeException ("Unknown type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Unknown type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   //verify if the type is a state type
@@ -676,37 +736,37 @@ void PajeSimulator::pajePushState (PajeTraceEvent *traceEvent)
   }
 
   //check if the value was previously declared
-  PajeValue *val = NULL;
-  if (type->hasValueForIdentifier (value)){
-    val = type->valueForIdentifier (value);
-  }else{
-    val = type->addValue (value, value, NULL);
+  PajeValue *val = type->valueForKey (value);
+  if (!val){
+    std::string valuestr (value.str, value.length);
+    val = type->addValue (valuestr, valuestr, NULL);
   }
 
+  prepareCompaction (type);
+
   PajePushStateEvent event (traceEvent, container, type, val);
-  container->demuxer (&event);
+  dispatch (&event);
 }
 
 void PajeSimulator::pajePopState (PajeTraceEvent *traceEvent)
 {
-  std::string time = traceEvent->valueForField (PAJE_Time);
-  std::string typestr = traceEvent->valueForField (PAJE_Type);
-  std::string containerstr = traceEvent->valueForField (PAJE_Container);
+  paje_symbol typestr = symbols.intern (traceEvent->keyForField (PAJE_Type));
+  paje_symbol containerstr = symbols.intern (traceEvent->keyForField (PAJE_Container));
 
   //search the container
-  PajeContainer *container = contMap[containerstr];
+  PajeContainer *container = contMap.find (containerstr);
   if (!container){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown container '"+containerstr+"' in "+line.str());
+    throw PajeContainerException ("Unknown container '"+symbols.name (containerstr)+"' in "+line.str());
   }
 
   //search the type
-  PajeType *type = typeMap[typestr];
+  PajeType *type = typeMap.find (typestr);
   if (!type){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeTypeException ("Unknown type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Unknown type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   //verify if the type is a state type
@@ -729,31 +789,32 @@ void PajeSimulator::pajePopState (PajeTraceEvent *traceEvent)
     throw PajeTypeException ("Type '"+ctype1.str()+"' is not child type of container type '"+ctype2.str()+"' in "+eventdesc.str());
   }
 
+  prepareCompaction (type);
+
   PajePopStateEvent event (traceEvent, container, type);
-  container->demuxer (&event);
+  dispatch (&event);
 }
 
 
 void PajeSimulator::pajeResetState (PajeTraceEvent *traceEvent)
 {
-  std::string time = traceEvent->valueForField (PAJE_Time);
-  std::string typestr = traceEvent->valueForField (PAJE_Type);
-  std::string containerstr = traceEvent->valueForField (PAJE_Container);
+  paje_symbol typestr = symbols.intern (traceEvent->keyForField (PAJE_Type));
+  paje_symbol containerstr = symbols.intern (traceEvent->keyForField (PAJE_Container));
 
   //search the container
-  PajeContainer *container = contMap[containerstr];
+  PajeContainer *container = contMap.find (containerstr);
   if (!container){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown container '"+containerstr+"' in "+line.str());
+    throw PajeContainerException ("Unknown container '"+symbols.name (containerstr)+"' in "+line.str());
   }
 
   //search the type
-  PajeType *type = typeMap[typestr];
+  PajeType *type = typeMap.find (typestr);
   if (!type){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeTypeException ("Unknown type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Unknown type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   //verify if the type is a state type
@@ -776,31 +837,31 @@ void PajeSimulator::pajeResetState (PajeTraceEvent *traceEvent)
     throw PajeTypeException ("Type '"+ctype1.str()+"' is not child type of container type '"+ctype2.str()+"' in "+eventdesc.str());
   }
 
+  prepareCompaction (type);
+
   PajeResetStateEvent event (traceEvent, container, type);
-  container->demuxer (&event);
+  dispatch (&event);
 }
 
 void PajeSimulator::pajeSetVariable (PajeTraceEvent *traceEvent)
 {
-  std::string time = traceEvent->valueForField (PAJE_Time);
-  std::string typestr = traceEvent->valueForField (PAJE_Type);
-  std::string containerstr = traceEvent->valueForField (PAJE_Container);
-  std::string value = traceEvent->valueForField (PAJE_Value);
+  paje_symbol typestr = symbols.intern (traceEvent->keyForField (PAJE_Type));
+  paje_symbol containerstr = symbols.intern (traceEvent->keyForField (PAJE_Container));
 
   //search the container
-  PajeContainer *container = contMap[containerstr];
+  PajeContainer *container = contMap.find (containerstr);
   if (!container){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown container '"+containerstr+"' in "+line.str());
+    throw PajeContainerException ("Unknown container '"+symbols.name (containerstr)+"' in "+line.str());
   }
 
   //search the type
-  PajeType *type = typeMap[typestr];
+  PajeType *type = typeMap.find (typestr);
   if (!type){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeTypeException ("Unknown type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Unknown type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   //verify if the type is a variable type
@@ -823,33 +884,35 @@ void PajeSimulator::pajeSetVariable (PajeTraceEvent *traceEvent)
     throw PajeTypeException ("Type '"+ctype1.str()+"' is not child type of container type '"+ctype2.str()+"' in "+eventdesc.str());
   }
 
-  float v = strtof (value.c_str(), NULL);
+  double value;
+  if (!traceEvent->doubleValueForField (PAJE_Value, &value)){
+    value = 0;
+  }
+  double v = restoring ? value : (float)value;
 
   PajeSetVariableEvent event (traceEvent, container, type, v);
-  container->demuxer (&event);
+  dispatch (&event);
 }
 
 void PajeSimulator::pajeAddVariable (PajeTraceEvent *traceEvent)
 {
-  std::string time = traceEvent->valueForField (PAJE_Time);
-  std::string typestr = traceEvent->valueForField (PAJE_Type);
-  std::string containerstr = traceEvent->valueForField (PAJE_Container);
-  std::string value = traceEvent->valueForField (PAJE_Value);
+  paje_symbol typestr = symbols.intern (traceEvent->keyForField (PAJE_Type));
+  paje_symbol containerstr = symbols.intern (traceEvent->keyForField (PAJE_Container));
 
   //search the container
-  PajeContainer *container = contMap[containerstr];
+  PajeContainer *container = contMap.find (containerstr);
   if (!container){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown container '"+containerstr+"' in "+line.str());
+    throw PajeContainerException ("Unknown container '"+symbols.name (containerstr)+"' in "+line.str());
   }
 
   //search the type
-  PajeType *type = typeMap[typestr];
+  PajeType *type = typeMap.find (typestr);
   if (!type){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeTypeException ("Unknown type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Unknown type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   //verify if the type is a variable type
@@ -872,32 +935,34 @@ void PajeSimulator::pajeAddVariable (PajeTraceEvent *traceEvent)
     throw PajeTypeException ("Type '"+ctype1.str()+"' is not child type of container type '"+ctype2.str()+"' in "+eventdesc.str());
   }
 
-  float v = strtof (value.c_str(), NULL);
+  double value;
+  if (!traceEvent->doubleValueForField (PAJE_Value, &value)){
+    value = 0;
+  }
+  float v = value;
   PajeAddVariableEvent event (traceEvent, container, type, v);
-  container->demuxer (&event);
+  dispatch (&event);
 }
 
 void PajeSimulator::pajeSubVariable (PajeTraceEvent *traceEvent)
 {
-  std::string time = traceEvent->valueForField (PAJE_Time);
-  std::string typestr = traceEvent->valueForField (PAJE_Type);
-  std::string containerstr = traceEvent->valueForField (PAJE_Container);
-  std::string value = traceEvent->valueForField (PAJE_Value);
+  paje_symbol typestr = symbols.intern (traceEvent->keyForField (PAJE_Type));
+  paje_symbol containerstr = symbols.intern (traceEvent->keyForField (PAJE_Container));
 
   //search the container
-  PajeContainer *container = contMap[containerstr];
+  PajeContainer *container = contMap.find (containerstr);
   if (!container){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown container '"+containerstr+"' in "+line.str());
+    throw PajeContainerException ("Unknown container '"+symbols.name (containerstr)+"' in "+line.str());
   }
 
   //search the type
-  PajeType *type = typeMap[typestr];
+  PajeType *type = typeMap.find (typestr);
   if (!type){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeTypeException ("Unknown type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Unknown type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   //verify if the type is a variable type
@@ -920,43 +985,46 @@ void PajeSimulator::pajeSubVariable (PajeTraceEvent *traceEvent)
     throw PajeTypeException ("Type '"+ctype1.str()+"' is not child type of container type '"+ctype2.str()+"' in "+eventdesc.str());
   }
 
-  float v = strtof (value.c_str(), NULL);
+  double value;
+  if (!traceEvent->doubleValueForField (PAJE_Value, &value)){
+    value = 0;
+  }
+  float v = value;
 
   PajeSubVariableEvent event (traceEvent, container, type, v);
-  container->demuxer (&event);
+  dispatch (&event);
 }
 
 void PajeSimulator::pajeStartLink (PajeTraceEvent *traceEvent)
 {
-  std::string time = traceEvent->valueForField (PAJE_Time);
-  std::string typestr = traceEvent->valueForField (PAJE_Type);
-  std::string containerstr = traceEvent->valueForField (PAJE_Container);
-  std::string startcontainerstr = traceEvent->valueForField (PAJE_StartContainer);
-  std::string value = traceEvent->valueForField (PAJE_Value);
+  paje_symbol typestr = symbols.intern (traceEvent->keyForField (PAJE_Type));
+  paje_symbol containerstr = symbols.intern (traceEvent->keyForField (PAJE_Container));
+  paje_symbol startcontainerstr = symbols.intern (traceEvent->keyForField (PAJE_StartContainer));
+  paje_string_key value = traceEvent->keyForField (PAJE_Value);
   std::string key = traceEvent->valueForField (PAJE_Key);
 
   //search the container
-  PajeContainer *container = contMap[containerstr];
+  PajeContainer *container = contMap.find (containerstr);
   if (!container){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown container '"+containerstr+"' in "+line.str());
+    throw PajeContainerException ("Unknown container '"+symbols.name (containerstr)+"' in "+line.str());
   }
 
   //search the start container
-  PajeContainer *startcontainer = contMap[startcontainerstr];
+  PajeContainer *startcontainer = contMap.find (startcontainerstr);
   if (!startcontainer){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown start container '"+startcontainerstr+"' in "+line.str());
+    throw PajeContainerException ("Unknown start container '"+symbols.name (startcontainerstr)+"' in "+line.str());
   }
 
   //search the type
-  PajeType *type = typeMap[typestr];
+  PajeType *type = typeMap.find (typestr);
   if (!type){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeTypeException ("Unknown type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Unknown type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   //verify if the type is a link type
@@ -987,52 +1055,50 @@ void PajeSimulator::pajeStartLink (PajeTraceEvent *traceEvent)
     ctype1 << *startcontainer->type();
     std::stringstream ctype2;
     ctype2 << *type;
-    throw PajeTypeException ("Type '"+ctype1.str()+"' of container '"+startcontainerstr+"' is not the container type expected for the start of link type '"+ctype2.str()+"' in "+eventdesc.str());
+    throw PajeTypeException ("Type '"+ctype1.str()+"' of container '"+symbols.name (startcontainerstr)+"' is not the container type expected for the start of link type '"+ctype2.str()+"' in "+eventdesc.str());
   }
 
   //check if the value was previously declared
-  PajeValue *val;
-  if (type->hasValueForIdentifier (value)){
-    val = type->valueForIdentifier (value);
-  }else{
-    val = type->addValue (value, value, NULL);
+  PajeValue *val = type->valueForKey (value);
+  if (!val){
+    std::string valuestr (value.str, value.length);
+    val = type->addValue (valuestr, valuestr, NULL);
   }
 
   PajeStartLinkEvent event (traceEvent, container, type, val, startcontainer, key);
-  container->demuxer (&event);
+  dispatch (&event);
 }
 
 void PajeSimulator::pajeEndLink (PajeTraceEvent *traceEvent)
 {
-  std::string time = traceEvent->valueForField (PAJE_Time);
-  std::string typestr = traceEvent->valueForField (PAJE_Type);
-  std::string containerstr = traceEvent->valueForField (PAJE_Container);
-  std::string endcontainerstr = traceEvent->valueForField (PAJE_EndContainer);
-  std::string value = traceEvent->valueForField (PAJE_Value);
+  paje_symbol typestr = symbols.intern (traceEvent->keyForField (PAJE_Type));
+  paje_symbol containerstr = symbols.intern (traceEvent->keyForField (PAJE_Container));
+  paje_symbol endcontainerstr = symbols.intern (traceEvent->keyForField (PAJE_EndContainer));
+  paje_string_key value = traceEvent->keyForField (PAJE_Value);
   std::string key = traceEvent->valueForField (PAJE_Key);
 
   //search the container
-  PajeContainer *container = contMap[containerstr];
+  PajeContainer *container = contMap.find (containerstr);
   if (!container){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown container '"+containerstr+"' in "+line.str());
+    throw PajeContainerException ("Unknown container '"+symbols.name (containerstr)+"' in "+line.str());
   }
 
   //search the end container
-  PajeContainer *endcontainer = contMap[endcontainerstr];
+  PajeContainer *endcontainer = contMap.find (endcontainerstr);
   if (!endcontainer){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeContainerException ("Unknown end container '"+endcontainerstr+"' in "+line.str());
+    throw PajeContainerException ("Unknown end container '"+symbols.name (endcontainerstr)+"' in "+line.str());
   }
 
   //search the type
-  PajeType *type = typeMap[typestr];
+  PajeType *type = typeMap.find (typestr);
   if (!type){
     std::stringstream line;
     line << *traceEvent;
-    throw PajeTypeException ("Unknown type '"+typestr+"' in "+line.str());
+    throw PajeTypeException ("Unknown type '"+symbols.name (typestr)+"' in "+line.str());
   }
 
   //verify if the type is a link type
@@ -1063,24 +1129,220 @@ void PajeSimulator::pajeEndLink (PajeTraceEvent *traceEvent)
     ctype1 << *endcontainer->type();
     std::stringstream ctype2;
     ctype2 << *type;
-    throw PajeTypeException ("Type '"+ctype1.str()+"' of container '"+endcontainerstr+"' is not the container type expected for the end of link type '"+ctype2.str()+"' in "+eventdesc.str());
+    throw PajeTypeException ("Type '"+ctype1.str()+"' of container '"+symbols.name (endcontainerstr)+"' is not the container type expected for the end of link type '"+ctype2.str()+"' in "+eventdesc.str());
   }
 
   //check if the value was previously declared
-  PajeValue *val = NULL;
-  if (type->hasValueForIdentifier (value)){
-    val = type->valueForIdentifier (value);
-  }else{
-    val = type->addValue (value, value, NULL);
+  PajeValue *val = type->valueForKey (value);
+  if (!val){
+    std::string valuestr (value.str, value.length);
+    val = type->addValue (valuestr, valuestr, NULL);
   }
 
   PajeEndLinkEvent event (traceEvent, container, type, val, endcontainer, key);
-  container->demuxer (&event);
+  dispatch (&event);
+}
+
+//canonical name of a file, used to detect trace files including themselves
+static std::string canonicalTraceFileName (const std::string &filename)
+{
+  char resolved[PATH_MAX];
+  if (realpath (filename.c_str(), resolved) == NULL){
+    return filename;
+  }
+  return std::string (resolved);
 }
 
+static std::string traceFileDirectoryOf (const std::string &filename)
+{
+  size_t slash = filename.rfind ('/');
+  if (slash == std::string::npos){
+    return std::string ();
+  }
+  return filename.substr (0, slash + 1);
+}
+
+/*
+ * pajeTraceFile: the events of the container are in another file,
+ * whose name is relative to the directory of the trace that refers to
+ * it. The file starts to be read and decoded on a thread of its own
+ * right away. Its events are simulated after the consecutive
+ * PajeTraceFile events of the current trace, so all of them are
+ * decoded in parallel. Each file is simulated in full, one after the
+ * other, in the order they appear.
+ */
 void PajeSimulator::pajeTraceFile (PajeTraceEvent *traceEvent)
 {
-  std::string containerstr = traceEvent->valueForField (PAJE_Container);
-  std::string typestr = traceEvent->valueForField (PAJE_Type);
+  paje_symbol containerstr = symbols.intern (traceEvent->keyForField (PAJE_Container));
+  paje_symbol typestr = symbols.intern (traceEvent->keyForField (PAJE_Type));
   std::string filename = traceEvent->valueForField (PAJE_Filename);
+
+  //search the container
+  PajeContainer *container = contMap.find (containerstr);
+  if (!container){
+    std::stringstream line;
+    line << *traceEvent;
+    throw PajeContainerException ("Unknown container '"+symbols.name (containerstr)+"' in "+line.str());
+  }
+
+  //search the type, it should be the type of the container
+  PajeType *type = typeMap.find (typestr);
+  if (!type){
+    std::stringstream line;
+    line << *traceEvent;
+    throw PajeTypeException ("Unknown type '"+symbols.name (typestr)+"' in "+line.str());
+  }
+  if (type != container->type()){
+    std::stringstream line;
+    line << *traceEvent;
+    std::stringstream desc;
+    desc << *container;
+    throw PajeTypeException ("Type '"+symbols.name (typestr)+"' is not the type of container '"+desc.str()+"' in "+line.str());
+  }
+
+  if (!filename.empty() && filename[0] != '/'){
+    filename = traceFileDirectory + filename;
+  }
+  std::string canonical = canonicalTraceFileName (filename);
+  for (unsigned int i = 0; i < traceFileStack.size(); i++){
+    if (traceFileStack[i] == canonical){
+      std::stringstream line;
+      line << *traceEvent;
+      throw PajeDecodeException ("Trace file '"+filename+"' refers to itself in "+line.str());
+    }
+  }
+
+  if (traceFileDefinitions == NULL){
+    traceFileDefinitions = new PajeDefinitions (false);
+    ownTraceFileDefinitions = true;
+  }
+
+  //a file without header uses the event definitions of this trace
+  paje_definition_table inherited;
+  bool inherit = false;
+  if (currentTraceFile){
+    inherit = currentTraceFile->takeTraceFileDefinitions (&inherited);
+  }else if (traceFileDecoder){
+    inherited = traceFileDecoder->definitions();
+    inherit = true;
+  }
+  int threads = traceFileDecoder ? traceFileDecoder->threadCount() : 1;
+  PajeTraceFile *traceFile = new PajeTraceFile (filename, traceFileDefinitions, inherit ? &inherited : NULL, threads);
+  pendingTraceFiles.push_back (traceFile);
+  traceFile->start ();
+}
+
+void PajeSimulator::simulateTraceFiles (void)
+{
+  std::vector<PajeTraceFile*> files;
+  files.swap (pendingTraceFiles);
+
+  //the trace ends with the last event of any of its files
+  double endTime = lastKnownTime;
+  std::string directory = traceFileDirectory;
+  PajeTraceFile *including = currentTraceFile;
+  size_t depth = traceFileStack.size();
+  unsigned int i = 0;
+  try {
+    for (i = 0; i < files.size(); i++){
+      PajeTraceFile *traceFile = files[i];
+      traceFileStack.push_back (canonicalTraceFileName (traceFile->name()));
+      traceFileDirectory = traceFileDirectoryOf (traceFile->name());
+      currentTraceFile = traceFile;
+      traceFile->setOutputComponent (this);
+      while (traceFile->hasMoreData() && keepSimulating()){
+        traceFile->readNextChunk ();
+      }
+      if (!pendingTraceFiles.empty()){
+        simulateTraceFiles ();
+      }
+      traceFileStack.pop_back ();
+      traceFileDirectory = directory;
+      currentTraceFile = including;
+      if (lastKnownTime > endTime){
+        endTime = lastKnownTime;
+      }
+      delete traceFile;
+    }
+  }catch (...){
+    for (; i < files.size(); i++){
+      delete files[i];
+    }
+    traceFileStack.resize (depth);
+    traceFileDirectory = directory;
+    currentTraceFile = including;
+    throw;
+  }
+  lastKnownTime = endTime;
+}
+
+/*
+ * setColumnar: containers keep their states, events and variables in
+ * columns, see PajeContainer::setColumnar. It should be called before
+ * the first container is created.
+ */
+void PajeSimulator::setColumnar (bool columnar)
+{
+  root->setColumnar (columnar);
+}
+
+/*
+ * setEntitySink: a streaming simulation, see
+ * PajeContainer::setEntitySink. It should be called before the first
+ * container is created. With simulation threads, the containers pass
+ * their entities to a PajeShardSink in front of sink.
+ */
+void PajeSimulator::setEntitySink (PajeEntitySink *sink)
+{
+  entitySink = sink;
+  delete shardSink;
+  shardSink = NULL;
+  if (sink && !shards.empty()){
+    shardSink = new PajeShardSink (sink);
+    root->setEntitySink (shardSink);
+  }else{
+    root->setEntitySink (sink);
+  }
+}
+
+/*
+ * setLinkKeyStrategy: how the containers remember the keys of the
+ * completed links, see PajeLinkKeys::strategyFor for spec. It should
+ * be called before the first container is created.
+ */
+void PajeSimulator::setLinkKeyStrategy (const std::string &spec)
+{
+  root->setLinkKeyStrategy (PajeLinkKeys::strategyFor (spec));
+}
+
+/*
+ * setTeardown: without teardown, the containers, entities and types
+ * are not released when the simulator is destroyed. It saves the time
+ * to free a large trace in tools that exit right after.
+ */
+void PajeSimulator::setTeardown (bool teardown)
+{
+  this->teardown = teardown;
+}
+
+/*
+ * setTraceFileContext: the name of the trace being simulated, so the
+ * files it refers to with PajeTraceFile are found next to it, the
+ * definitions to decode them and the decoder of the trace, whose event
+ * definitions are inherited by files without header. Without it,
+ * files are found from the current directory and must have a header.
+ */
+void PajeSimulator::setTraceFileContext (std::string filename, PajeDefinitions *definitions, PajeEventDecoder *decoder)
+{
+  if (ownTraceFileDefinitions){
+    delete traceFileDefinitions;
+    ownTraceFileDefinitions = false;
+  }
+  traceFileDefinitions = definitions;
+  traceFileDecoder = decoder;
+  traceFileStack.clear ();
+  if (!filename.empty()){
+    traceFileStack.push_back (canonicalTraceFileName (filename));
+  }
+  traceFileDirectory = traceFileDirectoryOf (filename);
 }
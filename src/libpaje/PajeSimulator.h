@@ -18,6 +18,7 @@
 #define __PAJESIMULATOR_H__
 #include <map>
 #include <vector>
+#include <deque>
 #include <sstream>
 #include <string>
 #include <iostream>
@@ -26,27 +27,155 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include "PajeTraceEvent.h"
 #include "PajeEvent.h"
 #include "PajeType.h"
 #include "PajeContainer.h"
 #include "PajeComponent.h"
+#include "PajeDefinitions.h"
+#include "PajeSymbolTable.h"
+#include "PajeException.h"
+
+class PajeTraceFile;
+class PajeSnapshot;
+class PajeEventDecoder;
 
 #define CALL_MEMBER_PAJE_SIMULATOR(object,ptr) ((object).*(ptr))
 
+//events handed to a simulation thread at once, and batches per thread
+#define PAJE_SIMULATOR_BATCH 512
+#define PAJE_SIMULATOR_BATCHES 8
+
+/*
+ * paje_simulation_item: an event to be simulated by the container it
+ * is addressed to, with a copy of its trace event. Sequence is the
+ * position of the event in the trace, to report errors in order.
+ */
+typedef struct {
+  PajeTraceEvent traceEvent;
+  PajeContainer *container;
+  PajeType *type;
+  PajeValue *value;
+  double doubleValue;
+  PajeContainer *linkedContainer;
+  std::string key;
+  long long sequence;
+} paje_simulation_item;
+
+typedef struct {
+  std::vector<paje_simulation_item> items;
+  size_t count;
+} paje_simulation_batch;
+
+/*
+ * paje_simulation_failure: the earliest event that failed in any of
+ * the simulation threads, -1 if none did, so that the others do not
+ * simulate the events after it.
+ */
+typedef struct {
+  pthread_mutex_t mutex;
+  long long sequence;
+} paje_simulation_failure;
+
+/*
+ * paje_finished_entity: an entity finished by a simulation thread, and
+ * the event that finished it; release tells whether the container is
+ * done with it once it is passed on.
+ */
+typedef struct {
+  long long sequence;
+  PajeEntity *entity;
+  bool release;
+} paje_finished_entity;
+
+/*
+ * paje_simulation_shard: a simulation thread, which simulates the
+ * events of the containers assigned to it in the order they arrive.
+ * Current is filled by the simulator without locking, the rest is
+ * protected by mutex. The first error of the thread is kept in error.
+ * The entities it finishes wait in finished, in the order of their
+ * events, until the simulator passes them on to the sink.
+ */
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t filled;
+  pthread_cond_t released;
+  std::vector<paje_simulation_batch*> pool;
+  std::deque<paje_simulation_batch*> freeBatches;
+  std::deque<paje_simulation_batch*> batches;
+  paje_simulation_batch *current;
+  bool busy;
+  bool stop;
+  bool failed;
+  long long errorSequence;
+  PajeException *error;
+  paje_simulation_failure *failure; //shared by the threads
+  long long sequence; //of the event being simulated
+  std::vector<paje_finished_entity> finished;
+} paje_simulation_shard;
+
+/*
+ * PajeShardSink: the sink of the containers when there are simulation
+ * threads. The entities finished by a thread are kept in its shard,
+ * the others are passed on to sink right away.
+ */
+class PajeShardSink : public PajeEntitySink {
+private:
+  PajeEntitySink *sink;
+
+public:
+  PajeShardSink (PajeEntitySink *sink);
+  void entityFinished (PajeEntity *entity);
+  void releaseEntity (PajeEntity *entity);
+};
+
 class PajeSimulator : public PajeComponent {
 private:
   PajeContainerType *rootType;
   PajeContainer *root;
-  std::map<std::string,PajeType*> typeMap;
-  std::map<std::string,PajeType*> typeNamesMap; //for names
-  std::map<std::string,PajeContainer*> contMap;
-  std::map<std::string,PajeContainer*> contNamesMap; //for names
+  PajeSymbolTable symbols; //identifiers and names of types and containers
+  PajeSymbolMap<PajeType> typeMap;
+  PajeSymbolMap<PajeType> typeNamesMap; //for names
+  PajeSymbolMap<PajeContainer> contMap;
+  PajeSymbolMap<PajeContainer> contNamesMap; //for names
 
 
   double stopSimulationAtTime;
+  bool teardown; //release the simulated trace when destroyed
+  bool restoring; //variable values of checkpoints are kept exact
+
+  //trace files referenced by PajeTraceFile events
+  PajeDefinitions *traceFileDefinitions;
+  bool ownTraceFileDefinitions;
+  PajeEventDecoder *traceFileDecoder; //of the main trace
+  PajeTraceFile *currentTraceFile; //being simulated, NULL for the main trace
+  std::string traceFileDirectory;
+  std::vector<std::string> traceFileStack; //files being simulated
+  std::vector<PajeTraceFile*> pendingTraceFiles;
+
+  //compaction policies by type name or alias, see addCompaction
+  std::map<std::string,paje_compaction> compactions;
+  std::vector<PajeType*> compactedTypes;
+
+  //containers sharded across simulation threads, empty when serial
+  std::vector<paje_simulation_shard*> shards;
+  paje_simulation_failure *failure;
+  long long sequence; //of the event being simulated
+  PajeEntitySink *entitySink;
+  PajeShardSink *shardSink; //in front of entitySink with threads
+  long long dispatched; //events since the last synchronize
 
   void init (void);
+  void simulateTraceFiles (void);
+  void dispatch (PajeEvent *event);
+  void submit (paje_simulation_shard *shard);
+  void synchronize (void);
+  void passFinished (long long last);
+  void stopShards (void);
+  void applyCompaction (PajeType *type);
+  void prepareCompaction (PajeType *type);
 
 private:
   //for time-slice selection (used by time aggregation)
@@ -70,6 +199,18 @@ public:
   void inputEntity (PajeObject *data);
   void startReading (void);
   void finishedReading (void);
+  void setTraceFileContext (std::string filename, PajeDefinitions *definitions, PajeEventDecoder *decoder);
+  void setSimulationThreads (int threads);
+  void setColumnar (bool columnar);
+  void setEntitySink (PajeEntitySink *sink);
+  void setLinkKeyStrategy (const std::string &spec);
+  void setTeardown (bool teardown);
+  void addCompaction (const std::string &spec);
+  void reportCompaction (void);
+  void writeCheckpoint (std::ostream &output);
+  void restoreCheckpoint (const std::string &checkpoint);
+  void writeSnapshot (std::string filename, std::string tracefilename, std::string settings);
+  void loadSnapshot (PajeSnapshot *snapshot);
 
 private:
   void (PajeSimulator::*invocation[PajeEventIdCount])(PajeTraceEvent*);
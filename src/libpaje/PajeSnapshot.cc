@@ -0,0 +1,462 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include "PajeSnapshot.h"
+#include "PajeType.h"
+#include "PajeException.h"
+
+PajeSnapshot::PajeSnapshot (std::string filename)
+{
+  this->filename = filename;
+  int fd = ::open (filename.c_str(), O_RDONLY);
+  if (fd == -1){
+    throw PajeFileReadException (filename);
+  }
+  struct stat st;
+  if (fstat (fd, &st) == -1){
+    close (fd);
+    throw PajeFileReadException (filename);
+  }
+  length = st.st_size;
+  if (length < sizeof (paje_snapshot_header)){
+    close (fd);
+    throw PajeSnapshotException (filename, "it is not a snapshot");
+  }
+  void *mapped = mmap (NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (mapped == MAP_FAILED){
+    throw PajeFileReadException (filename);
+  }
+  base = (char*)mapped;
+  header = (const paje_snapshot_header*)base;
+
+  try {
+    check ();
+  }catch (PajeException& e){
+    munmap (base, length);
+    throw;
+  }
+}
+
+PajeSnapshot::~PajeSnapshot (void)
+{
+  munmap (base, length);
+}
+
+//check: the header, and the sections are in the file
+void PajeSnapshot::check (void)
+{
+  if (memcmp (header->magic, PAJE_SNAPSHOT_MAGIC, PAJE_SNAPSHOT_MAGIC_LENGTH) != 0){
+    throw PajeSnapshotException (filename, "it is not a snapshot");
+  }
+  if (header->version != PAJE_SNAPSHOT_VERSION){
+    throw PajeSnapshotException (filename, "its version is not supported");
+  }
+  if (header->byteOrder != PAJE_SNAPSHOT_BYTE_ORDER){
+    throw PajeSnapshotException (filename, "it was written with another byte order");
+  }
+  for (int i = 0; i < PAJE_SNAPSHOT_SECTIONS; i++){
+    if (header->sections[i].offset % 8 || header->sections[i].offset > length){
+      throw PajeSnapshotException (filename, "it is truncated");
+    }
+  }
+  section (PAJE_SNAPSHOT_TYPES, sizeof (paje_snapshot_type));
+  section (PAJE_SNAPSHOT_VALUES, sizeof (paje_snapshot_value));
+  section (PAJE_SNAPSHOT_CONTAINERS, sizeof (paje_snapshot_container));
+  section (PAJE_SNAPSHOT_LINKS, sizeof (paje_snapshot_link));
+
+  uint64_t strings = count (PAJE_SNAPSHOT_STRINGS);
+  stringOffsets = (const uint64_t*)section (PAJE_SNAPSHOT_STRINGS, sizeof (uint64_t));
+  stringData = (const char*)(stringOffsets + strings + 1);
+  if ((uint64_t)(stringData - base) > length ||
+      stringOffsets[strings] > length - (stringData - base)){
+    throw PajeSnapshotException (filename, "it is truncated");
+  }
+
+  uint64_t extras = count (PAJE_SNAPSHOT_EXTRAS);
+  extraOffsets = (const uint64_t*)section (PAJE_SNAPSHOT_EXTRAS, sizeof (uint64_t));
+  extraData = (const uint32_t*)(extraOffsets + extras + 1);
+  if ((uint64_t)((char*)extraData - base) > length ||
+      extraOffsets[extras] > (length - ((char*)extraData - base)) / (2 * sizeof (uint32_t))){
+    throw PajeSnapshotException (filename, "it is truncated");
+  }
+  if (header->settings >= strings){
+    throw PajeSnapshotException (filename, "it is corrupted");
+  }
+}
+
+/*
+ * section: the records of section, checked to be in the file. The
+ * offsets of strings and extra fields have one more record.
+ */
+const char *PajeSnapshot::section (int section, size_t recordSize) const
+{
+  const paje_snapshot_section *s = &header->sections[section];
+  uint64_t records = s->count;
+  if (section == PAJE_SNAPSHOT_STRINGS || section == PAJE_SNAPSHOT_EXTRAS){
+    records++;
+  }
+  if (records > (length - s->offset) / recordSize){
+    throw PajeSnapshotException (filename, "it is truncated");
+  }
+  return base + s->offset;
+}
+
+//isSnapshot: true if filename starts like a snapshot
+bool PajeSnapshot::isSnapshot (std::string filename)
+{
+  char magic[PAJE_SNAPSHOT_MAGIC_LENGTH];
+  int fd = ::open (filename.c_str(), O_RDONLY);
+  if (fd == -1){
+    return false;
+  }
+  ssize_t n = read (fd, magic, PAJE_SNAPSHOT_MAGIC_LENGTH);
+  close (fd);
+  return n == PAJE_SNAPSHOT_MAGIC_LENGTH &&
+    memcmp (magic, PAJE_SNAPSHOT_MAGIC, PAJE_SNAPSHOT_MAGIC_LENGTH) == 0;
+}
+
+//traceStamp: the size and modification time a snapshot is bound to
+bool PajeSnapshot::traceStamp (std::string tracefilename, uint64_t *size, int64_t *modified)
+{
+  struct stat st;
+  if (stat (tracefilename.c_str(), &st) == -1){
+    return false;
+  }
+  *size = st.st_size;
+  *modified = st.st_mtime;
+  return true;
+}
+
+/*
+ * isSnapshotOf: true if the snapshot was written for the trace as it
+ * is now, simulated with the same settings.
+ */
+bool PajeSnapshot::isSnapshotOf (std::string tracefilename, std::string settings) const
+{
+  uint64_t size;
+  int64_t modified;
+  if (!traceStamp (tracefilename, &size, &modified)){
+    return false;
+  }
+  return size == header->traceSize && modified == header->traceModified &&
+    string (header->settings) == settings;
+}
+
+const std::string &PajeSnapshot::fileName (void) const
+{
+  return filename;
+}
+
+uint64_t PajeSnapshot::count (int section) const
+{
+  return header->sections[section].count;
+}
+
+//checkId: id, if it is a record of section or PAJE_SNAPSHOT_NONE
+uint32_t PajeSnapshot::checkId (uint32_t id, int section) const
+{
+  if (id != PAJE_SNAPSHOT_NONE && id >= count (section)){
+    throw PajeSnapshotException (filename, "it is corrupted");
+  }
+  return id;
+}
+
+std::string PajeSnapshot::string (uint32_t id) const
+{
+  if (checkId (id, PAJE_SNAPSHOT_STRINGS) == PAJE_SNAPSHOT_NONE){
+    return std::string();
+  }
+  if (stringOffsets[id] > stringOffsets[id + 1]){
+    throw PajeSnapshotException (filename, "it is corrupted");
+  }
+  return std::string (stringData + stringOffsets[id], stringOffsets[id + 1] - stringOffsets[id]);
+}
+
+//extraFields: the user-defined fields id, empty for PAJE_SNAPSHOT_NONE
+paje_extra_list PajeSnapshot::extraFields (uint32_t id) const
+{
+  paje_extra_list fields;
+  if (checkId (id, PAJE_SNAPSHOT_EXTRAS) == PAJE_SNAPSHOT_NONE){
+    return fields;
+  }
+  if (extraOffsets[id] >= extraOffsets[id + 1]){
+    throw PajeSnapshotException (filename, "it is corrupted");
+  }
+  for (uint64_t i = extraOffsets[id]; i < extraOffsets[id + 1]; i++){
+    fields.push_back (std::make_pair (string (extraData[2 * i]), string (extraData[2 * i + 1])));
+  }
+  return fields;
+}
+
+const paje_snapshot_type *PajeSnapshot::types (void) const
+{
+  return (const paje_snapshot_type*)(base + header->sections[PAJE_SNAPSHOT_TYPES].offset);
+}
+
+const paje_snapshot_value *PajeSnapshot::values (void) const
+{
+  return (const paje_snapshot_value*)(base + header->sections[PAJE_SNAPSHOT_VALUES].offset);
+}
+
+const paje_snapshot_container *PajeSnapshot::containers (void) const
+{
+  return (const paje_snapshot_container*)(base + header->sections[PAJE_SNAPSHOT_CONTAINERS].offset);
+}
+
+const paje_snapshot_link *PajeSnapshot::links (void) const
+{
+  return (const paje_snapshot_link*)(base + header->sections[PAJE_SNAPSHOT_LINKS].offset);
+}
+
+/*
+ * nextTimeline: the timeline at *position, the first one if it is
+ * NULL, and its columns in *columns. *position is moved past the
+ * columns. It is called count (PAJE_SNAPSHOT_TIMELINES) times.
+ */
+const paje_snapshot_timeline *PajeSnapshot::nextTimeline (const char **position, const char **columns) const
+{
+  if (!*position){
+    *position = base + header->sections[PAJE_SNAPSHOT_TIMELINES].offset;
+  }
+  uint64_t left = length - (*position - base);
+  if (left < sizeof (paje_snapshot_timeline)){
+    throw PajeSnapshotException (filename, "it is truncated");
+  }
+  const paje_snapshot_timeline *timeline = (const paje_snapshot_timeline*)*position;
+  left -= sizeof (paje_snapshot_timeline);
+  if (checkId (timeline->type, PAJE_SNAPSHOT_TYPES) == PAJE_SNAPSHOT_NONE ||
+      timeline->rows > left / sizeof (double) || timeline->values > left / sizeof (uint32_t) ||
+      timeline->indexWords > left / sizeof (uint32_t)){
+    throw PajeSnapshotException (filename, "it is corrupted");
+  }
+
+  uint32_t nature = types()[timeline->type].nature;
+  if (nature != PAJE_StateType && nature != PAJE_EventType && nature != PAJE_VariableType){
+    throw PajeSnapshotException (filename, "it is corrupted");
+  }
+
+  //the size of the columns, as in the format description
+  uint64_t rows = timeline->rows;
+  uint64_t size = paje_snapshot_align (timeline->values * sizeof (uint32_t));
+  size += rows * sizeof (double);
+  if (nature == PAJE_StateType || nature == PAJE_VariableType){
+    size += rows * sizeof (double);
+  }
+  if (nature == PAJE_StateType || nature == PAJE_EventType){
+    size += paje_snapshot_align (rows * sizeof (uint32_t));
+  }
+  if (nature == PAJE_StateType){
+    size += paje_snapshot_align (rows * sizeof (int32_t));
+  }
+  if (nature == PAJE_VariableType){
+    size += rows * sizeof (double);
+  }
+  if (timeline->hasExtra){
+    size += paje_snapshot_align (rows * sizeof (uint32_t));
+  }
+  size += paje_snapshot_align (timeline->indexWords * sizeof (uint32_t));
+  if (timeline->hasIntegral){
+    size += (rows + 1) * sizeof (double);
+  }
+  if (size > left){
+    throw PajeSnapshotException (filename, "it is truncated");
+  }
+  *columns = *position + sizeof (paje_snapshot_timeline);
+  *position = *columns + size;
+  return timeline;
+}
+
+PajeSnapshotWriter::PajeSnapshotWriter (std::string filename, std::string tracefilename, std::string settings)
+{
+  this->filename = filename;
+  temporary = filename + ".tmp";
+  position = 0;
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, PAJE_SNAPSHOT_MAGIC, PAJE_SNAPSHOT_MAGIC_LENGTH);
+  header.version = PAJE_SNAPSHOT_VERSION;
+  header.byteOrder = PAJE_SNAPSHOT_BYTE_ORDER;
+  if (!PajeSnapshot::traceStamp (tracefilename, &header.traceSize, &header.traceModified)){
+    throw PajeFileReadException (tracefilename);
+  }
+  header.settings = stringId (settings);
+
+  file = fopen (temporary.c_str(), "wb");
+  if (!file){
+    throw PajeFileWriteException (temporary);
+  }
+  //the header is written again by finish, with the sections
+  write (&header, sizeof (header));
+}
+
+//~PajeSnapshotWriter: an unfinished snapshot is removed
+PajeSnapshotWriter::~PajeSnapshotWriter (void)
+{
+  if (file){
+    fclose (file);
+    unlink (temporary.c_str());
+  }
+}
+
+void PajeSnapshotWriter::write (const void *data, size_t size)
+{
+  if (size && fwrite (data, 1, size, file) != size){
+    throw PajeFileWriteException (temporary);
+  }
+  position += size;
+}
+
+void PajeSnapshotWriter::align (void)
+{
+  static const char zeros[8] = { 0 };
+  write (zeros, paje_snapshot_align (position) - position);
+}
+
+void PajeSnapshotWriter::beginSection (int section)
+{
+  align ();
+  header.sections[section].offset = position;
+  header.sections[section].count = 0;
+}
+
+uint32_t PajeSnapshotWriter::stringId (const std::string &str)
+{
+  std::map<std::string,uint32_t>::iterator found = stringIds.find (str);
+  if (found != stringIds.end()){
+    return found->second;
+  }
+  uint32_t id = strings.size();
+  stringIds.insert (found, std::make_pair (str, id));
+  strings.push_back (str);
+  return id;
+}
+
+uint32_t PajeSnapshotWriter::extraId (const paje_extra_list &fields)
+{
+  if (fields.empty()){
+    return PAJE_SNAPSHOT_NONE;
+  }
+  std::vector<uint32_t> pairs;
+  for (size_t i = 0; i < fields.size(); i++){
+    pairs.push_back (stringId (fields[i].first));
+    pairs.push_back (stringId (fields[i].second));
+  }
+  std::map<std::vector<uint32_t>,uint32_t>::iterator found = extraIds.find (pairs);
+  if (found != extraIds.end()){
+    return found->second;
+  }
+  uint32_t id = extras.size();
+  extraIds.insert (found, std::make_pair (pairs, id));
+  extras.push_back (pairs);
+  return id;
+}
+
+void PajeSnapshotWriter::beginTimelines (void)
+{
+  beginSection (PAJE_SNAPSHOT_TIMELINES);
+}
+
+//writeTimeline: the record of a timeline, its columns follow
+void PajeSnapshotWriter::writeTimeline (const paje_snapshot_timeline &timeline)
+{
+  write (&timeline, sizeof (timeline));
+  header.sections[PAJE_SNAPSHOT_TIMELINES].count++;
+}
+
+void PajeSnapshotWriter::writeColumn (const void *data, size_t size)
+{
+  write (data, size);
+  align ();
+}
+
+void PajeSnapshotWriter::beginLinks (void)
+{
+  beginSection (PAJE_SNAPSHOT_LINKS);
+}
+
+void PajeSnapshotWriter::writeLink (const paje_snapshot_link &link)
+{
+  write (&link, sizeof (link));
+  header.sections[PAJE_SNAPSHOT_LINKS].count++;
+}
+
+/*
+ * finish: writes the records kept until now, the extra fields before
+ * the strings they add, and the header, then puts the snapshot in
+ * place of filename.
+ */
+void PajeSnapshotWriter::finish (void)
+{
+  beginSection (PAJE_SNAPSHOT_TYPES);
+  if (!types.empty()){
+    write (&types[0], types.size() * sizeof (paje_snapshot_type));
+  }
+  header.sections[PAJE_SNAPSHOT_TYPES].count = types.size();
+
+  beginSection (PAJE_SNAPSHOT_VALUES);
+  if (!values.empty()){
+    write (&values[0], values.size() * sizeof (paje_snapshot_value));
+  }
+  header.sections[PAJE_SNAPSHOT_VALUES].count = values.size();
+
+  beginSection (PAJE_SNAPSHOT_CONTAINERS);
+  if (!containers.empty()){
+    write (&containers[0], containers.size() * sizeof (paje_snapshot_container));
+  }
+  header.sections[PAJE_SNAPSHOT_CONTAINERS].count = containers.size();
+
+  std::vector<uint64_t> offsets (1, 0);
+  std::vector<uint32_t> pairs;
+  for (size_t i = 0; i < extras.size(); i++){
+    pairs.insert (pairs.end(), extras[i].begin(), extras[i].end());
+    offsets.push_back (pairs.size() / 2);
+  }
+  beginSection (PAJE_SNAPSHOT_EXTRAS);
+  write (&offsets[0], offsets.size() * sizeof (uint64_t));
+  if (!pairs.empty()){
+    write (&pairs[0], pairs.size() * sizeof (uint32_t));
+  }
+  header.sections[PAJE_SNAPSHOT_EXTRAS].count = extras.size();
+
+  offsets.assign (1, 0);
+  for (size_t i = 0; i < strings.size(); i++){
+    offsets.push_back (offsets.back() + strings[i].size());
+  }
+  beginSection (PAJE_SNAPSHOT_STRINGS);
+  write (&offsets[0], offsets.size() * sizeof (uint64_t));
+  for (size_t i = 0; i < strings.size(); i++){
+    write (strings[i].data(), strings[i].size());
+  }
+  header.sections[PAJE_SNAPSHOT_STRINGS].count = strings.size();
+  align ();
+
+  if (fseek (file, 0, SEEK_SET) != 0){
+    throw PajeFileWriteException (temporary);
+  }
+  write (&header, sizeof (header));
+  int closed = fclose (file);
+  file = NULL;
+  if (closed != 0 || rename (temporary.c_str(), filename.c_str()) != 0){
+    unlink (temporary.c_str());
+    throw PajeFileWriteException (filename);
+  }
+}
@@ -0,0 +1,227 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJESNAPSHOT_H__
+#define __PAJESNAPSHOT_H__
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdint.h>
+#include "PajeExtraFields.h"
+
+/*
+ * The snapshot of a finished simulation, written by
+ * PajeSimulator::writeSnapshot and loaded by
+ * PajeSimulator::loadSnapshot, so that the same trace is not simulated
+ * again. It is bound to the size and modification time of the trace
+ * file and to the settings of the simulation.
+ *
+ * The file is laid out to be mapped and read in place: a
+ * paje_snapshot_header, then sections of fixed size records and
+ * columns, all aligned to 8 bytes and in the byte order of the host
+ * that wrote them. Records refer to each other, and to strings, by
+ * their number in their section, PAJE_SNAPSHOT_NONE for none; the
+ * root type and the root container are number 0.
+ *
+ *  STRINGS:    count+1 offsets (uint64), then the characters
+ *  EXTRAS:     count+1 offsets (uint64), then the name and value
+ *              strings of the user-defined fields (uint32 pairs)
+ *  TYPES:      paje_snapshot_type, container types first, parents
+ *              before children
+ *  VALUES:     paje_snapshot_value
+ *  CONTAINERS: paje_snapshot_container, parents before children
+ *  TIMELINES:  paje_snapshot_timeline, each followed by its columns:
+ *              values (uint32), start (double), end (double, states
+ *              and variables), value (uint32, states and events),
+ *              imbrication (int32, states), doubleValue (double,
+ *              variables), extra (uint32, if any), the interval
+ *              index of the rows (uint32, see PajeIntervalIndex::words)
+ *              and the cumulative integral (double, rows+1, variables
+ *              that have one)
+ *  LINKS:      paje_snapshot_link
+ */
+#define PAJE_SNAPSHOT_MAGIC "PAJESNAP"
+#define PAJE_SNAPSHOT_MAGIC_LENGTH 8
+#define PAJE_SNAPSHOT_VERSION 2
+#define PAJE_SNAPSHOT_BYTE_ORDER 0x01020304
+#define PAJE_SNAPSHOT_NONE ((uint32_t)-1)
+
+enum {
+  PAJE_SNAPSHOT_STRINGS,
+  PAJE_SNAPSHOT_EXTRAS,
+  PAJE_SNAPSHOT_TYPES,
+  PAJE_SNAPSHOT_VALUES,
+  PAJE_SNAPSHOT_CONTAINERS,
+  PAJE_SNAPSHOT_TIMELINES,
+  PAJE_SNAPSHOT_LINKS,
+  PAJE_SNAPSHOT_SECTIONS
+};
+
+//sections and columns start at multiples of 8 bytes
+static inline uint64_t paje_snapshot_align (uint64_t size)
+{
+  return (size + 7) & ~(uint64_t)7;
+}
+
+typedef struct {
+  uint64_t offset;
+  uint64_t count;
+} paje_snapshot_section;
+
+typedef struct {
+  char magic[PAJE_SNAPSHOT_MAGIC_LENGTH];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t traceSize;
+  int64_t traceModified;
+  uint32_t settings;
+  uint32_t padding;
+  paje_snapshot_section sections[PAJE_SNAPSHOT_SECTIONS];
+} paje_snapshot_header;
+
+typedef struct {
+  uint32_t nature;
+  uint32_t parent;
+  uint32_t name;
+  uint32_t alias;
+  uint32_t startType;
+  uint32_t endType;
+  uint32_t hasColor;
+  uint32_t padding;
+  float color[4];
+} paje_snapshot_type;
+
+typedef struct {
+  uint32_t type;
+  uint32_t name;
+  uint32_t alias;
+  uint32_t hasColor;
+  float color[4];
+} paje_snapshot_value;
+
+typedef struct {
+  double start;
+  double end;
+  uint32_t parent;
+  uint32_t type;
+  uint32_t name;
+  uint32_t alias;
+  uint32_t extra;
+  uint32_t padding;
+} paje_snapshot_container;
+
+typedef struct {
+  uint64_t rows;
+  uint32_t container;
+  uint32_t type;
+  uint32_t values;
+  uint32_t hasExtra;
+  uint64_t indexWords;
+  uint32_t hasIntegral;
+  uint32_t padding;
+} paje_snapshot_timeline;
+
+typedef struct {
+  double start;
+  double end;
+  uint32_t container;
+  uint32_t type;
+  uint32_t value;
+  uint32_t startContainer;
+  uint32_t endContainer;
+  uint32_t key;
+  uint32_t extra;
+  uint32_t padding;
+} paje_snapshot_link;
+
+/*
+ * PajeSnapshot: a snapshot file, mapped read-only. The sections are
+ * checked to lie in the file when it is opened, timelines when they
+ * are walked with nextTimeline.
+ */
+class PajeSnapshot {
+private:
+  std::string filename;
+  char *base;
+  size_t length;
+  const paje_snapshot_header *header;
+  const uint64_t *stringOffsets;
+  const char *stringData;
+  const uint64_t *extraOffsets;
+  const uint32_t *extraData;
+
+  void check (void);
+  const char *section (int section, size_t recordSize) const;
+
+public:
+  PajeSnapshot (std::string filename);
+  ~PajeSnapshot (void);
+  static bool isSnapshot (std::string filename);
+  static bool traceStamp (std::string tracefilename, uint64_t *size, int64_t *modified);
+  bool isSnapshotOf (std::string tracefilename, std::string settings) const;
+  const std::string &fileName (void) const;
+  uint64_t count (int section) const;
+  uint32_t checkId (uint32_t id, int section) const;
+  std::string string (uint32_t id) const;
+  paje_extra_list extraFields (uint32_t id) const;
+  const paje_snapshot_type *types (void) const;
+  const paje_snapshot_value *values (void) const;
+  const paje_snapshot_container *containers (void) const;
+  const paje_snapshot_link *links (void) const;
+  const paje_snapshot_timeline *nextTimeline (const char **position, const char **columns) const;
+};
+
+/*
+ * PajeSnapshotWriter: writes a snapshot to a temporary file, which
+ * replaces filename when finish is called. Timelines and links are
+ * written as they are given; strings, extra fields and the other
+ * records are kept until finish.
+ */
+class PajeSnapshotWriter {
+private:
+  std::string filename;
+  std::string temporary;
+  FILE *file;
+  uint64_t position;
+  paje_snapshot_header header;
+  std::map<std::string,uint32_t> stringIds;
+  std::vector<std::string> strings;
+  std::map<std::vector<uint32_t>,uint32_t> extraIds;
+  std::vector<std::vector<uint32_t> > extras; //the name and value string ids of each field
+
+  void write (const void *data, size_t size);
+  void align (void);
+  void beginSection (int section);
+
+public:
+  std::vector<paje_snapshot_type> types;
+  std::vector<paje_snapshot_value> values;
+  std::vector<paje_snapshot_container> containers;
+
+  PajeSnapshotWriter (std::string filename, std::string tracefilename, std::string settings);
+  ~PajeSnapshotWriter (void);
+  uint32_t stringId (const std::string &str);
+  uint32_t extraId (const paje_extra_list &fields);
+  void beginTimelines (void);
+  void writeTimeline (const paje_snapshot_timeline &timeline);
+  void writeColumn (const void *data, size_t size);
+  void beginLinks (void);
+  void writeLink (const paje_snapshot_link &link);
+  void finish (void);
+};
+
+#endif
@@ -0,0 +1,113 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include "PajeSymbolTable.h"
+
+//FNV-1a
+unsigned int PajeSymbolTable::hash (const char *str, size_t length)
+{
+  unsigned int hash = 2166136261u;
+  for (size_t i = 0; i < length; i++){
+    hash ^= (unsigned char)str[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+paje_string_key PajeSymbolTable::key (const std::string &str)
+{
+  paje_string_key key;
+  key.str = str.data();
+  key.length = str.length();
+  key.hash = hash (key.str, key.length);
+  return key;
+}
+
+//slotOf: the slot of key, or the free slot where it should go
+size_t PajeSymbolTable::slotOf (const paje_string_key &key) const
+{
+  size_t mask = slots.size() - 1;
+  for (size_t i = key.hash & mask; ; i = (i + 1) & mask){
+    const paje_symbol_slot &slot = slots[i];
+    if (slot.symbol == PAJE_NO_SYMBOL) return i;
+    if (slot.hash == key.hash){
+      const std::string &name = names[slot.symbol];
+      if (name.length() == key.length && memcmp (name.data(), key.str, key.length) == 0){
+        return i;
+      }
+    }
+  }
+}
+
+void PajeSymbolTable::grow (void)
+{
+  std::vector<paje_symbol_slot> old;
+  old.swap (slots);
+  paje_symbol_slot empty = { 0, PAJE_NO_SYMBOL };
+  slots.assign (old.empty() ? 64 : old.size() * 2, empty);
+  size_t mask = slots.size() - 1;
+  for (size_t i = 0; i < old.size(); i++){
+    if (old[i].symbol == PAJE_NO_SYMBOL) continue;
+    size_t j = old[i].hash & mask;
+    while (slots[j].symbol != PAJE_NO_SYMBOL) j = (j + 1) & mask;
+    slots[j] = old[i];
+  }
+}
+
+paje_symbol PajeSymbolTable::intern (const paje_string_key &key)
+{
+  if ((names.size() + 1) * 2 > slots.size()){
+    grow ();
+  }
+  paje_symbol_slot &slot = slots[slotOf (key)];
+  if (slot.symbol == PAJE_NO_SYMBOL){
+    slot.hash = key.hash;
+    slot.symbol = names.size();
+    names.push_back (std::string (key.str, key.length));
+  }
+  return slot.symbol;
+}
+
+paje_symbol PajeSymbolTable::intern (const std::string &str)
+{
+  return intern (key (str));
+}
+
+/*
+ * find: the symbol of key, or PAJE_NO_SYMBOL when it was never
+ * interned, in which case nothing can be registered under it.
+ */
+paje_symbol PajeSymbolTable::find (const paje_string_key &key) const
+{
+  if (slots.empty()) return PAJE_NO_SYMBOL;
+  return slots[slotOf (key)].symbol;
+}
+
+paje_symbol PajeSymbolTable::find (const std::string &str) const
+{
+  return find (key (str));
+}
+
+const std::string &PajeSymbolTable::name (paje_symbol symbol) const
+{
+  return names[symbol];
+}
+
+size_t PajeSymbolTable::size (void) const
+{
+  return names.size();
+}
@@ -0,0 +1,150 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJESYMBOLTABLE_H__
+#define __PAJESYMBOLTABLE_H__
+#include <string>
+#include <vector>
+#include <deque>
+#include <stddef.h>
+
+/*
+ * paje_symbol: a string interned in a symbol table. Equal strings
+ * get the same symbol from the same table, so the simulator resolves
+ * containers, types and values by comparing integers.
+ */
+typedef unsigned int paje_symbol;
+
+#define PAJE_NO_SYMBOL ((paje_symbol)-1)
+
+/*
+ * paje_string_key: a string, not terminated, with its hash as
+ * PajeSymbolTable::hash computes it.
+ */
+typedef struct {
+  const char *str;
+  size_t length;
+  unsigned int hash;
+} paje_string_key;
+
+typedef struct {
+  unsigned int hash;
+  paje_symbol symbol;
+} paje_symbol_slot;
+
+/*
+ * PajeSymbolTable: symbols are numbered from 0 in the order their
+ * strings are first interned. A table belongs to the object that
+ * resolves names through it (the simulator for containers and types,
+ * each type for its values) and is released with it. It is not
+ * locked: other threads only hash the strings, see
+ * PajeTraceEvent::convertFields. Names never move.
+ */
+class PajeSymbolTable {
+private:
+  std::vector<paje_symbol_slot> slots;
+  std::deque<std::string> names;
+
+  size_t slotOf (const paje_string_key &key) const;
+  void grow (void);
+
+public:
+  static unsigned int hash (const char *str, size_t length);
+  static paje_string_key key (const std::string &str);
+  paje_symbol intern (const paje_string_key &key);
+  paje_symbol intern (const std::string &str);
+  paje_symbol find (const paje_string_key &key) const;
+  paje_symbol find (const std::string &str) const;
+  const std::string &name (paje_symbol symbol) const;
+  size_t size (void) const;
+};
+
+/*
+ * PajeSymbolMap: an open addressing hash table from symbols to
+ * objects. Looking up a symbol that was never inserted returns NULL,
+ * it does not insert anything.
+ */
+template <class T>
+class PajeSymbolMap {
+private:
+  typedef struct {
+    paje_symbol key;
+    T *value;
+  } paje_symbol_map_slot;
+
+  std::vector<paje_symbol_map_slot> slots;
+  size_t count;
+
+  static size_t hash (paje_symbol symbol)
+  {
+    return symbol * 2654435761u;
+  }
+
+  void grow (void)
+  {
+    std::vector<paje_symbol_map_slot> old;
+    old.swap (slots);
+    paje_symbol_map_slot empty = { PAJE_NO_SYMBOL, NULL };
+    slots.assign (old.empty() ? 16 : old.size() * 2, empty);
+    count = 0;
+    for (size_t i = 0; i < old.size(); i++){
+      if (old[i].key != PAJE_NO_SYMBOL){
+        insert (old[i].key, old[i].value);
+      }
+    }
+  }
+
+public:
+  PajeSymbolMap (void) : count (0) {}
+
+  T *find (paje_symbol symbol) const
+  {
+    if (slots.empty() || symbol == PAJE_NO_SYMBOL) return NULL;
+    size_t mask = slots.size() - 1;
+    for (size_t i = hash (symbol) & mask; ; i = (i + 1) & mask){
+      if (slots[i].key == symbol) return slots[i].value;
+      if (slots[i].key == PAJE_NO_SYMBOL) return NULL;
+    }
+  }
+
+  void insert (paje_symbol symbol, T *value)
+  {
+    if ((count + 1) * 2 > slots.size()) grow ();
+    size_t mask = slots.size() - 1;
+    size_t i = hash (symbol) & mask;
+    while (slots[i].key != PAJE_NO_SYMBOL && slots[i].key != symbol){
+      i = (i + 1) & mask;
+    }
+    if (slots[i].key == PAJE_NO_SYMBOL){
+      slots[i].key = symbol;
+      count++;
+    }
+    slots[i].value = value;
+  }
+
+  size_t size (void) const
+  {
+    return count;
+  }
+
+  void clear (void)
+  {
+    slots.clear ();
+    count = 0;
+  }
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include "PajeTimeline.h"
+#include "PajeEntity.h"
+
+PajeTimeline::PajeTimeline (PajeContainer *container, PajeType *type)
+{
+  _container = container;
+  _type = type;
+  nature = type->nature();
+  lastExtra = PAJE_TIMELINE_NO_EXTRA;
+}
+
+size_t PajeTimeline::size (void) const
+{
+  return start.size();
+}
+
+/*
+ * append: adds an entity starting at time, with no end yet, and
+ * returns its row. The arguments the nature of the type has no
+ * column for are ignored.
+ */
+size_t PajeTimeline::append (double time, PajeValue *v, double d, int imbric, PajeTraceEvent *event)
+{
+  size_t row = start.size();
+  start.push_back (time);
+  switch (nature){
+  case PAJE_StateType:
+    end.push_back (-1);
+    imbrication.push_back (imbric);
+    //fall through
+  case PAJE_EventType: {
+    std::map<PajeValue*,unsigned int>::iterator found = valueIndex.find (v);
+    if (found == valueIndex.end()){
+      found = valueIndex.insert (found, std::make_pair (v, (unsigned int)values.size()));
+      values.push_back (v);
+    }
+    value.push_back (found->second);
+    break;
+  }
+  case PAJE_VariableType:
+    end.push_back (-1);
+    doubleValue.push_back (d);
+    break;
+  default:
+    break;
+  }
+
+  if (PajeExtraFields::hasFields (event)){
+    std::vector<unsigned int> record;
+    _type->extraFields()->collect (event, NULL, &record);
+    extra.resize (row, PAJE_TIMELINE_NO_EXTRA);
+    extra.push_back (addExtraRecord (&record[0]));
+  }else if (!extra.empty()){
+    extra.push_back (PAJE_TIMELINE_NO_EXTRA);
+  }
+  return row;
+}
+
+/*
+ * addExtraRecord: the position of a copy of record in extraRecords,
+ * the last record is reused when it is the same.
+ */
+unsigned int PajeTimeline::addExtraRecord (const unsigned int *record)
+{
+  size_t length = PajeExtraFields::length (record);
+  if (lastExtra != PAJE_TIMELINE_NO_EXTRA && lastExtra + length == extraRecords.size() &&
+      std::equal (record, record + length, extraRecords.begin() + lastExtra)){
+    return lastExtra;
+  }
+  lastExtra = extraRecords.size();
+  extraRecords.insert (extraRecords.end(), record, record + length);
+  return lastExtra;
+}
+
+//the record of the fields of row, NULL if it has none
+const unsigned int *PajeTimeline::extraRecord (size_t row) const
+{
+  if (row >= extra.size() || extra[row] == PAJE_TIMELINE_NO_EXTRA){
+    return NULL;
+  }
+  return &extraRecords[extra[row]];
+}
+
+double PajeTimeline::startTime (size_t row) const
+{
+  return start[row];
+}
+
+double PajeTimeline::endTime (size_t row) const
+{
+  return nature == PAJE_EventType ? start[row] : end[row];
+}
+
+void PajeTimeline::setEndTime (size_t row, double time)
+{
+  if (nature == PAJE_EventType){
+    start[row] = time;
+  }else{
+    end[row] = time;
+  }
+}
+
+PajeValue *PajeTimeline::valueAtIndex (size_t row) const
+{
+  return value.empty() ? NULL : values[value[row]];
+}
+
+//valueTable: the values of the timeline, by their number in the value column
+const std::vector<PajeValue*> &PajeTimeline::valueTable (void) const
+{
+  return values;
+}
+
+void PajeTimeline::setValueTable (const std::vector<PajeValue*> &table)
+{
+  values = table;
+  valueIndex.clear ();
+  for (unsigned int i = 0; i < values.size(); i++){
+    valueIndex[values[i]] = i;
+  }
+}
+
+//the first row that starts at or after time
+size_t PajeTimeline::lowerBound (double time) const
+{
+  return std::lower_bound (start.begin(), start.end(), time) - start.begin();
+}
+
+/*
+ * entityAtIndex: a new entity with the contents of row, owned by the
+ * caller. Changing it does not change the timeline.
+ */
+PajeEntity *PajeTimeline::entityAtIndex (size_t row) const
+{
+  PajeEntity *entity;
+  switch (nature){
+  case PAJE_StateType:
+    entity = new PajeUserState (_container, _type, start[row], valueAtIndex (row), imbrication[row], NULL);
+    entity->setEndTime (end[row]);
+    break;
+  case PAJE_EventType:
+    entity = new PajeUserEvent (_container, _type, start[row], valueAtIndex (row), NULL);
+    break;
+  case PAJE_VariableType:
+    entity = new PajeUserVariable (_container, _type, start[row], doubleValue[row], NULL);
+    entity->setEndTime (end[row]);
+    break;
+  default:
+    return NULL;
+  }
+  entity->setExtraFields (extraRecord (row));
+  return entity;
+}
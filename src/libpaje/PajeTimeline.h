@@ -0,0 +1,79 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJE_TIMELINE_H
+#define __PAJE_TIMELINE_H
+#include <map>
+#include <vector>
+#include <string>
+#include "PajeType.h"
+#include "PajeTraceEvent.h"
+
+class PajeContainer;
+class PajeEntity;
+
+#define PAJE_TIMELINE_NO_EXTRA ((unsigned int)-1)
+
+/*
+ * PajeTimeline: the states, events or variable values of one type in
+ * one container, kept in columns instead of one entity object each.
+ * States use start, end, value and imbrication, events only start and
+ * value (their end is their start, as for PajeUserEvent) and variables
+ * start, end and doubleValue. Values are numbered per timeline. The
+ * extra column is only filled once an entity has user-defined fields,
+ * it has the position in extraRecords of the record of the fields of
+ * each row (see PajeExtraFields); a row with the same fields as the
+ * row before shares its record. Entities are created on demand by
+ * entityAtIndex.
+ */
+class PajeTimeline {
+private:
+  PajeContainer *_container;
+  PajeType *_type;
+  PajeTypeNature nature;
+
+  std::vector<PajeValue*> values;
+  std::map<PajeValue*,unsigned int> valueIndex;
+  unsigned int lastExtra; //the last record added to extraRecords
+
+public:
+  std::vector<double> start;
+  std::vector<double> end;
+  std::vector<unsigned int> value;
+  std::vector<double> doubleValue;
+  std::vector<int> imbrication;
+  std::vector<unsigned int> extra;
+  std::vector<unsigned int> extraRecords;
+
+  //rows of the stacked states, for states
+  std::vector<size_t> stack;
+
+  PajeTimeline (PajeContainer *container, PajeType *type);
+  size_t size (void) const;
+  size_t append (double time, PajeValue *value, double doubleValue, int imbrication, PajeTraceEvent *event);
+  unsigned int addExtraRecord (const unsigned int *record);
+  const unsigned int *extraRecord (size_t row) const;
+  double startTime (size_t row) const;
+  double endTime (size_t row) const;
+  void setEndTime (size_t row, double time);
+  PajeValue *valueAtIndex (size_t row) const;
+  const std::vector<PajeValue*> &valueTable (void) const;
+  void setValueTable (const std::vector<PajeValue*> &values);
+  size_t lowerBound (double time) const;
+  PajeEntity *entityAtIndex (size_t row) const;
+};
+
+#endif
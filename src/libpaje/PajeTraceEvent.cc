@@ -15,6 +15,10 @@
     along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
 */
 #include "PajeTraceEvent.h"
+#include "PajeBinary.h"
+
+//a field whose value convertFields has to find from its text
+static const paje_field_value unconverted = { PAJE_string, 0, 0, 0, false, false };
 
 PajeTraceEvent::PajeTraceEvent ()
 {
@@ -32,21 +36,19 @@ PajeTraceEvent::PajeTraceEvent (int line)
  * PajeTraceEvent (PajeEventDefinition *, paje_line *): if this
  * constructor is used, the method addField shoult not be used, since
  * the initialization extracts all the information from the paje_line.
+ * The fields are not copied, see setFields.
  */
 PajeTraceEvent::PajeTraceEvent (PajeEventDefinition *def, paje_line *line)
 {
-  int i;
-  for (i = 0; i < line->word_count; i++){
-    addField (line->word[i]);
-  }
+  setFields (line);
   pajeEventDefinition = def;
   this->line = line->lineNumber;
   this->check (line);
+  this->convertFields ();
 }
 
 PajeTraceEvent::~PajeTraceEvent ()
 {
-  fields.clear();
 }
 
 PajeEventId PajeTraceEvent::pajeEventId (void)
@@ -56,13 +58,174 @@ PajeEventId PajeTraceEvent::pajeEventId (void)
 
 void PajeTraceEvent::addField (char *field)
 {
-  fields.push_back (std::string(field));
+  addField (field, strlen(field));
+}
+
+void PajeTraceEvent::addView (const char *data, size_t offset, size_t length)
+{
+  paje_field_view view;
+  view.data = data;
+  view.offset = offset;
+  view.length = length;
+  view.number = false;
+  fields.push_back (view);
+  values.push_back (unconverted);
+}
+
+/*
+ * addField: the field is copied into the storage of the event, which
+ * keeps its capacity across clear so a reused event stops allocating.
+ */
+void PajeTraceEvent::addField (const char *field, size_t length)
+{
+  size_t offset = storage.size();
+  storage.insert (storage.end(), field, field + length);
+  storage.push_back ('\0');
+  addView (NULL, offset, length);
+}
+
+void PajeTraceEvent::addField (const std::string &field)
+{
+  addField (field.c_str(), field.length());
+}
+
+/*
+ * addFieldView: the field is not copied, as with setFields, so it
+ * has to outlive the event. A hash, if the reader has one for it,
+ * saves convertFields from hashing the field again.
+ */
+void PajeTraceEvent::addFieldView (const char *field, size_t length)
+{
+  addView (field, 0, length);
+}
+
+void PajeTraceEvent::addFieldView (const char *field, size_t length, unsigned int hash)
+{
+  addView (field, 0, length);
+  values.back().hash = hash;
+  values.back().hashed = true;
+  values.back().converted = true;
+}
+
+/*
+ * addNumberField: a field holding mantissa/10^scale, given as a number
+ * rather than as text. Its value is the one strtod and strtoll find in
+ * its text, which is only written if the field is read as text.
+ */
+void PajeTraceEvent::addNumberField (long long mantissa, int scale)
+{
+  static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                   1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+  paje_field_view view;
+  view.data = NULL;
+  view.offset = 0;
+  view.length = PAJE_FIELD_UNFORMATTED;
+  view.number = true;
+  view.mantissa = mantissa;
+  view.scale = scale;
+
+  paje_field_value value = unconverted;
+  value.converted = true;
+  long long integer = mantissa;
+  for (int i = 0; i < scale; i++){
+    integer /= 10;
+  }
+  value.integer = integer;
+  //both are exact below 2^53, so the division rounds as strtod does
+  if (mantissa < (1ll << 53) && mantissa > -(1ll << 53)){
+    value.number = mantissa / powers[scale];
+  }else{
+    view.length = paje_number_format (mantissa, scale, view.text);
+    value.number = strtod (view.text, NULL);
+  }
+  fields.push_back (view);
+  values.push_back (value);
+}
+
+//field: the field at index, the text of a number field is written here
+const paje_field_view &PajeTraceEvent::field (unsigned int index) const
+{
+  paje_field_view &view = fields.at(index);
+  if (view.number && view.length == PAJE_FIELD_UNFORMATTED){
+    view.length = paje_number_format (view.mantissa, view.scale, view.text);
+  }
+  return view;
+}
+
+/*
+ * setFields: the fields become views of the words of line. Nothing is
+ * copied, so the event is only valid as long as the chunk the line
+ * comes from.
+ */
+void PajeTraceEvent::setFields (paje_line *line)
+{
+  fields.resize (line->word_count);
+  for (int i = 0; i < line->word_count; i++){
+    fields[i].data = line->word[i];
+    fields[i].offset = 0;
+    fields[i].length = line->length[i];
+    fields[i].number = false;
+  }
+  values.clear ();
+}
+
+/*
+ * assign: makes this event a copy of event that owns its fields, so
+ * it stays valid after the chunk event refers to is gone. The storage
+ * is reused, copying into the same event again does not allocate.
+ * Number fields are copied as numbers.
+ */
+void PajeTraceEvent::assign (const PajeTraceEvent *event)
+{
+  pajeEventDefinition = event->pajeEventDefinition;
+  line = event->line;
+  size_t size = 0;
+  for (unsigned int i = 0; i < event->fields.size(); i++){
+    if (!event->fields[i].number){
+      size += event->fields[i].length + 1;
+    }
+  }
+  fields.resize (event->fields.size());
+  storage.resize (size);
+  size_t offset = 0;
+  for (unsigned int i = 0; i < fields.size(); i++){
+    const paje_field_view &from = event->fields[i];
+    if (from.number){
+      fields[i] = from;
+      continue;
+    }
+    memcpy (&storage[offset], event->fieldData (from), from.length);
+    storage[offset + from.length] = '\0';
+    fields[i].data = NULL;
+    fields[i].offset = offset;
+    fields[i].length = from.length;
+    fields[i].number = false;
+    offset += from.length + 1;
+  }
+  values = event->values;
+}
+
+unsigned int PajeTraceEvent::fieldCount (void) const
+{
+  return fields.size();
+}
+
+const char *PajeTraceEvent::fieldAtIndex (unsigned int index) const
+{
+  return fieldData (field (index));
+}
+
+size_t PajeTraceEvent::fieldLengthAtIndex (unsigned int index) const
+{
+  return field (index).length;
 }
 
 void PajeTraceEvent::clear (void)
 {
   pajeEventDefinition = NULL;
   fields.clear();
+  storage.clear();
+  values.clear();
 }
 
 bool PajeTraceEvent::check (paje_line *line)
@@ -92,17 +255,149 @@ std::string PajeTraceEvent::valueForField (PajeField field)
   if (index == -1){
     return std::string("");
   }else{
-    return fields.at(index);
+    const paje_field_view &view = this->field (index);
+    return std::string (fieldData (view), view.length);
+  }
+}
+
+//isSymbolField: the fields that name containers, types and values
+bool PajeTraceEvent::isSymbolField (PajeField field)
+{
+  switch (field){
+  case PAJE_Name:
+  case PAJE_Alias:
+  case PAJE_Type:
+  case PAJE_Container:
+  case PAJE_StartContainerType:
+  case PAJE_EndContainerType:
+  case PAJE_StartContainer:
+  case PAJE_EndContainer:
+  case PAJE_Value:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/*
+ * convertFields: converts the fields to the types of the definition,
+ * so the simulator gets times and values without parsing them again.
+ * Numbers are parsed with strtod like atof and strtof did before. The
+ * string fields the simulator resolves are hashed here, so that it
+ * happens on the decoder workers when there are any. The fields a
+ * reader gave already converted only get their type.
+ */
+void PajeTraceEvent::convertFields (void)
+{
+  if (!pajeEventDefinition){
+    values.clear ();
+    return;
+  }
+  values.resize (fields.size(), unconverted);
+  std::list<PajeFieldType>::iterator it = pajeEventDefinition->types.begin();
+  std::list<PajeField>::iterator itf = pajeEventDefinition->fields.begin();
+  for (unsigned int i = 0; i < fields.size(); i++){
+    paje_field_value &value = values[i];
+    value.type = it != pajeEventDefinition->types.end() ? *it++ : PAJE_string;
+    PajeField field = itf != pajeEventDefinition->fields.end() ? *itf++ : PAJE_Extra;
+    if (value.converted) continue;
+    value.number = 0;
+    value.integer = 0;
+    value.hashed = false;
+    const char *str = fieldData (fields[i]);
+    switch (value.type){
+    case PAJE_int:
+      value.integer = strtoll (str, NULL, 10);
+      value.number = strtod (str, NULL);
+      break;
+    case PAJE_hex:
+      value.integer = strtoll (str, NULL, 16);
+      value.number = strtod (str, NULL);
+      break;
+    case PAJE_date:
+    case PAJE_double:
+    case PAJE_float:
+      value.number = strtod (str, NULL);
+      break;
+    case PAJE_string:
+      if (isSymbolField (field)){
+        value.hash = PajeSymbolTable::hash (str, fields[i].length);
+        value.hashed = true;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+/*
+ * doubleValueForField: false if the event has no such field or if it
+ * is empty. Fields that are not declared as numbers are parsed here.
+ */
+bool PajeTraceEvent::doubleValueForField (PajeField field, double *value)
+{
+  int index = pajeEventDefinition->indexForField (field);
+  if (index == -1 || index >= (int)fields.size() || (!fields[index].number && fields[index].length == 0)){
+    return false;
+  }
+  if (index < (int)values.size() && values[index].type != PAJE_string &&
+      values[index].type != PAJE_color && values[index].type != PAJE_unknown_field_type){
+    *value = values[index].number;
+  }else{
+    *value = strtod (fieldData (fields[index]), NULL);
+  }
+  return true;
+}
+
+bool PajeTraceEvent::intValueForField (PajeField field, long long *value)
+{
+  int index = pajeEventDefinition->indexForField (field);
+  if (index == -1 || index >= (int)fields.size() || (!fields[index].number && fields[index].length == 0)){
+    return false;
+  }
+  if (index < (int)values.size() && (values[index].type == PAJE_int || values[index].type == PAJE_hex)){
+    *value = values[index].integer;
+  }else{
+    *value = strtoll (fieldData (fields[index]), NULL, 10);
   }
+  return true;
 }
 
-std::string PajeTraceEvent::valueForExtraField (std::string fieldName)
+/*
+ * keyForField: the field, to be looked up in a PajeSymbolTable, valid
+ * as long as the event is. A missing field is the empty string, as it
+ * is for valueForField. Fields that were not hashed by convertFields
+ * are hashed here.
+ */
+paje_string_key PajeTraceEvent::keyForField (PajeField field)
+{
+  paje_string_key key;
+  int index = pajeEventDefinition->indexForField (field);
+  if (index == -1 || index >= (int)fields.size()){
+    key.str = "";
+    key.length = 0;
+  }else{
+    const paje_field_view &view = this->field (index);
+    key.str = fieldData (view);
+    key.length = view.length;
+    if (index < (int)values.size() && values[index].hashed){
+      key.hash = values[index].hash;
+      return key;
+    }
+  }
+  key.hash = PajeSymbolTable::hash (key.str, key.length);
+  return key;
+}
+
+std::string PajeTraceEvent::valueForExtraField (const std::string &fieldName)
 {
   int index = pajeEventDefinition->indexForExtraFieldNamed (fieldName);
   if (index == -1){
     return std::string("");
   }else{
-    return fields.at(index);
+    const paje_field_view &view = field (index);
+    return std::string (fieldData (view), view.length);
   }
 }
 
@@ -111,6 +406,11 @@ long long PajeTraceEvent::getLineNumber (void) const
   return line;
 }
 
+void PajeTraceEvent::setLineNumber (long long line)
+{
+  this->line = line;
+}
+
 std::string PajeTraceEvent::description (void) const
 {
   std::stringstream output;
@@ -119,7 +419,8 @@ std::string PajeTraceEvent::description (void) const
   output << ", Fields: '" << fields.size();
   output << ", Contents: '";
   for (i = 0; i < fields.size(); i++){
-    output << fields.at(i);
+    const paje_field_view &view = field (i);
+    output.write (fieldData (view), view.length);
     if (i+1 != fields.size()) output << " ";
   }
   output << "')";
@@ -26,12 +26,63 @@
 #include <string.h>
 #include "PajeEventDefinition.h"
 #include "PajeObject.h"
+#include "PajeSymbolTable.h"
+
+/*
+ * paje_field_value: a field converted once, according to the type it
+ * has in the event definition. Number is set for the numeric types
+ * (date, double, float, int and hex), integer for int and hex. The
+ * fields naming containers, types and values get their hash, see
+ * keyForField. Converted is set for the fields given already typed by a reader,
+ * convertFields leaves their values as they are.
+ */
+typedef struct {
+  PajeFieldType type;
+  double number;
+  long long integer;
+  unsigned int hash;
+  bool hashed;
+  bool converted;
+} paje_field_value;
+
+//the length of a number field whose text was not written yet
+#define PAJE_FIELD_UNFORMATTED ((size_t)-1)
+
+/*
+ * paje_field_view: a field of a trace event, length bytes long. Data
+ * points into the chunk the line was read from, where the field is
+ * not terminated, or is NULL when the field was copied into the
+ * storage of the event, at offset, followed by a '\0'. A field in a
+ * chunk always ends at a blank, a quote, a '#' or the end of the
+ * line, which is where strtod and strtoll stop, so numbers are
+ * parsed in place. A number field (see addNumberField) has no text
+ * until it is asked for, it is then written to text.
+ */
+typedef struct {
+  const char *data;
+  size_t offset;
+  size_t length;
+  bool number;
+  long long mantissa;
+  int scale;
+  char text[24];
+} paje_field_view;
 
 class PajeTraceEvent : public PajeObject {
  private:
   int line;
   PajeEventDefinition *pajeEventDefinition;
-  std::vector<std::string> fields;
+  mutable std::vector<paje_field_view> fields; //number fields get their text on demand
+  std::vector<char> storage;
+  std::vector<paje_field_value> values;
+
+  const paje_field_view &field (unsigned int index) const;
+  const char *fieldData (const paje_field_view &field) const
+  {
+    if (field.number) return field.text;
+    return field.data ? field.data : &storage[field.offset];
+  }
+  void addView (const char *data, size_t offset, size_t length);
 
 public:
   PajeTraceEvent ();
@@ -40,11 +91,27 @@ public:
   ~PajeTraceEvent ();
   PajeEventId pajeEventId (void);
   void addField (char *field);
+  void addField (const char *field, size_t length);
+  void addField (const std::string &field);
+  void addFieldView (const char *field, size_t length);
+  void addFieldView (const char *field, size_t length, unsigned int hash);
+  void addNumberField (long long mantissa, int scale);
+  void setFields (paje_line *line);
+  void assign (const PajeTraceEvent *event);
+  unsigned int fieldCount (void) const;
+  const char *fieldAtIndex (unsigned int index) const;
+  size_t fieldLengthAtIndex (unsigned int index) const;
   void clear (void);
   bool check (paje_line *line);
+  void convertFields (void);
   std::string valueForField (PajeField field);
-  std::string valueForExtraField (std::string fieldName);
+  bool doubleValueForField (PajeField field, double *value);
+  bool intValueForField (PajeField field, long long *value);
+  paje_string_key keyForField (PajeField field);
+  std::string valueForExtraField (const std::string &fieldName);
+  static bool isSymbolField (PajeField field);
   long long getLineNumber (void) const;
+  void setLineNumber (long long line);
   std::string description (void) const;
   PajeEventDefinition *definition (void);
   void setDefinition (PajeEventDefinition *def);
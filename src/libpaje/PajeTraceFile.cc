@@ -0,0 +1,254 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "PajeTraceFile.h"
+#include "PajeException.h"
+#include "PajeFileReader.h"
+#include "PajeReadAheadReader.h"
+#include "PajeCompressedFileReader.h"
+#include "PajeBinaryReader.h"
+
+/*
+ * PajeTraceFile: inherited are the event definitions of the trace
+ * referring to this file, used if it has no header of its own. Binary
+ * traces always carry their definitions. Text traces are decoded with
+ * threads threads, see PajeEventDecoder.
+ */
+PajeTraceFile::PajeTraceFile (std::string filename, PajeDefinitions *definitions, const paje_definition_table *inherited, int threads)
+{
+  this->filename = filename;
+  decoder = NULL;
+  running = false;
+  current = NULL;
+  finished = false;
+  cancelled = false;
+
+  //the same readers PajeUnity picks for a trace file
+  bool binaryReader = false;
+  if (PajeReadAheadReader::isStream (filename)){
+    reader = new PajeReadAheadReader (filename);
+  }else if (PajeBinaryReader::isBinaryTrace (filename)){
+    reader = new PajeBinaryReader (filename, definitions);
+    binaryReader = true;
+  }else if (PajeCompressedFileReader::isCompressed (filename)){
+    reader = new PajeCompressedFileReader (filename);
+  }else{
+    reader = new PajeFileReader (filename, true);
+  }
+  if (binaryReader){
+    reader->setOutputComponent (this);
+    this->setInputComponent (reader);
+  }else{
+    decoder = new PajeEventDecoder (definitions, threads);
+    if (inherited){
+      decoder->inheritDefinitions (*inherited);
+    }
+    reader->setOutputComponent (decoder);
+    decoder->setInputComponent (reader);
+    decoder->setOutputComponent (this);
+    this->setInputComponent (decoder);
+  }
+
+  pthread_mutex_init (&mutex, NULL);
+  pthread_cond_init (&filled, NULL);
+  pthread_cond_init (&released, NULL);
+  for (int i = 0; i < PAJE_TRACE_FILE_BATCHES; i++){
+    paje_trace_file_batch *batch = new paje_trace_file_batch;
+    batch->events.resize (PAJE_TRACE_FILE_BATCH);
+    batch->count = 0;
+    pool.push_back (batch);
+    freeBatches.push_back (batch);
+  }
+}
+
+PajeTraceFile::~PajeTraceFile (void)
+{
+  if (running){
+    pthread_mutex_lock (&mutex);
+    cancelled = true;
+    pthread_cond_broadcast (&released);
+    pthread_mutex_unlock (&mutex);
+    pthread_join (thread, NULL);
+  }
+  for (unsigned int i = 0; i < pool.size(); i++){
+    delete pool[i];
+  }
+  pthread_cond_destroy (&released);
+  pthread_cond_destroy (&filled);
+  pthread_mutex_destroy (&mutex);
+  delete decoder;
+  delete reader;
+}
+
+const std::string &PajeTraceFile::name (void) const
+{
+  return filename;
+}
+
+void PajeTraceFile::start (void)
+{
+  if (pthread_create (&thread, NULL, PajeTraceFile::decode, this) != 0){
+    throw PajeDecodeException ("Could not create thread for trace file '"+filename+"'");
+  }
+  running = true;
+}
+
+void *PajeTraceFile::decode (void *traceFile)
+{
+  ((PajeTraceFile*)traceFile)->decodeLoop ();
+  return NULL;
+}
+
+void PajeTraceFile::decodeLoop (void)
+{
+  std::string message;
+  try {
+    reader->startReading ();
+    while (reader->hasMoreData()){
+      reader->readNextChunk ();
+      pthread_mutex_lock (&mutex);
+      bool stop = cancelled;
+      pthread_mutex_unlock (&mutex);
+      if (stop) break;
+    }
+    reader->finishedReading ();
+  }catch (PajeException &e){
+    message = e.reason ();
+  }
+
+  pthread_mutex_lock (&mutex);
+  if (current && current->count){
+    batches.push_back (current);
+    current = NULL;
+  }
+  error = message;
+  finished = true;
+  pthread_cond_broadcast (&filled);
+  pthread_mutex_unlock (&mutex);
+}
+
+//hands the batch being filled to the simulator, waits for a free one
+void PajeTraceFile::pushBatch (void)
+{
+  pthread_mutex_lock (&mutex);
+  if (current){
+    batches.push_back (current);
+    current = NULL;
+    pthread_cond_broadcast (&filled);
+  }
+  while (freeBatches.empty() && !cancelled){
+    pthread_cond_wait (&released, &mutex);
+  }
+  if (!cancelled){
+    current = freeBatches.front();
+    freeBatches.pop_front();
+    current->count = 0;
+  }
+  pthread_mutex_unlock (&mutex);
+}
+
+/*
+ * takeTraceFileDefinitions: the definitions of this file when its next
+ * PajeTraceFile event was decoded, for the file that event refers to.
+ */
+bool PajeTraceFile::takeTraceFileDefinitions (paje_definition_table *table)
+{
+  pthread_mutex_lock (&mutex);
+  bool found = !traceFileDefinitions.empty();
+  if (found){
+    *table = traceFileDefinitions.front();
+    traceFileDefinitions.pop_front();
+  }
+  pthread_mutex_unlock (&mutex);
+  return found;
+}
+
+void PajeTraceFile::inputEntity (PajeObject *data)
+{
+  PajeTraceEvent *event = (PajeTraceEvent*)data;
+  //the decoder may change its definitions before the event is simulated
+  if (decoder && event->pajeEventId() == PajeTraceFileEventId){
+    pthread_mutex_lock (&mutex);
+    traceFileDefinitions.push_back (decoder->definitions());
+    pthread_mutex_unlock (&mutex);
+  }
+  if (current == NULL || current->count == current->events.size()){
+    pushBatch ();
+    if (current == NULL){
+      return; //cancelled
+    }
+  }
+  current->events[current->count++].assign (event);
+}
+
+void PajeTraceFile::startReading (void)
+{
+}
+
+void PajeTraceFile::finishedReading (void)
+{
+}
+
+bool PajeTraceFile::hasMoreData (void)
+{
+  pthread_mutex_lock (&mutex);
+  while (batches.empty() && !finished){
+    pthread_cond_wait (&filled, &mutex);
+  }
+  bool more = !batches.empty() || !error.empty();
+  pthread_mutex_unlock (&mutex);
+  return more;
+}
+
+void PajeTraceFile::readNextChunk (void)
+{
+  pthread_mutex_lock (&mutex);
+  while (batches.empty() && !finished){
+    pthread_cond_wait (&filled, &mutex);
+  }
+  paje_trace_file_batch *batch = NULL;
+  if (!batches.empty()){
+    batch = batches.front();
+    batches.pop_front();
+  }
+  std::string message = error;
+  pthread_mutex_unlock (&mutex);
+
+  //errors are reported once the events before them are simulated
+  if (batch == NULL){
+    if (!message.empty()){
+      throw PajeTraceFileException (filename, message);
+    }
+    return;
+  }
+
+  try {
+    for (size_t i = 0; i < batch->count; i++){
+      PajeComponent::outputEntity (&batch->events[i]);
+    }
+  }catch (...){
+    pthread_mutex_lock (&mutex);
+    freeBatches.push_back (batch);
+    pthread_cond_broadcast (&released);
+    pthread_mutex_unlock (&mutex);
+    throw;
+  }
+
+  pthread_mutex_lock (&mutex);
+  freeBatches.push_back (batch);
+  pthread_cond_broadcast (&released);
+  pthread_mutex_unlock (&mutex);
+}
@@ -0,0 +1,86 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJETRACEFILE_H__
+#define __PAJETRACEFILE_H__
+#include <deque>
+#include <vector>
+#include <string>
+#include <pthread.h>
+#include "PajeComponent.h"
+#include "PajeEventDecoder.h"
+#include "PajeTraceEvent.h"
+#include "PajeDefinitions.h"
+
+//events handed over at once, and batches each file may decode ahead
+#define PAJE_TRACE_FILE_BATCH 1024
+#define PAJE_TRACE_FILE_BATCHES 4
+
+typedef struct {
+  std::vector<PajeTraceEvent> events;
+  size_t count;
+} paje_trace_file_batch;
+
+/*
+ * PajeTraceFile: a trace file referenced by a PajeTraceFile event.
+ * Its own reader and decoder run on a thread of their own as soon as
+ * it is started, copying the events in a few pooled batches. The
+ * component is then read like any reader: readNextChunk hands the
+ * events of the next batch to the output component (the simulator),
+ * in the order of the file.
+ */
+class PajeTraceFile : public PajeComponent {
+private:
+  std::string filename;
+  PajeComponent *reader;
+  PajeEventDecoder *decoder;
+
+  pthread_t thread;
+  bool running;
+  pthread_mutex_t mutex;
+  pthread_cond_t filled;
+  pthread_cond_t released;
+  std::vector<paje_trace_file_batch*> pool;
+  std::deque<paje_trace_file_batch*> freeBatches;
+  std::deque<paje_trace_file_batch*> batches;
+  paje_trace_file_batch *current; //being filled by the thread
+  bool finished;
+  bool cancelled;
+  std::string error;
+  //definitions seen by the PajeTraceFile events of this file
+  std::deque<paje_definition_table> traceFileDefinitions;
+
+  static void *decode (void *traceFile);
+  void decodeLoop (void);
+  void pushBatch (void);
+
+public:
+  PajeTraceFile (std::string filename, PajeDefinitions *definitions, const paje_definition_table *inherited, int threads = 1);
+  ~PajeTraceFile (void);
+  const std::string &name (void) const;
+  void start (void);
+  bool takeTraceFileDefinitions (paje_definition_table *table);
+
+  //called by the decoding thread
+  void inputEntity (PajeObject *data);
+  void startReading (void);
+  void finishedReading (void);
+
+  //called by the simulator
+  bool hasMoreData (void);
+  void readNextChunk (void);
+};
+#endif
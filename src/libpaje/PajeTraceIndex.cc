@@ -0,0 +1,236 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <iomanip>
+#include <sstream>
+#include "PajeTraceIndex.h"
+#include "PajeSimulator.h"
+#include "PajeException.h"
+
+#define PAJE_INDEX_SCAN_BLOCK (1024*1024)
+
+PajeTraceIndex::PajeTraceIndex (std::string filename)
+{
+  this->filename = filename;
+  size = 0;
+  definitionsEnd = 0;
+
+  std::ifstream input (filename.c_str(), std::ios::binary);
+  if (input.fail()){
+    throw PajeFileReadException (filename);
+  }
+
+  std::string line;
+  int version = 0;
+  double interval;
+  if (!std::getline (input, line) ||
+      sscanf (line.c_str(), "%%PajeIndex %d %lf", &version, &interval) != 2){
+    throw PajeIndexException (filename, "it is not a trace index");
+  }
+  if (version != PAJE_INDEX_VERSION){
+    throw PajeIndexException (filename, "its version is not supported");
+  }
+
+  std::vector<paje_trace_checkpoint> all;
+  size_t offsets = 0;
+  while (std::getline (input, line)){
+    paje_trace_checkpoint checkpoint;
+    long long lineNumber;
+    unsigned long long offset;
+    if (sscanf (line.c_str(), "%%Checkpoint %lf %lld %zu", &checkpoint.time, &checkpoint.line, &checkpoint.length) == 3){
+      checkpoint.offset = 0;
+      checkpoint.position = input.tellg();
+      all.push_back (checkpoint);
+      input.seekg (checkpoint.length, std::ios::cur);
+    }else if (sscanf (line.c_str(), "%%Trace %llu %llu", &size, &definitionsEnd) == 2){
+      continue;
+    }else if (sscanf (line.c_str(), "%%Offset %lld %llu", &lineNumber, &offset) == 2){
+      while (offsets < all.size() && all[offsets].line != lineNumber) offsets++;
+      if (offsets == all.size()){
+        throw PajeIndexException (filename, "an offset has no checkpoint");
+      }
+      all[offsets].offset = offset;
+      checkpoints.push_back (all[offsets]);
+    }else{
+      throw PajeIndexException (filename, "the line '"+line+"' is invalid");
+    }
+  }
+  if (size == 0){
+    throw PajeIndexException (filename, "it is incomplete");
+  }
+}
+
+unsigned long long PajeTraceIndex::traceSize (void) const
+{
+  return size;
+}
+
+/*
+ * checkpointBefore: the last checkpoint taken before time, so the
+ * entities finished before it do not reach time. NULL if there is
+ * none.
+ */
+const paje_trace_checkpoint *PajeTraceIndex::checkpointBefore (double time) const
+{
+  const paje_trace_checkpoint *ret = NULL;
+  for (size_t i = 0; i < checkpoints.size() && checkpoints[i].time < time; i++){
+    ret = &checkpoints[i];
+  }
+  return ret;
+}
+
+std::string PajeTraceIndex::checkpoint (const paje_trace_checkpoint *checkpoint) const
+{
+  std::ifstream input (filename.c_str(), std::ios::binary);
+  std::string ret (checkpoint->length, '\0');
+  input.seekg (checkpoint->position);
+  input.read (&ret[0], checkpoint->length);
+  if ((size_t)input.gcount() != checkpoint->length){
+    throw PajeIndexException (filename, "a checkpoint is truncated");
+  }
+  return ret;
+}
+
+//definitions: the event definition lines of the trace
+std::string PajeTraceIndex::definitions (std::string tracefilename) const
+{
+  std::ifstream input (tracefilename.c_str(), std::ios::binary);
+  if (input.fail()){
+    throw PajeFileReadException (tracefilename);
+  }
+  std::string ret;
+  std::string line;
+  unsigned long long read = 0;
+  while (read < definitionsEnd && std::getline (input, line)){
+    read += line.length() + 1;
+    if (!line.empty() && line[0] == '%'){
+      ret += line;
+      ret += '\n';
+    }
+  }
+  return ret;
+}
+
+PajeTraceIndexer::PajeTraceIndexer (PajeSimulator *simulator, std::string tracefilename, std::string filename, double interval)
+{
+  this->simulator = simulator;
+  this->tracefilename = tracefilename;
+  this->filename = filename;
+  this->interval = interval;
+  next = 0;
+  latestTime = 0;
+  started = false;
+
+  output.open (filename.c_str(), std::ios::binary);
+  if (output.fail()){
+    throw PajeFileWriteException (filename);
+  }
+  output << "%PajeIndex " << PAJE_INDEX_VERSION << " "
+         << std::setprecision (17) << interval << "\n";
+}
+
+void PajeTraceIndexer::inputEntity (PajeObject *data)
+{
+  PajeTraceEvent *event = (PajeTraceEvent*)data;
+  double time;
+  if (event->doubleValueForField (PAJE_Time, &time)){
+    if (!started || time >= next){
+      if (started){
+        std::stringstream checkpoint;
+        simulator->writeCheckpoint (checkpoint);
+        std::string text = checkpoint.str();
+        output << "%Checkpoint " << std::setprecision (17) << latestTime << " "
+               << event->getLineNumber() << " " << text.length() << "\n" << text;
+        lines.push_back (event->getLineNumber());
+      }
+      next = (floor (time / interval) + 1) * interval;
+      started = true;
+    }
+    if (time > latestTime){
+      latestTime = time;
+    }
+  }
+  PajeComponent::outputEntity (data);
+}
+
+void PajeTraceIndexer::finishedReading (void)
+{
+  PajeComponent::finishedReading ();
+  writeOffsets ();
+  output.close ();
+  if (output.fail()){
+    throw PajeFileWriteException (filename);
+  }
+}
+
+/*
+ * writeOffsets: finds the offsets of the lines of the checkpoints, and
+ * the end of the last event definition line, in one more pass over the
+ * trace.
+ */
+void PajeTraceIndexer::writeOffsets (void)
+{
+  FILE *trace = fopen (tracefilename.c_str(), "rb");
+  if (!trace){
+    throw PajeFileReadException (tracefilename);
+  }
+
+  std::vector<unsigned long long> offsets;
+  std::vector<char> block (PAJE_INDEX_SCAN_BLOCK);
+  unsigned long long base = 0;
+  unsigned long long lineStart = 0;
+  unsigned long long definitionsEnd = 0;
+  long long line = 1;
+  long long definitionsLine = 0;
+  bool definition = false;
+  bool atLineStart = true;
+  size_t count;
+  while ((count = fread (&block[0], 1, block.size(), trace)) > 0){
+    char *current = &block[0];
+    char *end = current + count;
+    while (current < end){
+      if (atLineStart){
+        definition = *current == '%';
+        if (offsets.size() < lines.size() && lines[offsets.size()] == line){
+          offsets.push_back (lineStart);
+        }
+        atLineStart = false;
+      }
+      char *newline = (char*)memchr (current, '\n', end - current);
+      if (!newline) break;
+      current = newline + 1;
+      if (definition){
+        definitionsLine = line;
+        definitionsEnd = base + (current - &block[0]);
+      }
+      line++;
+      lineStart = base + (current - &block[0]);
+      atLineStart = true;
+    }
+    base += count;
+  }
+  fclose (trace);
+
+  output << "%Trace " << base << " " << definitionsEnd << "\n";
+  for (size_t i = 0; i < offsets.size(); i++){
+    if (lines[i] > definitionsLine){
+      output << "%Offset " << lines[i] << " " << offsets[i] << "\n";
+    }
+  }
+}
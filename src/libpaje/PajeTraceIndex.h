@@ -0,0 +1,95 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PAJETRACEINDEX_H__
+#define __PAJETRACEINDEX_H__
+#include <string>
+#include <vector>
+#include <fstream>
+#include "PajeComponent.h"
+
+class PajeSimulator;
+
+/*
+ * The index of a textual trace, written by PajeTraceIndexer (pj_index)
+ * and read by PajeTraceIndex. It is a text file:
+ *
+ *  %PajeIndex 1 INTERVAL
+ *  %Checkpoint TIME LINE LENGTH
+ *  LENGTH bytes of checkpoint
+ *  ...
+ *  %Trace SIZE DEFINITIONS
+ *  %Offset LINE OFFSET
+ *  ...
+ *
+ * A checkpoint is a Paje trace with its own header that rebuilds the
+ * state of the simulator before LINE of the trace: the types, values
+ * and containers, the stacked states, the current value of variables
+ * and the pending links. Everything before LINE happened up to TIME.
+ * SIZE is the size of the trace in bytes, DEFINITIONS the offset after
+ * its last event definition line, and OFFSET the offset of a LINE.
+ * Checkpoints before the last definition line have no offset.
+ */
+#define PAJE_INDEX_VERSION 1
+
+typedef struct {
+  double time;
+  long long line;
+  unsigned long long offset;
+  std::streamoff position; //of the checkpoint in the index
+  size_t length;
+} paje_trace_checkpoint;
+
+class PajeTraceIndex {
+private:
+  std::string filename;
+  unsigned long long size;
+  unsigned long long definitionsEnd;
+  std::vector<paje_trace_checkpoint> checkpoints;
+
+public:
+  PajeTraceIndex (std::string filename);
+  unsigned long long traceSize (void) const;
+  const paje_trace_checkpoint *checkpointBefore (double time) const;
+  std::string checkpoint (const paje_trace_checkpoint *checkpoint) const;
+  std::string definitions (std::string tracefilename) const;
+};
+
+/*
+ * PajeTraceIndexer: sits between the decoder and the simulator and
+ * writes a checkpoint of the simulator every interval seconds of trace
+ * time, before the first event past each interval.
+ */
+class PajeTraceIndexer : public PajeComponent {
+private:
+  PajeSimulator *simulator;
+  std::string tracefilename;
+  std::string filename;
+  std::ofstream output;
+  double interval;
+  double next;
+  double latestTime;
+  bool started;
+  std::vector<long long> lines; //of the checkpoints written
+
+  void writeOffsets (void);
+
+public:
+  PajeTraceIndexer (PajeSimulator *simulator, std::string tracefilename, std::string filename, double interval);
+  void inputEntity (PajeObject *data);
+  void finishedReading (void);
+};
+#endif
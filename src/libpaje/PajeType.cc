@@ -22,6 +22,7 @@ PajeType::PajeType (std::string name, std::string alias, PajeType *parent)
   _name = name;
   _alias = alias;
   _parent = parent;
+  _compaction = NULL;
   if (parent){
     _depth = parent->depth() + 1;
   }else{
@@ -31,6 +32,7 @@ PajeType::PajeType (std::string name, std::string alias, PajeType *parent)
 
 PajeType::~PajeType ()
 {
+  delete _compaction;
 }
 
 const std::string &PajeType::name (void) const
@@ -70,6 +72,24 @@ std::string PajeType::kind (void) const
  }
 }
 
+//the compaction of the entities of this type, NULL if there is none
+paje_compaction *PajeType::compaction (void) const
+{
+  return _compaction;
+}
+
+void PajeType::setCompaction (const paje_compaction &compaction)
+{
+  delete _compaction;
+  _compaction = new paje_compaction (compaction);
+}
+
+//the user-defined fields of the entities of this type
+PajeExtraFields *PajeType::extraFields (void)
+{
+  return &_extraFields;
+}
+
 bool PajeType::isCategorizedType (void) const
 {
   return false;
@@ -91,6 +111,11 @@ bool PajeType::hasValueForIdentifier (std::string identifier)
   return false;
 }
 
+PajeValue *PajeType::valueForKey (const paje_string_key &identifier)
+{
+  throw "should be implemented in subclass";
+}
+
 PajeColor *PajeType::colorForIdentifier (std::string identifier)
 {
   throw "should be implemented in subclass";
@@ -126,25 +151,28 @@ PajeValue *PajeCategorizedType::addValue (std::string alias, std::string value,
   PajeValue *newValue = new PajeValue (value, alias, this, color);
   values[newValue->identifier()] = newValue;
   colors[newValue->identifier()] = color;
+  paje_symbol symbol = valueSymbols.intern (newValue->identifier());
+  if (symbol >= valuesBySymbol.size()){
+    valuesBySymbol.resize (symbol + 1);
+  }
+  valuesBySymbol[symbol] = newValue;
   return newValue;
 }
 
 PajeValue *PajeCategorizedType::valueForIdentifier (std::string identifier)
 {
-  if (values.count(identifier)){
-    return values[identifier];
-  }else{
-    return NULL;
-  }
+  return valueForKey (PajeSymbolTable::key (identifier));
 }
 
 bool PajeCategorizedType::hasValueForIdentifier (std::string identifier)
 {
-  if (values.count(identifier)){
-    return true;
-  }else{
-    return false;
-  }
+  return valueForIdentifier (identifier) != NULL;
+}
+
+PajeValue *PajeCategorizedType::valueForKey (const paje_string_key &identifier)
+{
+  paje_symbol symbol = valueSymbols.find (identifier);
+  return symbol == PAJE_NO_SYMBOL ? NULL : valuesBySymbol[symbol];
 }
 
 PajeColor *PajeCategorizedType::colorForIdentifier (std::string identifier)
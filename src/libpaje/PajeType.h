@@ -26,6 +26,8 @@
 #include "PajeColor.h"
 #include "PajeProtocols.h"
 #include "PajeValue.h"
+#include "PajeSymbolTable.h"
+#include "PajeExtraFields.h"
 
 class PajeValue;
 
@@ -37,26 +39,60 @@ typedef enum {
   PAJE_LinkType,
   PAJE_UndefinedType} PajeTypeNature;
 
+#define PAJE_COMPACTION_OTHER "other"
+
+/*
+ * paje_compaction: the lossy compaction of the entities of a type
+ * while they are simulated, a zero disables each policy. Variable
+ * changes less than quantum after the start of the current value
+ * update it, and changes by less than epsilon are dropped. With merge,
+ * a state that starts where the previous one with the same value ended
+ * continues it. States shorter than shortest get the value other, and
+ * join the previous state when it is an adjacent other.
+ */
+typedef struct {
+  double quantum;
+  double epsilon;
+  bool merge;
+  double shortest;
+  PajeValue *other;
+} paje_compaction;
+
+//what the compaction of a type removed
+typedef struct {
+  unsigned long long coalesced; //variable changes, quantum
+  unsigned long long dropped; //variable changes, epsilon
+  unsigned long long merged; //states, merge
+  unsigned long long shortened; //states given the other value
+  unsigned long long joined; //of those, states joined to the previous one
+} paje_compaction_stats;
+
 class PajeType : public PajeObject {
 protected:
   std::string _name;
   std::string _alias;
   PajeType *_parent;
   int _depth;
+  paje_compaction *_compaction;
+  PajeExtraFields _extraFields;
 
 public:
   PajeType (std::string name, std::string alias, PajeType *parent);
-  ~PajeType ();
+  virtual ~PajeType ();
   const std::string &name (void) const;
   const std::string &alias (void) const;
   int depth (void) const;
   PajeType *parent (void) const;
   const std::string &identifier (void) const;
   std::string kind (void) const;
+  paje_compaction *compaction (void) const;
+  void setCompaction (const paje_compaction &compaction);
+  PajeExtraFields *extraFields (void);
   virtual bool isCategorizedType (void) const;
   virtual PajeValue *addValue (std::string alias, std::string value, PajeColor *color);
   virtual PajeValue *valueForIdentifier (std::string identifier);
   virtual bool hasValueForIdentifier (std::string identifier);
+  virtual PajeValue *valueForKey (const paje_string_key &identifier);
   virtual PajeColor *colorForIdentifier (std::string identifier);
   virtual PajeColor *color (void);
   virtual PajeDrawingType drawingType (void) = 0;
@@ -72,6 +108,11 @@ public:
 };
 
 class PajeCategorizedType : public PajeType {
+private:
+  //for lookups, the identifiers of values are not in the symbols of the simulator
+  PajeSymbolTable valueSymbols;
+  std::vector<PajeValue*> valuesBySymbol;
+
 public:
   PajeCategorizedType (std::string name, std::string alias, PajeType *parent);
   std::map<std::string,PajeValue*> values;
@@ -81,6 +122,7 @@ public:
   PajeValue *addValue (std::string alias, std::string value, PajeColor *color);
   PajeValue *valueForIdentifier (std::string identifier);
   bool hasValueForIdentifier (std::string identifier);
+  PajeValue *valueForKey (const paje_string_key &identifier);
   PajeColor *colorForIdentifier (std::string identifier);
 };
 
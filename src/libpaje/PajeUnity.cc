@@ -15,9 +15,17 @@
     along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
 */
 #include <sys/time.h>
+#include <string.h>
+#include <unistd.h>
+#include <sstream>
+#include <iomanip>
 #include "PajeUnity.h"
 #include "PajeException.h"
+#include "PajeSnapshot.h"
 #include "PajeFileReader.h"
+#include "PajeReadAheadReader.h"
+#include "PajeCompressedFileReader.h"
+#include "PajeBinaryReader.h"
 #include "PajeFlexReader.h"
 #include "PajeProbabilisticSimulator.h"
 
@@ -28,14 +36,50 @@ static double gettime (void)
   return (double)tr.tv_sec+(double)tr.tv_usec/1000000;
 }
 
-PajeUnity::PajeUnity (bool flexReader, bool strictHeader, std::string tracefilename, double stopat, int ignoreIncompleteLinks, char *probabilistic)
+PajeUnityOptions::PajeUnityOptions (void)
+{
+  flexReader = false;
+  strictHeader = true;
+  stopat = -1;
+  ignoreIncompleteLinks = 0;
+  probabilistic = NULL;
+  threads = 1;
+  simulationThreads = 1;
+  columnar = false;
+  reorderWindow = 0;
+  sink = NULL;
+  indexStart = -1;
+}
+
+PajeUnity::PajeUnity (std::string tracefilename, const PajeUnityOptions &options)
 {
   //basic configuration
-  this->flexReader = flexReader;
+  this->flexReader = options.flexReader;
+  bool strictHeader = options.strictHeader;
+  double stopat = options.stopat;
+  int ignoreIncompleteLinks = options.ignoreIncompleteLinks;
+  char *probabilistic = options.probabilistic;
+  double reorderWindow = options.reorderWindow;
+  PajeEntitySink *sink = options.sink;
+  const std::string &compaction = options.compaction;
+  const std::string &linkKeys = options.linkKeys;
+  const std::string &index = options.index;
+  std::string snapshot = options.snapshot;
 
   //the global PajeDefinitions object
   definitions = new PajeDefinitions (strictHeader);
- 
+  decoder = NULL;
+  reorder = NULL;
+  bool binaryReader = false;
+  PajeFileReader *fileReader = NULL;
+  PajeTraceIndex *traceIndex = NULL;
+  const paje_trace_checkpoint *checkpoint = NULL;
+  PajeSnapshot *loaded = NULL;
+  std::string settings;
+  if (tracefilename == "-"){
+    tracefilename.clear ();
+  }
+
   try {
     //alloc reader
     if (flexReader){
@@ -46,35 +90,100 @@ PajeUnity::PajeUnity (bool flexReader, bool strictHeader, std::string tracefilen
       }
     }else{
       if (tracefilename.empty()){
-	reader = new PajeFileReader();
+        reader = new PajeReadAheadReader ();
+      }else if (PajeReadAheadReader::isStream (tracefilename)){
+        reader = new PajeReadAheadReader (tracefilename);
+      }else if (PajeBinaryReader::isBinaryTrace (tracefilename)){
+        reader = new PajeBinaryReader (tracefilename, definitions);
+        binaryReader = true;
+      }else if (PajeCompressedFileReader::isCompressed (tracefilename)){
+        reader = new PajeCompressedFileReader (tracefilename);
       }else{
-        reader = new PajeFileReader (tracefilename);
+        reader = fileReader = new PajeFileReader (tracefilename, true);
       }
     }
 
-    //alloc decoder and simulator
-    if (!flexReader){
-      decoder = new PajeEventDecoder(definitions);
+    //alloc decoder (flex and binary readers don't need one) and simulator
+    if (!flexReader && !binaryReader){
+      decoder = new PajeEventDecoder(definitions, options.threads);
     }
     if (probabilistic){
       simulator = new PajeProbabilisticSimulator (probabilistic);
     }else{
       simulator = new PajeSimulator (stopat, ignoreIncompleteLinks);
+      simulator->setSimulationThreads (options.simulationThreads);
+      simulator->setColumnar (options.columnar);
+      simulator->setEntitySink (sink);
+      if (!compaction.empty()){
+        simulator->addCompaction (compaction);
+      }
+      if (!linkKeys.empty()){
+        simulator->setLinkKeyStrategy (linkKeys);
+      }
     }
+    simulator->setTraceFileContext (tracefilename, definitions, decoder);
 
 
+    //alloc the reorder stage, only for traces that need it
+    if (reorderWindow > 0){
+      reorder = new PajeEventReorder (reorderWindow);
+    }
+
     //connect components
-    if (flexReader){
-      reader->setOutputComponent (simulator);
-      simulator->setInputComponent (reader);
-    }else{
+    PajeComponent *events = decoder ? (PajeComponent*)decoder : reader;
+    if (decoder){
       reader->setOutputComponent (decoder);
       decoder->setInputComponent (reader);
-      decoder->setOutputComponent (simulator);
-      simulator->setInputComponent (decoder);
     }
+    if (reorder){
+      events->setOutputComponent (reorder);
+      reorder->setInputComponent (events);
+      events = reorder;
+    }
+    events->setOutputComponent (simulator);
+    simulator->setInputComponent (events);
     simulator->setOutputComponent (this);
     this->setInputComponent (simulator);
+
+    //with an index, the simulation starts at the checkpoint before indexStart
+    if (!index.empty() && !probabilistic){
+      if (!fileReader || !decoder){
+        throw PajeIndexException (index, "it can only be used with an uncompressed trace file");
+      }
+      traceIndex = new PajeTraceIndex (index);
+      if (traceIndex->traceSize() != fileReader->traceSize()){
+        throw PajeIndexException (index, "it is not the index of trace '"+tracefilename+"'");
+      }
+      if (options.indexStart > 0){
+        checkpoint = traceIndex->checkpointBefore (options.indexStart);
+      }
+    }
+
+    //with a snapshot of the trace as it is now, it is loaded instead
+    if (snapshot.empty() || probabilistic || sink || tracefilename.empty() || checkpoint){
+      snapshot.clear ();
+    }else{
+      std::stringstream spec;
+      spec << std::setprecision (17) << "stop-at=" << stopat << ";strict=" << strictHeader
+           << ";incomplete-links=" << ignoreIncompleteLinks << ";reorder-window=" << reorderWindow
+           << ";compact=" << compaction << ";link-keys=" << linkKeys;
+      settings = spec.str();
+      if (access (snapshot.c_str(), F_OK) == 0){
+        if (!PajeSnapshot::isSnapshot (snapshot)){
+          throw PajeSnapshotException (snapshot, "it is not a snapshot");
+        }
+        //snapshots of other versions or hosts are written again
+        try {
+          loaded = new PajeSnapshot (snapshot);
+        }catch (PajeSnapshotException& e){
+          loaded = NULL;
+        }
+        if (loaded && !loaded->isSnapshotOf (tracefilename, settings)){
+          delete loaded;
+          loaded = NULL;
+        }
+      }
+    }
   }catch (PajeException& e){
     e.reportAndExit ();
   }
@@ -82,23 +191,49 @@ PajeUnity::PajeUnity (bool flexReader, bool strictHeader, std::string tracefilen
   //read and simulate
   t1 = gettime();
   try {
-    reader->startReading ();
-    while (reader->hasMoreData() && simulator->keepSimulating()){
-      reader->readNextChunk ();
+    if (loaded){
+      simulator->loadSnapshot (loaded);
+      delete loaded;
+      snapshot.clear ();
+    }else{
+      reader->startReading ();
+      if (checkpoint){
+        std::string header = traceIndex->definitions (tracefilename);
+        PajeData data (header.length() + 1);
+        memcpy (data.bytes, header.data(), header.length());
+        data.bytes[header.length()] = '\0';
+        data.length = header.length();
+        decoder->inputEntity (&data);
+        simulator->restoreCheckpoint (traceIndex->checkpoint (checkpoint));
+        decoder->setLineNumber (checkpoint->line);
+        fileReader->seek (checkpoint->offset);
+      }
+      while (reader->hasMoreData() && simulator->keepSimulating()){
+        reader->readNextChunk ();
+      }
+      reader->finishedReading ();
     }
-    reader->finishedReading ();
   }catch (PajeException& e){
     e.reportAndExit();
   }
   t2 = gettime();
+  delete traceIndex;
+
+  //a failed snapshot only costs the next run a simulation
+  if (!snapshot.empty()){
+    try {
+      simulator->writeSnapshot (snapshot, tracefilename, settings);
+    }catch (PajeException& e){
+      e.report ();
+    }
+  }
 }
 
 PajeUnity::~PajeUnity ()
 {
   delete reader;
-  if (!flexReader){
-    delete decoder;
-  }
+  delete decoder;
+  delete reorder;
   delete simulator;
   delete definitions;
 }
@@ -117,3 +252,13 @@ void PajeUnity::reportContainer ()
 {
   simulator->reportContainer();
 }
+
+void PajeUnity::setTeardown (bool teardown)
+{
+  simulator->setTeardown (teardown);
+}
+
+void PajeUnity::reportCompaction ()
+{
+  simulator->reportCompaction();
+}
@@ -19,23 +19,53 @@
 #include "PajeComponent.h"
 #include "PajeEventDecoder.h"
 #include "PajeSimulator.h"
-#include "PajeEventDecoder.h"
+#include "PajeEventReorder.h"
+#include "PajeTraceIndex.h"
+
+/*
+ * PajeUnityOptions: how PajeUnity reads and simulates a trace, see the
+ * manual pages of pj_dump and pj_validate. The defaults read it with
+ * one thread, check its header and keep all its entities in memory.
+ */
+class PajeUnityOptions {
+public:
+  bool flexReader;
+  bool strictHeader;
+  double stopat;
+  int ignoreIncompleteLinks;
+  char *probabilistic;
+  int threads;
+  int simulationThreads;
+  bool columnar;
+  double reorderWindow;
+  PajeEntitySink *sink;
+  std::string compaction;
+  std::string linkKeys;
+  std::string index;
+  double indexStart;
+  std::string snapshot;
+
+  PajeUnityOptions (void);
+};
 
 class PajeUnity : public PajeComponent {
 private:
   PajeComponent *reader;
   PajeEventDecoder *decoder;
+  PajeEventReorder *reorder;
   PajeSimulator *simulator;
   PajeDefinitions *definitions;
   bool flexReader;
   double t1, t2;
 
 public:
-  PajeUnity (bool flexReader, bool strictHeader, std::string tracefilename, double stopat, int ignoreIncompleteLinks, char *probabilistic);
+  PajeUnity (std::string tracefilename, const PajeUnityOptions &options);
   ~PajeUnity ();
   double getTime ();
   void report ();
   void reportContainer ();
+  void setTeardown (bool teardown);
+  void reportCompaction ();
 };
 
 #endif
@@ -0,0 +1,123 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdlib.h>
+#include <string>
+#include <iostream>
+#include "PajeFileReader.h"
+#include "PajeReadAheadReader.h"
+#include "PajeCompressedFileReader.h"
+#include "PajeEventDecoder.h"
+#include "PajeBinaryWriter.h"
+#include "PajeException.h"
+#include <argp.h>
+#include "libpaje_config.h"
+
+#define VALIDATE_INPUT_SIZE 2
+static char doc[] = "Converts FILE, or standard input, to the binary Paje trace format";
+static char args_doc[] = "[FILE]";
+
+static struct argp_option options[] = {
+  {"output", 'o', "OUTPUT", 0, "Write the binary trace to OUTPUT"},
+  {"no-strict", 'n', 0, OPTION_ARG_OPTIONAL, "Support old field names in event definitions"},
+  {"threads", 'j', "THREADS", 0, "Decode the input with THREADS threads"},
+  {"version", 'v', 0, OPTION_ARG_OPTIONAL, "Print version of this binary"},
+  { 0 }
+};
+
+struct arguments {
+  char *input[VALIDATE_INPUT_SIZE];
+  char *output;
+  int noStrict;
+  int input_size;
+  int threads;
+};
+
+static error_t parse_options (int key, char *arg, struct argp_state *state)
+{
+  struct arguments *arguments = (struct arguments*)(state->input);
+  switch (key){
+  case 'o': arguments->output = arg; break;
+  case 'n': arguments->noStrict = 1; break;
+  case 'j': arguments->threads = atoi(arg); break;
+  case 'v': printf("%s\n", LIBPAJE_VERSION_STRING); exit(0); break;
+  case ARGP_KEY_ARG:
+    if (arguments->input_size == VALIDATE_INPUT_SIZE) {
+      /* Too many arguments. */
+      argp_usage (state);
+    }
+    arguments->input[state->arg_num] = arg;
+    arguments->input_size++;
+    break;
+  case ARGP_KEY_END:
+    if (arguments->output == NULL) {
+      /* No output file. */
+      argp_usage (state);
+    }
+    break;
+  default: return ARGP_ERR_UNKNOWN;
+  }
+  return 0;
+}
+
+static struct argp argp = { options, parse_options, args_doc, doc };
+
+int main (int argc, char **argv)
+{
+  struct arguments arguments;
+  bzero (&arguments, sizeof(struct arguments));
+  if (argp_parse (&argp, argc, argv, 0, 0, &arguments) == ARGP_KEY_ERROR){
+    fprintf(stderr, "%s, error during the parsing of parameters\n", argv[0]);
+    return 1;
+  }
+
+  PajeDefinitions *definitions = new PajeDefinitions (!arguments.noStrict);
+  PajeComponent *reader = NULL;
+  PajeEventDecoder *decoder = NULL;
+  PajeBinaryWriter *writer = NULL;
+  try {
+    if (arguments.input_size == 0 || std::string(arguments.input[0]) == "-"){
+      reader = new PajeReadAheadReader ();
+    }else if (PajeReadAheadReader::isStream (arguments.input[0])){
+      reader = new PajeReadAheadReader (arguments.input[0]);
+    }else if (PajeCompressedFileReader::isCompressed (arguments.input[0])){
+      reader = new PajeCompressedFileReader (arguments.input[0]);
+    }else{
+      reader = new PajeFileReader (arguments.input[0], true);
+    }
+    decoder = new PajeEventDecoder (definitions, arguments.threads);
+    writer = new PajeBinaryWriter (arguments.output, definitions);
+
+    reader->setOutputComponent (decoder);
+    decoder->setInputComponent (reader);
+    decoder->setOutputComponent (writer);
+    writer->setInputComponent (decoder);
+
+    reader->startReading ();
+    while (reader->hasMoreData()){
+      reader->readNextChunk ();
+    }
+    reader->finishedReading ();
+  }catch (PajeException& e){
+    e.reportAndExit ();
+  }
+
+  delete writer;
+  delete decoder;
+  delete reader;
+  delete definitions;
+  return 0;
+}
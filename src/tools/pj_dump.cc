@@ -37,7 +37,18 @@ static struct argp_option options[] = {
   {"ignore-incomplete-links", 'z', 0, OPTION_ARG_OPTIONAL, "Ignore incomplete links (not recommended)"},
   {"quiet", 'q', 0, OPTION_ARG_OPTIONAL, "Do not dump, only simulate"},
   {"flex", 'f', 0, OPTION_ARG_OPTIONAL, "Use flex-based file reader"},
+  {"threads", 'j', "THREADS", 0, "Decode the input with THREADS threads"},
+  {"simulation-threads", 'S', "THREADS", 0, "Simulate the containers with THREADS threads"},
+  {"columnar", 'C', 0, OPTION_ARG_OPTIONAL, "Keep states, events and variables in columns"},
+  {"no-teardown", 'x', 0, OPTION_ARG_OPTIONAL, "Exit without releasing the simulated trace"},
+  {"streaming", 'm', 0, OPTION_ARG_OPTIONAL, "Dump entities as soon as they are finished"},
+  {"reorder-window", 'w', "WINDOW", 0, "Put back in order events late by up to WINDOW seconds"},
+  {"compact", 'k', "SPEC", 0, "Compact the entities of types as in SPEC (TYPE:POLICY[,POLICY]...[;TYPE:...])"},
+  {"link-keys", 'L', "STRATEGY", 0, "Detect reused link keys with STRATEGY (exact, recent=N or off)"},
+  {"index", 'i', "INDEX", 0, "Resume the simulation from a checkpoint of INDEX (see pj_index) before START"},
+  {"snapshot", 'b', "SNAPSHOT", 0, "Load the simulation from SNAPSHOT, or save it there for the next run"},
   {"user-defined", 'u', 0, OPTION_ARG_OPTIONAL, "Dump user-defined fields"},
+  {"integrate", 'g', 0, OPTION_ARG_OPTIONAL, "Dump the time integration of the states and variables of each container"},
   {"probabilistic", 'p', "TYPENAME", 0, "Dump global states based on TYPENAME"},
   {"float-precision", 'l', "PRECISION", 0, "Precision of floating point numbers"},
   {"version", 'v', 0, OPTION_ARG_OPTIONAL, "Print version of this binary"},
@@ -52,7 +63,18 @@ struct arguments {
   int ignoreIncompleteLinks;
   int quiet;
   int flex;
+  int threads;
+  int simulationThreads;
+  int columnar;
+  int noTeardown;
+  double reorderWindow;
+  char *compaction;
+  char *linkKeys;
+  char *index;
+  char *snapshot;
+  int streaming;
   int userDefined;
+  int integrate;
   char *probabilistic;
 };
 
@@ -67,7 +89,18 @@ static error_t parse_options (int key, char *arg, struct argp_state *state)
   case 'z': arguments->ignoreIncompleteLinks = 1; break;
   case 'q': arguments->quiet = 1; break;
   case 'f': arguments->flex = 1; break;
+  case 'j': arguments->threads = atoi(arg); break;
+  case 'S': arguments->simulationThreads = atoi(arg); break;
+  case 'C': arguments->columnar = 1; break;
+  case 'x': arguments->noTeardown = 1; break;
+  case 'w': arguments->reorderWindow = atof(arg); break;
+  case 'k': arguments->compaction = arg; break;
+  case 'L': arguments->linkKeys = arg; break;
+  case 'i': arguments->index = arg; break;
+  case 'b': arguments->snapshot = arg; break;
+  case 'm': arguments->streaming = 1; break;
   case 'u': arguments->userDefined = 1; break;
+  case 'g': arguments->integrate = 1; break;
   case 'p': arguments->probabilistic = strdup(arg); break;
   case 'l': dumpFloatingPointPrecision = atoi(arg); break;
   case 'v': printf("%s\n", LIBPAJE_VERSION_STRING); exit(0); break;
@@ -147,6 +180,79 @@ void dump (struct arguments *arguments, PajeComponent *simulator)
   }
 }
 
+/*
+ * integrate: dumps, for each container and each of its state and
+ * variable types, the time integration of every value in [start,end]
+ * as "Integration, container, type, value, fraction".
+ */
+void integrate (struct arguments *arguments, PajeComponent *simulator)
+{
+  double start = arguments->start;
+  double end = arguments->end;
+  if (start == -1) start = simulator->startTime();
+  if (end == -1) end = simulator->endTime();
+  simulator->setSelectionStartEndTime (start, end);
+
+  std::vector<PajeContainer*> stack;
+  stack.push_back (simulator->rootInstance());
+
+  while (!stack.empty()){
+    PajeContainer *container = stack.back();
+    stack.pop_back ();
+
+    std::vector<PajeType*> containedTypes;
+    std::vector<PajeType*>::iterator it;
+    containedTypes = simulator->containedTypesForContainerType (container->type());
+    for (it = containedTypes.begin(); it != containedTypes.end(); it++){
+      PajeType *type = *it;
+      if (simulator->isContainerType (type)){
+        std::vector<PajeContainer*> children;
+        children = simulator->enumeratorOfContainersTypedInContainer (type, container);
+        stack.insert (stack.end(), children.begin(), children.end());
+      }else if (type->nature() == PAJE_StateType || type->nature() == PAJE_VariableType){
+        PajeAggregatedDict integrated = simulator->timeIntegrationOfTypeInContainer (type, container);
+        PajeAggregatedDict::iterator entry;
+        for (entry = integrated.begin(); entry != integrated.end(); entry++){
+          std::cout << "Integration, " << container->name() << ", " << type->name() << ", "
+                    << (*entry).first->name() << ", "
+                    << std::fixed << std::setprecision (dumpFloatingPointPrecision)
+                    << (*entry).second << std::endl;
+          delete (*entry).first;
+        }
+      }
+    }
+  }
+}
+
+/*
+ * PajeDumpSink: dumps the entities of a streaming simulation as they
+ * are finished, the ones overlapping [start,end] if they are given.
+ */
+class PajeDumpSink : public PajeEntitySink {
+private:
+  struct arguments *arguments;
+
+public:
+  PajeDumpSink (struct arguments *arguments)
+  {
+    this->arguments = arguments;
+  }
+
+  void entityFinished (PajeEntity *entity)
+  {
+    if (arguments->quiet) return;
+    if (!entity->isContainer()){
+      if (arguments->end != -1 && entity->startTime() >= arguments->end) return;
+      if (arguments->start != -1 && entity->endTime() < arguments->start) return;
+    }
+    std::cout << entity->description();
+    if (arguments->userDefined){
+      std::cout << entity->extraDescription(true);
+    }
+    std::cout << std::endl;
+  }
+};
+
 int main (int argc, char **argv)
 {
   struct arguments arguments;
@@ -157,22 +263,51 @@ int main (int argc, char **argv)
     return 1;
   }
 
-  PajeUnity *unity = new PajeUnity (arguments.flex,
-				    !arguments.noStrict,
-				    std::string(arguments.input[0]),
-				    arguments.stopat,
-				    arguments.ignoreIncompleteLinks,
-				    arguments.probabilistic);
+  PajeDumpSink *sink = NULL;
+  if (arguments.streaming && !arguments.probabilistic){
+    sink = new PajeDumpSink (&arguments);
+  }
+
+  PajeUnityOptions options;
+  options.flexReader = arguments.flex;
+  options.strictHeader = !arguments.noStrict;
+  options.stopat = arguments.stopat;
+  options.ignoreIncompleteLinks = arguments.ignoreIncompleteLinks;
+  options.probabilistic = arguments.probabilistic;
+  options.threads = arguments.threads;
+  options.simulationThreads = arguments.simulationThreads;
+  options.columnar = arguments.columnar;
+  options.reorderWindow = arguments.reorderWindow;
+  options.sink = sink;
+  if (arguments.compaction) options.compaction = arguments.compaction;
+  if (arguments.linkKeys) options.linkKeys = arguments.linkKeys;
+  if (arguments.index) options.index = arguments.index;
+  options.indexStart = arguments.start;
+  if (arguments.snapshot) options.snapshot = arguments.snapshot;
+
+  PajeUnity *unity = new PajeUnity (arguments.input_size ? std::string(arguments.input[0]) : std::string(), options);
 
   if (arguments.probabilistic){
     delete unity;
     return 0;
   }
+
+  if (arguments.compaction){
+    unity->reportCompaction ();
+  }
   
-  if (!arguments.quiet){
-    dump (&arguments, unity);
+  if (!arguments.quiet && !sink){
+    if (arguments.integrate){
+      integrate (&arguments, unity);
+    }else{
+      dump (&arguments, unity);
+    }
   }
 
+  if (arguments.noTeardown){
+    unity->setTeardown (false);
+  }
   delete unity;
+  delete sink;
   return 0;
 }
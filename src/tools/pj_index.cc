@@ -0,0 +1,135 @@
+/*
+    This file is part of PajeNG
+
+    PajeNG is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PajeNG is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Public License for more details.
+
+    You should have received a copy of the GNU Public License
+    along with PajeNG. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdlib.h>
+#include <string>
+#include <iostream>
+#include "PajeFileReader.h"
+#include "PajeEventDecoder.h"
+#include "PajeSimulator.h"
+#include "PajeTraceIndex.h"
+#include "PajeException.h"
+#include <argp.h>
+#include "libpaje_config.h"
+
+#define VALIDATE_INPUT_SIZE 2
+#define PAJE_INDEX_DEFAULT_INTERVAL 60
+static char doc[] = "Writes an index of FILE with checkpoints of its simulation, for pj_dump --index";
+static char args_doc[] = "FILE";
+
+static struct argp_option options[] = {
+  {"output", 'o', "OUTPUT", 0, "Write the index to OUTPUT (instead of FILE.idx)"},
+  {"interval", 'i', "SECONDS", 0, "Take a checkpoint every SECONDS of trace time (instead of 60)"},
+  {"no-strict", 'n', 0, OPTION_ARG_OPTIONAL, "Support old field names in event definitions"},
+  {"threads", 'j', "THREADS", 0, "Decode the input with THREADS threads"},
+  {"link-keys", 'L', "STRATEGY", 0, "Detect reused link keys with STRATEGY (exact, recent=N or off)"},
+  {"version", 'v', 0, OPTION_ARG_OPTIONAL, "Print version of this binary"},
+  { 0 }
+};
+
+struct arguments {
+  char *input[VALIDATE_INPUT_SIZE];
+  char *output;
+  char *linkKeys;
+  double interval;
+  int noStrict;
+  int input_size;
+  int threads;
+};
+
+static error_t parse_options (int key, char *arg, struct argp_state *state)
+{
+  struct arguments *arguments = (struct arguments*)(state->input);
+  switch (key){
+  case 'o': arguments->output = arg; break;
+  case 'i': arguments->interval = atof(arg); break;
+  case 'n': arguments->noStrict = 1; break;
+  case 'j': arguments->threads = atoi(arg); break;
+  case 'L': arguments->linkKeys = arg; break;
+  case 'v': printf("%s\n", LIBPAJE_VERSION_STRING); exit(0); break;
+  case ARGP_KEY_ARG:
+    if (arguments->input_size == VALIDATE_INPUT_SIZE) {
+      /* Too many arguments. */
+      argp_usage (state);
+    }
+    arguments->input[state->arg_num] = arg;
+    arguments->input_size++;
+    break;
+  case ARGP_KEY_END:
+    if (arguments->input_size == 0 || arguments->interval <= 0) {
+      /* No trace file, or no interval. */
+      argp_usage (state);
+    }
+    break;
+  default: return ARGP_ERR_UNKNOWN;
+  }
+  return 0;
+}
+
+static struct argp argp = { options, parse_options, args_doc, doc };
+
+int main (int argc, char **argv)
+{
+  struct arguments arguments;
+  bzero (&arguments, sizeof(struct arguments));
+  arguments.interval = PAJE_INDEX_DEFAULT_INTERVAL;
+  if (argp_parse (&argp, argc, argv, 0, 0, &arguments) == ARGP_KEY_ERROR){
+    fprintf(stderr, "%s, error during the parsing of parameters\n", argv[0]);
+    return 1;
+  }
+
+  std::string trace (arguments.input[0]);
+  std::string output = arguments.output ? std::string(arguments.output) : trace + ".idx";
+
+  PajeDefinitions *definitions = new PajeDefinitions (!arguments.noStrict);
+  PajeFileReader *reader = NULL;
+  PajeEventDecoder *decoder = NULL;
+  PajeSimulator *simulator = NULL;
+  PajeTraceIndexer *indexer = NULL;
+  try {
+    reader = new PajeFileReader (trace, true);
+    decoder = new PajeEventDecoder (definitions, arguments.threads);
+    simulator = new PajeSimulator (-1, 0);
+    simulator->setTraceFileContext (trace, definitions, decoder);
+    if (arguments.linkKeys){
+      simulator->setLinkKeyStrategy (arguments.linkKeys);
+    }
+    indexer = new PajeTraceIndexer (simulator, trace, output, arguments.interval);
+
+    reader->setOutputComponent (decoder);
+    decoder->setInputComponent (reader);
+    decoder->setOutputComponent (indexer);
+    indexer->setInputComponent (decoder);
+    indexer->setOutputComponent (simulator);
+    simulator->setInputComponent (indexer);
+
+    reader->startReading ();
+    while (reader->hasMoreData()){
+      reader->readNextChunk ();
+    }
+    reader->finishedReading ();
+  }catch (PajeException& e){
+    e.reportAndExit ();
+  }
+
+  delete indexer;
+  simulator->setTeardown (false);
+  delete simulator;
+  delete decoder;
+  delete reader;
+  delete definitions;
+  return 0;
+}
@@ -31,6 +31,14 @@ static struct argp_option options[] = {
   {"quiet", 'q', 0, OPTION_ARG_OPTIONAL, "Be quiet"},
   {"time", 't', 0, OPTION_ARG_OPTIONAL, "Print number of seconds to simulate input"},
   {"flex", 'f', 0, OPTION_ARG_OPTIONAL, "Use flex-based file reader"},
+  {"threads", 'j', "THREADS", 0, "Decode the input with THREADS threads"},
+  {"simulation-threads", 'S', "THREADS", 0, "Simulate the containers with THREADS threads"},
+  {"columnar", 'C', 0, OPTION_ARG_OPTIONAL, "Keep states, events and variables in columns"},
+  {"no-teardown", 'x', 0, OPTION_ARG_OPTIONAL, "Exit without releasing the simulated trace"},
+  {"streaming", 'm', 0, OPTION_ARG_OPTIONAL, "Validate without keeping the finished entities"},
+  {"reorder-window", 'w', "WINDOW", 0, "Put back in order events late by up to WINDOW seconds"},
+  {"compact", 'k', "SPEC", 0, "Compact the entities of types as in SPEC (TYPE:POLICY[,POLICY]...[;TYPE:...])"},
+  {"link-keys", 'L', "STRATEGY", 0, "Detect reused link keys with STRATEGY (exact, recent=N or off)"},
   {"version", 'v', 0, OPTION_ARG_OPTIONAL, "Print version of this binary"},
   {"container", 'c', 0, OPTION_ARG_OPTIONAL, "Print container hierarchy"},
   { 0 }
@@ -43,6 +51,14 @@ struct arguments {
   int quiet;
   int time;
   int flex;
+  int threads;
+  int simulationThreads;
+  int columnar;
+  int noTeardown;
+  int streaming;
+  double reorderWindow;
+  char *compaction;
+  char *linkKeys;
   int container;
 };
 
@@ -54,6 +70,14 @@ static error_t parse_options (int key, char *arg, struct argp_state *state)
   case 't': arguments->time = 1; break;
   case 'q': arguments->quiet = 1; break;
   case 'f': arguments->flex = 1; break;
+  case 'j': arguments->threads = atoi(arg); break;
+  case 'S': arguments->simulationThreads = atoi(arg); break;
+  case 'C': arguments->columnar = 1; break;
+  case 'x': arguments->noTeardown = 1; break;
+  case 'm': arguments->streaming = 1; break;
+  case 'w': arguments->reorderWindow = atof(arg); break;
+  case 'k': arguments->compaction = arg; break;
+  case 'L': arguments->linkKeys = arg; break;
   case 'c': arguments->container = 1; break;
   case 'v': printf("%s\n", LIBPAJE_VERSION_STRING); exit(0); break;
   case ARGP_KEY_ARG:
@@ -84,6 +108,15 @@ static double gettime (void)
   return (double)tr.tv_sec+(double)tr.tv_usec/1000000;
 }
 
+/*
+ * PajeValidateSink: the entities of a streaming validation are checked
+ * by the simulator as they are finished, nothing else is done to them.
+ */
+class PajeValidateSink : public PajeEntitySink {
+public:
+  void entityFinished (PajeEntity *entity) {}
+};
+
 int main (int argc, char **argv)
 {
   struct arguments arguments;
@@ -93,19 +126,36 @@ int main (int argc, char **argv)
     return 1;
   }
 
-  PajeUnity *unity = new PajeUnity (arguments.flex,
-				    !arguments.noStrict,
-				    std::string(arguments.input[0]),
-				      -1,
-				    0, 0);
+  PajeValidateSink *sink = NULL;
+  if (arguments.streaming){
+    sink = new PajeValidateSink ();
+  }
+
+  PajeUnityOptions options;
+  options.flexReader = arguments.flex;
+  options.strictHeader = !arguments.noStrict;
+  options.threads = arguments.threads;
+  options.simulationThreads = arguments.simulationThreads;
+  options.columnar = arguments.columnar;
+  options.reorderWindow = arguments.reorderWindow;
+  options.sink = sink;
+  if (arguments.compaction) options.compaction = arguments.compaction;
+  if (arguments.linkKeys) options.linkKeys = arguments.linkKeys;
+
+  PajeUnity *unity = new PajeUnity (arguments.input_size ? std::string(arguments.input[0]) : std::string(), options);
 
   if (arguments.time){
     printf ("%f\n", unity->getTime());
   }
 
+  if (arguments.compaction){
+    unity->reportCompaction ();
+  }
+
   if (arguments.container){
     unity->reportContainer();
     delete unity;
+    delete sink;
     return 0;
   }
 
@@ -113,6 +163,10 @@ int main (int argc, char **argv)
     unity->report();
   }
 
+  if (arguments.noTeardown){
+    unity->setTeardown (false);
+  }
   delete unity;
+  delete sink;
   return 0;
 }